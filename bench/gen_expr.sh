@@ -0,0 +1,49 @@
+#!/bin/sh
+# 生成以表达式为主的 C-minus 程序，用于测量语法分析的速度
+# 用法：gen_expr.sh [函数个数] [每个函数的语句数]
+awk -v nfuncs="${1:-100}" -v nstmts="${2:-30}" '
+function rand_int(n) {
+  seed = (seed * 1103515245 + 12345) % 2147483648
+  return int(seed / 65536) % n
+}
+# 标识符中不能有数字，函数名用字母编号
+function name(i,  s) {
+  s = ""
+  do {
+    s = substr("abcdefghijklmnopqrstuvwxyz", i % 26 + 1, 1) s
+    i = int(i / 26)
+  } while (i > 0)
+  return "f" s
+}
+function operand(d,  r) {
+  r = rand_int(d > 1 ? 3 : 6)
+  if (r == 0) return rand_int(1000)
+  if (r == 1) return "x"
+  if (r == 2) return "a[" rand_int(64) "]"
+  if (r == 3) return "(" expr(d + 1) ")"
+  if (r == 4) return "a[" expr(d + 1) "]"
+  return name(rand_int(k)) "(" expr(d + 1) ")"
+}
+function expr(d,  n, s, i) {
+  n = 2 + rand_int(6)
+  s = operand(d)
+  for (i = 1; i < n; i++)
+    s = s " " substr("+-*/", rand_int(4) + 1, 1) " " operand(d)
+  return s
+}
+BEGIN {
+  seed = 1
+  print "int a[64];"
+  print "int " name(0) "(int x) {\n  return x;\n}"
+  for (k = 1; k <= nfuncs; k++) {
+    printf "int %s(int x) {\n  int y;\n", name(k)
+    for (j = 0; j < nstmts; j++) {
+      r = rand_int(3)
+      if (r == 0) printf "  y = %s;\n", expr(0)
+      else if (r == 1) printf "  if (%s < %s) a[%d] = %s;\n", expr(0), expr(0), rand_int(64), expr(0)
+      else printf "  x = y = %s;\n", expr(0)
+    }
+    print "  return y;\n}"
+  }
+  print "void main(void) {\n  output(" name(1) "(1));\n}"
+}'
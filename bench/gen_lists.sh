@@ -0,0 +1,41 @@
+#!/bin/sh
+# 生成函数体很长、语句很短的 C-minus 程序，用于测量列表节点的开销
+# 用法：gen_lists.sh [函数个数] [每个函数的语句数]
+awk -v nfuncs="${1:-10}" -v nstmts="${2:-5000}" '
+function rand_int(n) {
+  seed = (seed * 1103515245 + 12345) % 2147483648
+  return int(seed / 65536) % n
+}
+# 标识符中不能有数字，变量名用字母编号
+function name(i,  s) {
+  s = ""
+  do {
+    s = substr("abcdefghijklmnopqrstuvwxyz", i % 26 + 1, 1) s
+    i = int(i / 26)
+  } while (i > 0)
+  return "v" s
+}
+BEGIN {
+  seed = 7
+  print "int sum(int a, int b, int c, int d, int e, int f, int g, int h) {"
+  print "  return a + b + c + d + e + f + g + h;"
+  print "}"
+  for (f = 0; f < nfuncs; f++) {
+    print ""
+    print "int " name(f) "x(int p) {"
+    for (i = 0; i < 64; i++) print "  int " name(i) ";"
+    for (i = 0; i < nstmts; i++) {
+      r = rand_int(4)
+      if (r == 0) print "  " name(rand_int(64)) " = " name(rand_int(64)) " + p;"
+      else if (r == 1) print "  " name(rand_int(64)) " = sum(p, " name(rand_int(64)) ", 1, 2, 3, 4, 5, " name(rand_int(64)) ");"
+      else if (r == 2) print "  { " name(rand_int(64)) " = 1; " name(rand_int(64)) " = 2; }"
+      else print "  p = " name(rand_int(64)) ";"
+    }
+    print "  return p;"
+    print "}"
+  }
+  print ""
+  print "void main(void) {"
+  for (f = 0; f < nfuncs; f++) print "  output(" name(f) "x(" f "));"
+  print "}"
+}'
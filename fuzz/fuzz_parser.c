@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+#include <basics.h>
+#include <lexer.h>
+#include <syntax.h>
+#include <error.h>
+#include <stdint.h>
+#include <time.h>
+
+// 对内存中的输入运行词法分析和语法分析
+// 用 libFuzzer 构建时入口是 LLVMFuzzerTestOneInput，定义 FUZZ_STANDALONE 时依次分析命令行给出的文件
+// 语法错误通过 error_handler 返回，崩溃、内存错误和超出预算都以 abort() 报告
+
+// 线性的分析每个词法单元只会分配十几个节点，指数级的回溯会远超这个预算
+#define STEPS_PER_TOKEN 64
+// 时间预算：固定的 50ms 加上每 KB 输入 20ms
+#define BASE_BUDGET_MS 50.0
+#define BUDGET_MS_PER_KB 20.0
+
+static FILE *fp;
+static int token_cap, token_made;    // token_made 包括末尾的 EOT
+
+static double elapsed_ms(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - start->tv_sec) * 1e3 + (double) (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void lex_and_parse(void) {
+  int line_number = 1;
+  token_t *tok;
+  while (fp != NULL && (tok = getToken(fp, &line_number)) != NULL) {
+    if (token_cnt + 1 >= token_cap) {
+      token_cap = token_cap ? 2 * token_cap : 256;
+      token_list = (token_t **) realloc(token_list, (unsigned) token_cap * sizeof(token_t *));
+    }
+    token_list[token_cnt++] = tok;
+    token_made++;
+    if (strcmp(tok->name, "EXCEPTION") == 0) return;
+  }
+  if (token_cnt == token_cap) {
+    token_cap = token_cap ? 2 * token_cap : 256;
+    token_list = (token_t **) realloc(token_list, (unsigned) token_cap * sizeof(token_t *));
+  }
+  token_list[token_cnt] = new_token("EOT", line_number, "EOT");
+  token_made++;
+  parse_budget = STEPS_PER_TOKEN * (long long) (token_cnt + 1);
+  program(true);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  jmp_buf env;
+  fp = size ? fmemopen((void *) data, size, "r") : NULL;
+  token_cnt = token_made = 0;
+  error_handler = &env;
+  if (setjmp(env) == 0) {
+    lex_and_parse();
+  }
+  error_handler = NULL;
+
+  double budget = BASE_BUDGET_MS + BUDGET_MS_PER_KB * (double) size / 1024;
+  double used = elapsed_ms(&start);
+  if (parse_budget && parse_steps > parse_budget) {
+    fprintf(stderr, "fuzz: %lld parse steps for %d tokens\n", parse_steps, token_cnt);
+    abort();
+  }
+  if (used > budget) {
+    fprintf(stderr, "fuzz: %.1f ms for %zu bytes, budget %.1f ms\n", used, size, budget);
+    abort();
+  }
+
+  parser_reset();
+  parse_budget = 0;
+  for (int i = 0; i < token_made; i++)
+    free(token_list[i]);
+  if (fp != NULL) fclose(fp);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    FILE *in = fopen(argv[i], "rb");
+    if (in == NULL) {
+      fprintf(stderr, "open %s failed\n", argv[i]);
+      return -1;
+    }
+    size_t size = 0, cap = 4096;
+    uint8_t *data = (uint8_t *) malloc(cap);
+    size_t n;
+    while ((n = fread(data + size, 1, cap - size, in)) > 0) {
+      size += n;
+      if (size == cap) {
+        cap *= 2;
+        data = (uint8_t *) realloc(data, cap);
+      }
+    }
+    fclose(in);
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+  }
+  return 0;
+}
+#endif
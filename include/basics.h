@@ -10,4 +10,7 @@
 #include <ctype.h>
 #include <assert.h>
 
+// 每个线程各有一份的变量，并行的语法分析中每个线程使用自己的分析器状态
+#define THREAD_LOCAL __thread
+
 #endif
@@ -0,0 +1,30 @@
+#ifndef MEOW_CALLGRAPH
+#define MEOW_CALLGRAPH
+
+#include <basics.h>
+#include <ir.h>
+
+// 三地址码程序的调用图，下标和 prog->funcs 相同
+typedef struct callgraph_t {
+  int nfuncs;
+  int *ncallees;
+  int **callees;        // 每个函数调用的函数，去掉重复
+  int *ncalls;          // 每个函数被调用的次数（调用点的个数）
+  int nsccs;
+  int *scc;             // 所在的强连通分量，编号按逆拓扑序，被调用的分量在前
+  int *order;           // 按强连通分量编号排列的函数
+  bool *recursive;      // 在调用图的环上（包括直接递归）
+  bool *reachable;      // 从入口可达
+} callgraph_t;
+
+// 建立调用图，用 Tarjan 算法求强连通分量
+//
+// 程序定义了 main 并且没有外部声明（-m）时只有 main 是入口，否则其他源文件可能调用
+// 任何函数，所有函数都是入口
+callgraph_t *callgraph_build(ir_prog_t *prog);
+void callgraph_free(callgraph_t *cg);
+
+// 删除从入口不可达的函数并重新编号调用，返回删除的函数个数
+int remove_unreachable_funcs(ir_prog_t *prog);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef MEOW_EMITC
+#define MEOW_EMITC
+
+#include <basics.h>
+#include <ir.h>
+
+// 把语法分析树 prog 翻译为 C99 源程序并打印到标准输出，path 用于 #line 指向原来的 .cm 文件
+//
+// ir 是 prog 翻译得到的三地址码，提供函数签名、全局变量和 -m 模块的外部声明，
+// 因此语义错误已经在翻译三地址码时报告。生成的程序需要用 -fwrapv 编译，
+// 使有符号整数的溢出和其他执行方式一样按 32 位回绕
+void emit_c(ir_prog_t *ir, syntax_t *prog, const char *path);
+
+#endif
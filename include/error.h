@@ -0,0 +1,19 @@
+#ifndef MEOW_ERROR
+#define MEOW_ERROR
+
+#include <basics.h>
+#include <setjmp.h>
+
+// 不为空时，出错后 longjmp 到这里而不是结束进程（用于 fuzz 等需要在出错后继续运行的场合）
+extern THREAD_LOCAL jmp_buf *error_handler;
+
+// 不为空时，错误信息交给它处理而不是打印到 stderr（用于 libmeow 收集诊断信息）
+extern THREAD_LOCAL void (*diag_handler)(int lineno, const char *message);
+
+// 报告一条错误信息，格式化之后打印到 stderr 或交给 diag_handler
+void meow_report(int lineno, const char *fmt, ...);
+
+// 报告完错误之后调用，不会返回
+void meow_fail(void);
+
+#endif
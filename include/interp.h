@@ -0,0 +1,22 @@
+#ifndef MEOW_INTERP
+#define MEOW_INTERP
+
+#include <basics.h>
+#include <ir.h>
+
+// 解释执行过的三地址码指令数目
+extern long long interp_steps;
+// 字节码的分派次数和循环的迭代次数（向后跳转的次数）
+extern long long interp_dispatches, interp_iterations;
+// 调用次数（包括 main）、其中的尾调用次数，以及最大的调用深度
+extern long long interp_calls, interp_tail_calls;
+extern int interp_max_depth;
+// 组合成的超级指令数，以及第一次执行后原地改写为专用指令的通用指令数
+extern int interp_fused, interp_quickened;
+// 为真时每条三地址码指令分派一次，不组合超级指令，也不改写通用指令，用于对照
+extern bool interp_plain;
+
+// 解释执行 prog 的 main 函数，返回 main 的返回值
+int interp_run(ir_prog_t *prog);
+
+#endif
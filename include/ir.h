@@ -0,0 +1,156 @@
+#ifndef MEOW_IR
+#define MEOW_IR
+
+#include <basics.h>
+#include <syntax.h>
+
+// 三地址码指令的操作
+typedef enum ir_op_t {
+  IR_NOP,
+  IR_MOV,     // dst = a
+  IR_ADD,     // dst = a + b
+  IR_SUB,     // dst = a - b
+  IR_MUL,     // dst = a * b
+  IR_DIV,     // dst = a / b
+  IR_LT,      // dst = a < b
+  IR_LE,      // dst = a <= b
+  IR_GT,      // dst = a > b
+  IR_GE,      // dst = a >= b
+  IR_EQ,      // dst = a == b
+  IR_NE,      // dst = a != b
+  IR_GLOAD,   // dst = 全局标量 sym
+  IR_GSTORE,  // 全局标量 sym = a
+  IR_GADDR,   // dst = 全局数组 sym 的首地址
+  IR_LADDR,   // dst = 局部数组 sym 的首地址
+  IR_LOAD,    // dst = a[b]
+  IR_STORE,   // a[b] = c
+  IR_LEN,     // dst = 数组 a 的长度，保存在首地址前面的一个 int 中
+  IR_CHECK,   // 检查 0 <= a < b，否则是运行时错误（下标越界）
+  IR_CALL,    // dst = 函数 sym (args...)，dst 可以为空
+  IR_JMP,     // goto target[0]
+  IR_BR,      // if (a) goto target[0] else goto target[1]
+  IR_RET,     // return a，a 可以为空
+  IR_PHI,     // dst = args[k]，控制流从第 k 个前驱进入；只在 SSA 形式中出现，sym 是原来的寄存器（见 ssa.c）
+  IR_OP_CNT
+} ir_op_t;
+
+// 操作数的种类
+#define IRV_NONE 0
+#define IRV_REG 1
+#define IRV_IMM 2
+
+typedef struct ir_val_t {
+  int kind;
+  int val;    // 虚拟寄存器编号或立即数
+} ir_val_t;
+
+typedef struct ir_inst_t {
+  ir_op_t op;
+  int dst;              // 目标虚拟寄存器，-1 表示没有
+  ir_val_t a, b, c;
+  int sym;              // 全局变量、局部数组或函数的下标
+  int target[2];        // 跳转目标基本块
+  int nargs;
+  ir_val_t *args;       // IR_CALL 的实参
+  int lineno;
+} ir_inst_t;
+
+typedef struct ir_block_t {
+  int size, cap;
+  ir_inst_t *insts;     // 最后一条指令总是 IR_JMP/IR_BR/IR_RET
+} ir_block_t;
+
+typedef struct ir_func_t {
+  char name[64];
+  int lineno;
+  bool returns_value;   // int 函数为真，void 函数为假
+  bool builtin;         // input/output 等内建函数，没有函数体
+  bool external;        // 在其他源文件中定义（-m），没有函数体
+  int nparams;          // 参数依次占据虚拟寄存器 0 .. nparams-1
+  bool *param_array;    // 参数是否为数组（以地址传递）
+  int nregs;            // 虚拟寄存器数目
+  int narrays;
+  int *array_size;      // 局部数组的长度
+  int nblocks, cap_blocks;
+  ir_block_t *blocks;   // blocks[0] 是入口
+} ir_func_t;
+
+typedef struct ir_global_t {
+  char name[64];
+  int size;             // 数组长度，0 表示标量
+  int lineno;
+  bool external;        // 在其他源文件中定义（-m），不分配存储
+} ir_global_t;
+
+typedef struct ir_prog_t {
+  int nglobals, cap_globals;
+  ir_global_t *globals;
+  int nfuncs, cap_funcs;
+  ir_func_t **funcs;    // funcs[0], funcs[1] 是内建的 input 和 output
+} ir_prog_t;
+
+// 内建函数的下标
+#define IR_INPUT 0
+#define IR_OUTPUT 1
+
+// 同时进行的调用数目的上限（-max-depth），超过时是运行时错误；尾调用不增加深度
+extern int max_depth;
+
+// 活跃变量分析的结果，每个基本块一对位集
+typedef struct ir_live_t {
+  int words;            // 每个位集占用的 unsigned 个数
+  unsigned **in, **out;
+} ir_live_t;
+
+#define IR_BITS (8 * (int) sizeof(unsigned))
+#define bit_test(SET, I) (((SET)[(I) / IR_BITS] >> ((I) % IR_BITS)) & 1u)
+#define bit_set(SET, I) ((SET)[(I) / IR_BITS] |= 1u << ((I) % IR_BITS))
+#define bit_clear(SET, I) ((SET)[(I) / IR_BITS] &= ~(1u << ((I) % IR_BITS)))
+
+ir_val_t ir_reg(int reg);
+ir_val_t ir_imm(int imm);
+ir_val_t ir_none(void);
+
+ir_prog_t *ir_new_prog(void);
+ir_func_t *ir_new_func(ir_prog_t *prog, const char *name, int lineno);
+int ir_new_global(ir_prog_t *prog, const char *name, int size);
+int ir_new_block(ir_func_t *func);
+int ir_new_reg(ir_func_t *func);
+ir_inst_t *ir_emit(ir_func_t *func, int block, ir_op_t op, int lineno);
+ir_inst_t *ir_insert(ir_func_t *func, int block, int i, ir_op_t op, int lineno);
+void ir_remove_inst(ir_block_t *block, int i);
+
+int ir_find_func(ir_prog_t *prog, const char *name);
+bool ir_is_terminator(ir_op_t op);
+bool ir_is_binop(ir_op_t op);
+bool ir_is_tail_call(ir_prog_t *prog, ir_func_t *func, ir_block_t *block, int i);
+int ir_eval(ir_op_t op, int a, int b);
+bool ir_has_side_effect(ir_inst_t *inst);
+int ir_inst_uses(ir_inst_t *inst, int *uses);
+int ir_func_size(ir_func_t *func);
+int ir_prog_size(ir_prog_t *prog);
+int ir_succs(ir_block_t *block, int *succ);
+int **ir_preds(ir_func_t *func, int *npreds);
+void ir_free_preds(ir_func_t *func, int **preds);
+
+ir_live_t *ir_liveness(ir_func_t *func);
+void ir_free_liveness(ir_func_t *func, ir_live_t *live);
+
+void print_ir(ir_prog_t *prog);
+
+// lower.c：把语法分析树翻译为三地址码
+//
+// 先顺序登记函数签名和全局变量，再由 lower_threads 个线程分别翻译函数体（<= 0 时使用所有处理器）；
+// 报告的语义错误和顺序翻译相同
+extern int lower_threads;
+// 为 true 时在每次访问数组元素之前检查下标（-check-bounds），-O1 时删除能证明不会越界的检查（见 bounds.c）
+extern bool check_bounds;
+
+ir_prog_t *lower_program(syntax_t *prog);
+// 只登记函数签名和全局变量，不翻译函数体，得到源文件的接口
+ir_prog_t *lower_interface(syntax_t *prog);
+// 把多个源文件翻译为一个程序，imports 中的接口作为外部声明；
+// 多个源文件时所有文件的顶层声明在整个程序中可见
+ir_prog_t *lower_units(syntax_t **progs, int n, ir_prog_t **imports, int nimports);
+
+#endif
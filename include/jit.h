@@ -0,0 +1,11 @@
+#ifndef MEOW_JIT
+#define MEOW_JIT
+
+#include <basics.h>
+#include <ir.h>
+
+// 把 prog 编码为机器码放进可执行内存并运行 main，结果写入 ret
+// 不能编译时（非 x86-64 平台、main 的参数过多、映射内存失败）返回 false，由调用者回退到解释器
+bool jit_run(ir_prog_t *prog, bool allocate, bool report, int *ret);
+
+#endif
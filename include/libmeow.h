@@ -0,0 +1,55 @@
+#ifndef LIBMEOW
+#define LIBMEOW
+
+#include <stddef.h>
+
+// libmeow：在进程内对内存中的 C-minus 源程序做词法分析和语法分析
+//
+// 出错时不会结束进程，错误信息作为诊断信息保存在分析结果中，文本和 meowCC 打印到 stderr 的相同
+// 词法单元序列等分析器状态是全局的，同一时间只能有一个线程调用 meow_compile()；得到的结果之间互不影响，
+// 在 meow_free() 之前一直有效
+
+// meow_compile() 的 flags
+#define MEOW_LEX_ONLY 1         // 只做词法分析（同 -l）
+#define MEOW_EXPRESSION 2       // 把输入作为一个表达式分析（同 -e）
+#define MEOW_COMPACT 4          // 省略表达式中单产生式的中间节点（同 -c）
+#define MEOW_SKELETON 8         // 不分析函数体（同 -k），用 meow_function_body() 按需分析
+#define MEOW_SHARED 16          // 结构相同的子树共用一个节点（同 -H），节点指针相等即子树相等
+#define MEOW_FLAT 32            // 各种列表是一个节点，子节点依次是所有元素（同 -F）
+#define MEOW_AST 64             // 直接构造抽象语法树，省略标点和单产生式的链（同 -ast）
+
+typedef struct meow_compilation_t meow_compilation_t;
+typedef struct syntax_t meow_node_t;
+
+// 分析 source 开始的 size 个字节，source 不需要以 '\0' 结尾；只在内存不足时返回 NULL
+meow_compilation_t *meow_compile(const char *source, size_t size, int flags);
+void meow_free(meow_compilation_t *c);
+// 没有任何错误时返回 1
+int meow_ok(const meow_compilation_t *c);
+
+// 词法单元序列，不包括末尾的 EOT；词法错误时只包括出错之前的词法单元
+int meow_token_count(const meow_compilation_t *c);
+const char *meow_token_name(const meow_compilation_t *c, int index);
+const char *meow_token_value(const meow_compilation_t *c, int index);
+int meow_token_line(const meow_compilation_t *c, int index);
+
+// 语法分析树，出错或者 MEOW_LEX_ONLY 时为 NULL
+const meow_node_t *meow_root(const meow_compilation_t *c);
+// 符号名或词法单元名
+const char *meow_node_name(const meow_node_t *node);
+// 词法单元的词素，符号节点返回 NULL
+const char *meow_node_value(const meow_node_t *node);
+int meow_node_line(const meow_node_t *node);
+int meow_node_child_count(const meow_node_t *node);
+const meow_node_t *meow_node_child(const meow_node_t *node, int index);
+
+// fun_declaration 节点的函数体。MEOW_SKELETON 时函数体是 lazy_compound_stmt，
+// 第一次调用时才分析并替换进语法分析树；函数体有语法错误时返回 NULL 并记录诊断信息
+const meow_node_t *meow_function_body(meow_compilation_t *c, const meow_node_t *fun);
+
+// 诊断信息，不带末尾的换行
+int meow_diag_count(const meow_compilation_t *c);
+const char *meow_diag_message(const meow_compilation_t *c, int index);
+int meow_diag_line(const meow_compilation_t *c, int index);
+
+#endif
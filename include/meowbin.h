@@ -0,0 +1,99 @@
+#ifndef MEOW_BIN
+#define MEOW_BIN
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 词法单元序列和语法分析树的二进制格式（-b 输出）
+//
+// 文件由头部和四个段组成，所有整数都是小端序，每个段按 4 字节对齐：
+//   头部         meowbin_header_t
+//   记录         定长的 meowbin_token_t 或 meowbin_node_t 数组
+//   字符串表     nstrings 个 uint32 偏移，指向之后以 '\0' 结尾的去重字符串
+//   行号         按记录顺序，相邻记录行号之差的 zigzag varint 编码
+//   检查点       每 MEOWBIN_CHECKPOINT 个记录一个 meowbin_checkpoint_t，用于随机访问行号
+//
+// 语法树的节点按层序排列，每个节点的子节点在记录数组中连续存放，
+// 因此读者 mmap 文件之后可以直接沿 first/count 遍历，不需要反序列化
+
+#define MEOWBIN_MAGIC "MEOW"
+#define MEOWBIN_VERSION 1
+#define MEOWBIN_TOKENS 1
+#define MEOWBIN_TREE 2
+#define MEOWBIN_NONE 0xffffffffu
+#define MEOWBIN_CHECKPOINT 64
+
+typedef struct meowbin_header_t {
+  char magic[4];
+  uint16_t version;
+  uint16_t kind;              // MEOWBIN_TOKENS 或 MEOWBIN_TREE
+  uint32_t nrecords, records_off;
+  uint32_t nstrings, strings_off;
+  uint32_t blob_off, blob_size;
+  uint32_t lines_off, lines_size;
+  uint32_t checkpoints_off;
+  uint32_t root;              // 语法树的根节点，词法单元序列为 MEOWBIN_NONE
+} meowbin_header_t;
+
+typedef struct meowbin_token_t {
+  uint32_t name, value;       // 字符串表下标
+} meowbin_token_t;
+
+typedef struct meowbin_node_t {
+  uint32_t name;              // 符号名或词法单元名
+  uint32_t value;             // 词法单元的词素，符号节点为 MEOWBIN_NONE
+  uint32_t first, count;      // 子节点是 first 起的 count 个记录
+} meowbin_node_t;
+
+typedef struct meowbin_checkpoint_t {
+  uint32_t line;              // 第 k * MEOWBIN_CHECKPOINT 个记录的行号
+  uint32_t offset;            // 它的行号在行号段中的偏移
+} meowbin_checkpoint_t;
+
+// 读者：mmap 或内存中的文件
+typedef struct meowbin_t {
+  const unsigned char *base;
+  size_t size;
+  int mapped;
+  const meowbin_header_t *header;
+  const uint32_t *strings;
+  const char *blob;
+  const void *records;
+  const unsigned char *lines;
+  const meowbin_checkpoint_t *checkpoints;
+} meowbin_t;
+
+// 按顺序解码行号
+typedef struct meowbin_lines_t {
+  const unsigned char *p, *end;
+  long line;
+} meowbin_lines_t;
+
+// 打开并校验文件，成功返回 0，失败返回 -1 并设置 *error
+int meowbin_open(meowbin_t *bin, const char *path, const char **error);
+// 校验内存中的文件，data 需要 4 字节对齐且在 bin 使用期间有效
+int meowbin_load(meowbin_t *bin, const void *data, size_t size, const char **error);
+void meowbin_close(meowbin_t *bin);
+
+uint32_t meowbin_count(const meowbin_t *bin);
+const char *meowbin_string(const meowbin_t *bin, uint32_t index);
+const meowbin_token_t *meowbin_token(const meowbin_t *bin, uint32_t index);
+const meowbin_node_t *meowbin_node(const meowbin_t *bin, uint32_t index);
+// 第 index 个记录的行号，从最近的检查点开始解码，越界时返回 -1
+long meowbin_line(const meowbin_t *bin, uint32_t index);
+
+void meowbin_lines_begin(const meowbin_t *bin, meowbin_lines_t *it);
+long meowbin_lines_next(meowbin_lines_t *it);
+
+// 按 -l 和默认模式的文本格式输出
+void meowbin_print_tokens(const meowbin_t *bin, FILE *out);
+void meowbin_print_tree(const meowbin_t *bin, int indent, FILE *out);
+
+// 写者，在 source/binwrite.c 中
+struct token_t;
+struct syntax_t;
+void meowbin_write_tokens(FILE *out, struct token_t **tokens, int n);
+void meowbin_write_tree(FILE *out, struct syntax_t *root);
+
+#endif
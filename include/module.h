@@ -0,0 +1,20 @@
+#ifndef MEOW_MODULE
+#define MEOW_MODULE
+
+#include <ir.h>
+
+// 多文件程序：-m 给出的源文件（模块）中的函数和全局变量在 SOURCE 中可见
+//
+// 模块的接口摘要保存在同名的 .cmi 文件中（lib.cm 对应 lib.cmi），记录源文件内容的哈希；
+// 哈希一致时直接读取摘要，不再分析模块，否则对模块做骨架分析（-k）得到接口并重新写出摘要
+typedef struct module_t {
+  const char *path;
+  ir_prog_t *iface;     // 接口：只有函数签名和全局变量的 ir_prog_t
+  syntax_t *prog;       // 需要函数体时的语法分析树，否则为 NULL
+  bool cached;          // 接口是否直接从摘要读取
+} module_t;
+
+// 读入模块的接口；full 时完整地分析整个模块，运行程序（-r、-jit）需要模块的函数体
+module_t *module_load(const char *path, bool full);
+
+#endif
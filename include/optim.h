@@ -0,0 +1,64 @@
+#ifndef MEOW_OPTIM
+#define MEOW_OPTIM
+
+#include <basics.h>
+#include <ir.h>
+
+// 按优化级别对 prog 运行优化 pass，report 为真时向 stderr 报告各 pass 的效果
+void optimize(ir_prog_t *prog, int level, bool report);
+
+int fold_constants(ir_func_t *func);
+int propagate_copies(ir_func_t *func);
+int remove_unreachable(ir_func_t *func);
+int eliminate_dead_stores(ir_func_t *func);
+
+// 把小的非递归函数内联到调用处（见 inline.c），返回内联的调用数
+int inline_calls(ir_prog_t *prog);
+
+// -dump-inline 时向 stderr 打印每个调用点的内联决定，-no-inline 时不内联
+extern bool inline_dump, inline_off;
+
+// 自然循环上的循环不变量外提和归纳变量强度削弱（见 loop.c），分别返回外提的指令数和削弱的乘法数
+int hoist_invariants(ir_func_t *func);
+int reduce_strength(ir_func_t *func);
+
+// -no-loop-opt 时不做循环优化
+extern bool loop_off;
+
+// 用区间分析删除一定通过的下标检查（见 bounds.c），返回删除的个数
+int eliminate_bounds_checks(ir_prog_t *prog, ir_func_t *func);
+
+// -no-bounds-opt 时保留所有下标检查
+extern bool bounds_off;
+
+// 支配树和支配边界（见 ssa.c），只包含从入口可达的基本块
+typedef struct dom_tree_t {
+  int nblocks;            // 建立时的基本块数，之后拆分边新增的基本块不在其中
+  int *npreds, **preds;   // phi 的第 k 个实参对应前驱 preds[b][k]
+  int *idom;              // 直接支配者，入口和不可达的基本块为 -1
+  int *nkids, **kids;     // 支配树中的孩子
+  int *ndf, **df;         // 支配边界
+  int *pre, *post;        // 支配树上的先序和后序编号
+} dom_tree_t;
+
+dom_tree_t *dom_tree_build(ir_func_t *func);
+void dom_tree_free(dom_tree_t *dt);
+// 基本块 a 是否支配 b
+bool dominates(dom_tree_t *dt, int a, int b);
+// blocks 中的基本块的迭代支配边界写入 frontier
+void iterated_frontier(ir_func_t *func, dom_tree_t *dt, const bool *blocks, bool *frontier);
+
+// 转为剪枝的 SSA 形式：变量在它的定值的迭代支配边界上活跃时放置 phi，每次定值使用新的寄存器，
+// 没有定值就被使用的寄存器（参数）保留原来的编号；返回放置的 phi 数
+int build_ssa(ir_func_t *func);
+// 检查 SSA 的性质，不满足时报告第一个问题并返回 false
+bool verify_ssa(ir_func_t *func);
+// 退出 SSA 形式：phi 连接的互不干扰的寄存器合并为一个，其余的 phi 改为前驱边上的并行复写，最后重新编号寄存器
+void destroy_ssa(ir_func_t *func);
+// SSA 形式上基于支配树的全局值编号（见 gvn.c），返回删除的指令数（不含 phi）
+int number_values(ir_func_t *func);
+
+// -no-gvn 时不转为 SSA 形式、不做值编号，-verify-ssa 时在值编号前后检查 SSA 的性质
+extern bool gvn_off, ssa_verify;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef MEOW_PARALLEL
+#define MEOW_PARALLEL
+
+#include <syntax.h>
+
+// 在多个线程中分析各个顶层声明，得到和 program(true) 完全相同的语法分析树
+// nthreads 不大于 0 时使用所有在线的处理器；有语法错误时退回顺序分析，报告相同的错误
+syntax_t *parallel_program(int nthreads);
+
+#endif
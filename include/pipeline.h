@@ -0,0 +1,19 @@
+#ifndef MEOW_PIPELINE
+#define MEOW_PIPELINE
+
+#include <syntax.h>
+
+// 把 fp 中的词法单元依次放入 token_list，最多 max_tokens 个，返回词法单元数，*line_number 是最后的行号（用于 EOT）
+// 遇到词法错误或者词法单元过多时报错并结束进程；publish 时每分析出一批就发布到 tokens_ready
+int lex_tokens(FILE *fp, int max_tokens, int *line_number, bool publish);
+
+// 流水线分析（-P）：在单独的线程中做词法分析，语法分析器读到还没有发布的位置时等待
+// token_list 要预先分配 max_tokens + 1 个位置，词法分析线程只向其中追加，不会移动已有的词法单元
+void pipeline_start(FILE *fp, int max_tokens);
+// 按需的词法分析（-stream）：不创建线程，语法分析器读到还没有发布的位置时在当前线程中再分析一批，
+// 已经分析完的声明的词法单元可以随时释放，不需要先读完整个文件
+void pipeline_start_on_demand(FILE *fp, int max_tokens);
+// 等待词法分析线程结束，之后 token_list 和 token_cnt 与顺序分析时相同
+void pipeline_finish(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef MEOW_PROFILE
+#define MEOW_PROFILE
+
+#include <basics.h>
+#include <ir.h>
+
+// 解释执行的剖析（-profile FILE、-profile-stacks FILE），两个路径都为空时不剖析
+//
+// 计数的单位是解释执行的三地址码指令，和 -s 打印的 executed 相同，所以结果与机器的快慢无关
+extern const char *profile_report_path, *profile_stacks_path;
+
+// 不剖析时为空；否则按行号下标，分别是每一行执行的指令数和循环回边（iteration_stmt 所在行）的执行次数
+extern long long *profile_lines, *profile_loops;
+
+// 开始剖析 prog 的执行，进程退出时（包括运行时错误）写出报告
+void profile_start(ir_prog_t *prog);
+// 进入和离开 prog->funcs[f]，用于调用次数、包含和不包含被调函数的指令数，以及调用栈
+void profile_enter(int f);
+void profile_leave(void);
+
+#endif
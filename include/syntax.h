@@ -11,6 +11,7 @@ typedef struct symbol_t {
   int lineno;
   int size;
   struct syntax_t** child; 
+  int begin, end;     // lazy_compound_stmt 跳过的词法单元范围 [begin, end)
 } symbol_t;
 
 typedef struct syntax_t {
@@ -25,13 +26,91 @@ typedef struct syntax_t {
 #define SYMBOL 1
 #define TOKEN 2
 
+// 待分析的词法单元，token_list[token_cnt] 是末尾的 EOT
+extern token_t **token_list;
+extern int token_cnt;
+// 流水线分析（-P）时词法分析线程已经发布的词法单元数，-1 表示 token_list 已经完整（见 pipeline.h）
+extern int tokens_ready;
+extern THREAD_LOCAL int current_token_cnt;
+
 syntax_t *new_symbol(const char *name, int lineno, int size, ...);
+// 由 n 个元素构造右递归的列表节点，例如 declaration_list -> declaration declaration_list | declaration
+// flat_lists 时构造平坦的列表节点
+syntax_t *new_list(const char *name, syntax_t **elems, int n);
+
+// 依次访问 declaration_list、local_declarations、statement_list 的元素，右递归和平坦的列表都适用：
+// list_first() 返回第一个元素，之后 list_next() 返回下一个，没有更多元素时返回 NULL
+typedef struct list_iter_t {
+  syntax_t *list;       // 当前所在的一层
+  int i;                // 下一个子节点的下标
+} list_iter_t;
+syntax_t *list_first(list_iter_t *it, syntax_t *list);
+syntax_t *list_next(list_iter_t *it);
 
+// node 是平坦的列表节点（-F）；只有一个元素的列表在两种形状下相同，也算平坦的
+bool is_flat_list(syntax_t *node);
+
+// print_nested 时平坦的列表按文法原来的嵌套形状打印，输出和不加 -F 时相同
 void print_syntax_tree(syntax_t* node, int indent);
+// 打印抽象语法树（-ast），符号节点开头的词法单元子节点和符号名打印在同一行
+void print_ast(syntax_t *node, int indent);
 
 syntax_t* advance();
 bool stepback();
 
+// 语法分析的工作量（分配的节点数），parse_budget 不为 0 时超出即报错
+extern THREAD_LOCAL long long parse_steps;
+extern long long parse_budget;
+
+// 为 true 时表达式省略单产生式的中间节点（-c），默认生成完整的语法分析树
+extern bool compact_expr;
+
+// 为 true 时 declaration_list、local_declarations、statement_list、arg_list 和 param_list
+// 都是一个节点，子节点数组依次是所有元素（arg_list/param_list 不含逗号），不再是嵌套的链（-F）
+extern bool flat_lists;
+// 为 true 时按嵌套的形状打印平坦的列表（-nested），兼容按原来的形状读取输出的工具
+extern bool print_nested;
+
+// 为 true 时直接构造抽象语法树（-ast）：省略标点和单产生式的链，运算符是以词素命名的二元节点，
+// 各种列表是平坦的节点，program 的子节点就是各个声明；翻译为中间代码需要完整的语法分析树
+extern bool abstract_syntax;
+
+// 为 true 时不分析函数体（-k），fun_declaration 的函数体是只记录了词法单元范围的
+// lazy_compound_stmt 节点，第一次通过 function_body() 访问时才分析
+extern bool skeleton_bodies;
+
+// 不为 NULL 时逐个声明地输出（-stream）：declaration_list 每分析完一个顶层声明就把它交给 declaration_sink
+// （k 是它的序号），随后释放它的节点和词法单元，最后返回没有子节点的 declaration_list
+extern void (*declaration_sink)(syntax_t *dec, int k);
+// 不为 NULL 时，读到还没有发布的词法单元时调用它在当前线程中分析下一批，而不是等待词法分析线程
+extern void (*token_pull)(void);
+// 打印第 k 个顶层声明，k == 0 时先打印 program 和 declaration_list，输出和一次打印整棵树时相同
+void print_declaration(syntax_t *dec, int k, int indent);
+
+// 为 true 时结构相同（符号名或词法单元名和词素相同、子节点相同）的子树共用一个节点（-H），
+// 语法分析树成为 DAG，节点的指针相等即子树相等；共用的节点保留第一次出现时的行号
+extern bool share_subtrees;
+
+// 语法分析分配的字节数，以及 -H 时共用的节点、因此省下的字节数和散列表占用的字节数
+typedef struct share_stats_t {
+  long long bytes;
+  long long shared_nodes, shared_bytes;
+  long long table_bytes;
+} share_stats_t;
+extern THREAD_LOCAL share_stats_t share_stats;
+
+// fun_declaration 的函数体，跳过的函数体在这时分析并替换掉占位节点
+// 需要 token_list 仍然是分析这棵树时的词法单元序列
+syntax_t *function_body(syntax_t *fun);
+
+// 释放语法分析分配的所有内存，重置状态以便分析下一个输入
+void parser_reset(void);
+// 把语法分析分配的内存交给调用者并重置状态，使语法分析树在下次分析之后仍然有效
+// 返回以 NULL 结尾的数组，调用者逐个 free 其中的元素和数组本身
+void **parser_detach(void);
+// 接管 parser_detach() 交出的内存，之后由 parser_reset() 一起释放
+void parser_adopt(void **blocks);
+
 syntax_t* program(bool last);
 syntax_t* declaration_list(bool last);
 syntax_t* declaration(bool last);
@@ -52,9 +131,6 @@ syntax_t* expression(bool last);
 syntax_t* var(bool last);
 syntax_t* simple_expression(bool last);
 syntax_t* additive_expression(bool last);
-syntax_t* relop(bool last);
-syntax_t* addop(bool last);
-syntax_t* mulop(bool last);
 syntax_t* term(bool last);
 syntax_t* factor(bool last);
 syntax_t* call(bool last);
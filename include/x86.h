@@ -0,0 +1,115 @@
+#ifndef MEOW_X86
+#define MEOW_X86
+
+#include <basics.h>
+#include <ir.h>
+
+// 通用寄存器，按机器编码排列
+enum {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+  REG_CNT
+};
+
+// 操作数的种类
+#define XO_NONE 0
+#define XO_REG 1
+#define XO_IMM 2
+#define XO_MEM 3      // disp(base, index, scale)，index 为 -1 表示没有
+#define XO_GLOBAL 4   // 全局变量 sym(%rip)
+#define XO_LABEL 5    // 函数内的标签 sym
+#define XO_FUNC 6     // 函数 sym，BOUNDS_FAIL 等负数是报告运行时错误的函数
+
+// 报告下标越界并结束程序的运行时函数，%edi 是行号
+#define BOUNDS_FAIL (-2)
+// 报告调用过深并结束程序的运行时函数，%edi 是被调函数的行号
+#define DEPTH_FAIL (-3)
+// 报告除以 0 并结束程序的运行时函数，%edi 是行号
+#define DIV_FAIL (-5)
+// XO_GLOBAL 的 sym 为 STACK_LIMIT 时是栈的下限（8 字节），函数入口处 %rsp 低于它时调用过深
+#define STACK_LIMIT (-4)
+// 栈底不可读写的保护页，越过下限之后的栈再用完时立即出错，不会改写栈之下的内存
+#define STACK_GUARD 4096
+
+typedef struct x86_opnd_t {
+  int kind;
+  int reg, index, scale;
+  int disp;             // 立即数或地址偏移
+  int sym;
+} x86_opnd_t;
+
+typedef enum x86_op_t {
+  X_MOV,
+  X_MOVSLQ,             // 32 位符号扩展到 64 位
+  X_MOVZBL,             // 8 位零扩展到 32 位
+  X_LEA,
+  X_ADD,
+  X_SUB,
+  X_IMUL,               // imm 不为空时是三操作数形式 dst = src * imm
+  X_CMP,
+  X_TEST,
+  X_CDQ,
+  X_IDIV,
+  X_SETCC,
+  X_JMP,
+  X_JCC,
+  X_CALL,
+  X_RET,
+  X_PUSH,
+  X_POP,
+  X_LEAVE,
+  X_LABEL,
+  X_OP_CNT
+} x86_op_t;
+
+// 条件码，按机器编码排列，低位取反即为相反条件
+#define CC_B 0x2       // 无符号小于
+#define CC_AE 0x3      // 无符号大于等于
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xc
+#define CC_GE 0xd
+#define CC_LE 0xe
+#define CC_G 0xf
+
+typedef struct x86_inst_t {
+  x86_op_t op;
+  int size;             // 操作数字节数：1、4 或 8
+  int cc;
+  x86_opnd_t src, dst;  // AT&T 顺序：op src, dst
+  x86_opnd_t imm;
+} x86_inst_t;
+
+// 寄存器分配的结果
+typedef struct regalloc_t {
+  int nregs;
+  int *reg;             // 分配到的物理寄存器，-1 表示没有
+  int *slot;            // 溢出到的栈槽，-1 表示没有
+  int nslots;
+  int nspilled;
+  bool callee_used[REG_CNT];
+  ir_live_t *live;
+} regalloc_t;
+
+typedef struct x86_func_t {
+  int func;             // 在 ir_prog_t 中的下标
+  int size, cap;
+  x86_inst_t *insts;
+  int nlabels;
+  int frame_bytes;      // 栈帧的最大字节数，包括返回地址、保存的 %rbp 和传给被调函数的栈上参数
+  regalloc_t *ra;
+} x86_func_t;
+
+// regalloc.c
+extern const int arg_regs[6];
+bool is_callee_saved(int reg);
+regalloc_t *linear_scan(ir_func_t *func, bool allocate);
+
+// codegen.c
+extern int x86_tail_calls;
+x86_func_t *x86_select(ir_prog_t *prog, int f, bool allocate);
+size_t x86_stack_size(int max_frame, size_t *limit);
+void x86_print(ir_prog_t *prog, x86_func_t **funcs);
+int x86_prog_size(ir_prog_t *prog, x86_func_t **funcs);
+
+#endif
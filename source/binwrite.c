@@ -0,0 +1,192 @@
+#include <meowbin.h>
+#include <lexer.h>
+#include <syntax.h>
+
+typedef struct buf_t {
+  unsigned char *data;
+  size_t size, cap;
+} buf_t;
+
+static void put(buf_t *b, const void *p, size_t n) {
+  if (b->size + n > b->cap) {
+    b->cap = b->cap ? 2 * b->cap : 4096;
+    while (b->size + n > b->cap) b->cap *= 2;
+    b->data = (unsigned char *) realloc(b->data, b->cap);
+  }
+  memcpy(b->data + b->size, p, n);
+  b->size += n;
+}
+
+static void put8(buf_t *b, unsigned v) {
+  unsigned char c = (unsigned char) v;
+  put(b, &c, 1);
+}
+
+static void put32(buf_t *b, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    put8(b, (v >> (8 * i)) & 0xff);
+}
+
+static void align4(buf_t *b) {
+  while (b->size % 4) put8(b, 0);
+}
+
+// 字符串表，用开放定址的哈希表去重
+typedef struct strtab_t {
+  uint32_t n, cap;
+  uint32_t *offsets;
+  buf_t blob;
+  uint32_t nslots;
+  uint32_t *slots;
+} strtab_t;
+
+static uint32_t hash(const char *s) {
+  uint32_t h = 2166136261u;
+  for (; *s; s++) h = (h ^ (unsigned char) *s) * 16777619u;
+  return h;
+}
+
+static uint32_t find_slot(strtab_t *t, const char *s) {
+  uint32_t h = hash(s) & (t->nslots - 1);
+  while (t->slots[h] != MEOWBIN_NONE && strcmp((char *) t->blob.data + t->offsets[t->slots[h]], s) != 0)
+    h = (h + 1) & (t->nslots - 1);
+  return h;
+}
+
+static uint32_t intern(strtab_t *t, const char *s) {
+  if (2 * (t->n + 1) > t->nslots) {
+    uint32_t *old = t->slots, old_n = t->nslots;
+    t->nslots = t->nslots ? 2 * t->nslots : 256;
+    t->slots = (uint32_t *) malloc(t->nslots * sizeof(uint32_t));
+    memset(t->slots, 0xff, t->nslots * sizeof(uint32_t));
+    for (uint32_t i = 0; i < old_n; i++)
+      if (old[i] != MEOWBIN_NONE)
+        t->slots[find_slot(t, (char *) t->blob.data + t->offsets[old[i]])] = old[i];
+    free(old);
+  }
+  uint32_t h = find_slot(t, s);
+  if (t->slots[h] != MEOWBIN_NONE) return t->slots[h];
+  if (t->n == t->cap) {
+    t->cap = t->cap ? 2 * t->cap : 256;
+    t->offsets = (uint32_t *) realloc(t->offsets, t->cap * sizeof(uint32_t));
+  }
+  t->offsets[t->n] = (uint32_t) t->blob.size;
+  put(&t->blob, s, strlen(s) + 1);
+  return t->slots[h] = t->n++;
+}
+
+// 行号：相邻记录之差的 zigzag varint，每 MEOWBIN_CHECKPOINT 个记录一个检查点
+typedef struct lines_t {
+  buf_t data, checkpoints;
+  long prev;
+  uint32_t n;
+} lines_t;
+
+static void add_line(lines_t *l, long line) {
+  if (l->n % MEOWBIN_CHECKPOINT == 0) {
+    put32(&l->checkpoints, (uint32_t) line);
+    put32(&l->checkpoints, (uint32_t) l->data.size);
+  }
+  long d = line - l->prev;
+  unsigned long z = d < 0 ? ((unsigned long) (-(d + 1)) << 1) | 1 : (unsigned long) d << 1;
+  while (z >= 0x80) {
+    put8(&l->data, (unsigned) (z & 0x7f) | 0x80);
+    z >>= 7;
+  }
+  put8(&l->data, (unsigned) z);
+  l->prev = line;
+  l->n++;
+}
+
+static void write_file(FILE *out, int kind, buf_t *records, uint32_t nrecords, strtab_t *strs, lines_t *lines, uint32_t root) {
+  uint32_t records_off = (uint32_t) sizeof(meowbin_header_t);
+  uint32_t strings_off = records_off + (uint32_t) records->size;
+  uint32_t blob_off = strings_off + 4 * strs->n;
+  uint32_t lines_off = (blob_off + (uint32_t) strs->blob.size + 3) / 4 * 4;
+  uint32_t checkpoints_off = (lines_off + (uint32_t) lines->data.size + 3) / 4 * 4;
+
+  buf_t head = {0};
+  put(&head, MEOWBIN_MAGIC, 4);
+  put8(&head, MEOWBIN_VERSION & 0xff);
+  put8(&head, MEOWBIN_VERSION >> 8);
+  put8(&head, (unsigned) kind & 0xff);
+  put8(&head, (unsigned) kind >> 8);
+  uint32_t fields[] = {
+    nrecords, records_off, strs->n, strings_off, blob_off, (uint32_t) strs->blob.size,
+    lines_off, (uint32_t) lines->data.size, checkpoints_off, root
+  };
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    put32(&head, fields[i]);
+  for (uint32_t i = 0; i < strs->n; i++)
+    put32(&head, strs->offsets[i]);
+  assert(head.size == blob_off - records->size);
+
+  // 头部和偏移表一起写出，记录夹在它们中间
+  fwrite(head.data, 1, records_off, out);
+  fwrite(records->data, 1, records->size, out);
+  fwrite(head.data + records_off, 1, head.size - records_off, out);
+  align4(&strs->blob);
+  fwrite(strs->blob.data, 1, strs->blob.size, out);
+  align4(&lines->data);
+  fwrite(lines->data.data, 1, lines->data.size, out);
+  fwrite(lines->checkpoints.data, 1, lines->checkpoints.size, out);
+  free(head.data);
+}
+
+static void free_buffers(buf_t *records, strtab_t *strs, lines_t *lines) {
+  free(records->data);
+  free(strs->offsets);
+  free(strs->slots);
+  free(strs->blob.data);
+  free(lines->data.data);
+  free(lines->checkpoints.data);
+}
+
+void meowbin_write_tokens(FILE *out, token_t **tokens, int n) {
+  strtab_t strs = {0};
+  lines_t lines = {0};
+  buf_t records = {0};
+  for (int i = 0; i < n; i++) {
+    put32(&records, intern(&strs, tokens[i]->name));
+    put32(&records, intern(&strs, tokens[i]->value));
+    add_line(&lines, tokens[i]->lineno);
+  }
+  write_file(out, MEOWBIN_TOKENS, &records, (uint32_t) n, &strs, &lines, MEOWBIN_NONE);
+  free_buffers(&records, &strs, &lines);
+}
+
+void meowbin_write_tree(FILE *out, syntax_t *root) {
+  strtab_t strs = {0};
+  lines_t lines = {0};
+  buf_t records = {0};
+  // 层序遍历，每个节点的子节点在队列中连续排列
+  uint32_t n = 0, cap = 1024;
+  syntax_t **queue = (syntax_t **) malloc(cap * sizeof(syntax_t *));
+  queue[n++] = root;
+  for (uint32_t i = 0; i < n; i++) {
+    syntax_t *node = queue[i];
+    if (node->type == TOKEN) {
+      put32(&records, intern(&strs, node->token.name));
+      put32(&records, intern(&strs, node->token.value));
+      put32(&records, 0);
+      put32(&records, 0);
+      add_line(&lines, node->token.lineno);
+      continue;
+    }
+    uint32_t count = (uint32_t) node->symbol.size;
+    put32(&records, intern(&strs, node->symbol.name));
+    put32(&records, MEOWBIN_NONE);
+    put32(&records, count ? n : 0);
+    put32(&records, count);
+    add_line(&lines, node->symbol.lineno);
+    if (n + count > cap) {
+      while (n + count > cap) cap *= 2;
+      queue = (syntax_t **) realloc(queue, cap * sizeof(syntax_t *));
+    }
+    for (uint32_t k = 0; k < count; k++)
+      queue[n++] = node->symbol.child[k];
+  }
+  free(queue);
+  write_file(out, MEOWBIN_TREE, &records, n, &strs, &lines, 0);
+  free_buffers(&records, &strs, &lines);
+}
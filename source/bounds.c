@@ -0,0 +1,368 @@
+#include <optim.h>
+#include <limits.h>
+
+bool bounds_off = false;
+
+// 超过这个规模（基本块数乘以虚拟寄存器数）的函数不做分析，保留所有检查
+#define MAX_STATE (1 << 22)
+// 循环头的入口状态更新超过这么多次之后开始拓宽
+#define WIDEN_AFTER 2
+
+// 虚拟寄存器可能取值的区间 [lo, hi]，用 long long 计算以便发现溢出
+typedef struct range_t {
+  long long lo, hi;
+} range_t;
+
+static const range_t any = { INT_MIN, INT_MAX };
+
+static range_t range_of(range_t *s, ir_val_t v) {
+  if (v.kind == IRV_IMM) return (range_t) { v.val, v.val };
+  if (v.kind == IRV_REG) return s[v.val];
+  return any;
+}
+
+// 运算按 32 位补码回绕，结果可能超出 int 时什么都不知道
+static range_t make(long long lo, long long hi) {
+  if (lo < INT_MIN || hi > INT_MAX) return any;
+  return (range_t) { lo, hi };
+}
+
+static long long min4(long long a, long long b, long long c, long long d) {
+  long long m = a < b ? a : b;
+  m = m < c ? m : c;
+  return m < d ? m : d;
+}
+
+static long long max4(long long a, long long b, long long c, long long d) {
+  long long m = a > b ? a : b;
+  m = m > c ? m : c;
+  return m > d ? m : d;
+}
+
+// 指令 inst 的结果的区间
+static range_t eval(ir_inst_t *inst, range_t *s) {
+  range_t a = range_of(s, inst->a), b = range_of(s, inst->b);
+  switch (inst->op) {
+    case IR_MOV:
+      return a;
+    case IR_ADD:
+      return make(a.lo + b.lo, a.hi + b.hi);
+    case IR_SUB:
+      return make(a.lo - b.hi, a.hi - b.lo);
+    case IR_MUL:
+      return make(min4(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi), max4(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi));
+    case IR_DIV:
+      // 除数是正的常量时商随被除数单调不减
+      if (b.lo == b.hi && b.lo > 0) return make(a.lo / b.lo, a.hi / b.lo);
+      return any;
+    case IR_LT: case IR_LE: case IR_GT: case IR_GE: case IR_EQ: case IR_NE:
+      return (range_t) { 0, 1 };
+    case IR_LEN:
+      return (range_t) { 0, INT_MAX };
+    default:
+      return any;
+  }
+}
+
+// 执行 inst 之后的状态；通过了的检查说明 0 <= a < b
+static void step(ir_inst_t *inst, range_t *s) {
+  if (inst->op == IR_CHECK) {
+    if (inst->a.kind != IRV_REG) return;
+    range_t *a = &s[inst->a.val], b = range_of(s, inst->b);
+    if (a->lo < 0) a->lo = 0;
+    if (a->hi > b.hi - 1) a->hi = b.hi - 1;
+    return;
+  }
+  if (inst->dst >= 0) s[inst->dst] = eval(inst, s);
+}
+
+static ir_op_t negate(ir_op_t op) {
+  switch (op) {
+    case IR_LT: return IR_GE;
+    case IR_LE: return IR_GT;
+    case IR_GT: return IR_LE;
+    case IR_GE: return IR_LT;
+    case IR_EQ: return IR_NE;
+    default: return IR_EQ;
+  }
+}
+
+// 假定 a op b 成立，收紧两边的区间；返回 false 表示不可能成立
+static bool assume(range_t *s, ir_op_t op, ir_val_t va, ir_val_t vb) {
+  if (op == IR_GT || op == IR_GE) {
+    ir_val_t t = va;
+    va = vb;
+    vb = t;
+    op = op == IR_GT ? IR_LT : IR_LE;
+  }
+  range_t a = range_of(s, va), b = range_of(s, vb);
+  long long gap = op == IR_LT ? 1 : 0;
+  switch (op) {
+    case IR_LT: case IR_LE:
+      if (a.hi > b.hi - gap) a.hi = b.hi - gap;
+      if (b.lo < a.lo + gap) b.lo = a.lo + gap;
+      break;
+    case IR_EQ:
+      a.lo = b.lo = a.lo > b.lo ? a.lo : b.lo;
+      a.hi = b.hi = a.hi < b.hi ? a.hi : b.hi;
+      break;
+    default:
+      // 不等只在去掉区间的端点时有用
+      if (b.lo == b.hi && a.lo == b.lo) a.lo++;
+      else if (b.lo == b.hi && a.hi == b.lo) a.hi--;
+      if (a.lo == a.hi && b.lo == a.lo) b.lo++;
+      else if (a.lo == a.hi && b.hi == a.lo) b.hi--;
+      break;
+  }
+  if (a.lo > a.hi || b.lo > b.hi) return false;
+  if (va.kind == IRV_REG) s[va.val] = a;
+  if (vb.kind == IRV_REG) s[vb.val] = b;
+  return true;
+}
+
+// 基本块末尾的 br 所用的比较：比较在同一个基本块中，之后它的操作数没有被重新定值
+static ir_inst_t *branch_cond(ir_block_t *bb) {
+  ir_inst_t *br = &bb->insts[bb->size - 1];
+  if (br->op != IR_BR || br->a.kind != IRV_REG) return NULL;
+  for (int i = bb->size - 2; i >= 0; i--) {
+    ir_inst_t *inst = &bb->insts[i];
+    if (inst->dst != br->a.val) continue;
+    if (inst->op < IR_LT || inst->op > IR_NE) return NULL;
+    for (int k = i + 1; k < bb->size; k++) {
+      int d = bb->insts[k].dst;
+      if (d >= 0 && ((inst->a.kind == IRV_REG && inst->a.val == d) || (inst->b.kind == IRV_REG && inst->b.val == d)))
+        return NULL;
+    }
+    return inst;
+  }
+  return NULL;
+}
+
+// 拓宽的阈值：函数中出现的常量 c（循环的上界、数组的长度）和 c - 1（i < c 时 i 的上界），以及 int 的边界，从小到大排列
+typedef struct thresholds_t {
+  int size;
+  long long *vals;
+} thresholds_t;
+
+static int by_value(const void *x, const void *y) {
+  long long a = *(const long long *) x, b = *(const long long *) y;
+  return a < b ? -1 : a > b;
+}
+
+static void add_threshold(thresholds_t *t, ir_val_t v) {
+  if (v.kind != IRV_IMM) return;
+  t->vals[t->size++] = v.val;
+  t->vals[t->size++] = (long long) v.val - 1;
+}
+
+static thresholds_t collect_thresholds(ir_func_t *func) {
+  int cnt = 2;
+  for (int b = 0; b < func->nblocks; b++)
+    cnt += 4 * func->blocks[b].size;
+  thresholds_t t = { 0, (long long *) malloc((unsigned) cnt * sizeof(long long)) };
+  t.vals[t.size++] = INT_MIN;
+  t.vals[t.size++] = INT_MAX;
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      add_threshold(&t, func->blocks[b].insts[i].a);
+      add_threshold(&t, func->blocks[b].insts[i].b);
+    }
+  qsort(t.vals, (unsigned) t.size, sizeof(long long), by_value);
+  return t;
+}
+
+// 不小于 x 的最小阈值
+static long long above(thresholds_t *t, long long x) {
+  int lo = 0, hi = t->size - 1;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (t->vals[mid] >= x) hi = mid;
+    else lo = mid + 1;
+  }
+  return t->vals[lo];
+}
+
+// 不大于 x 的最大阈值
+static long long below(thresholds_t *t, long long x) {
+  int lo = 0, hi = t->size - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (t->vals[mid] <= x) lo = mid;
+    else hi = mid - 1;
+  }
+  return t->vals[lo];
+}
+
+// 把 out 并入 in（取包含两者的最小区间）；拓宽时变化的一端放宽到下一个阈值，而不是直接到 int 的边界，
+// 否则循环中不变的 i 被放宽到 INT_MAX 之后 i + 1 就可能溢出。返回 in 是否改变
+static bool merge(range_t *in, range_t *out, int n, thresholds_t *widen) {
+  bool changed = false;
+  for (int r = 0; r < n; r++) {
+    if (out[r].lo < in[r].lo) {
+      in[r].lo = widen ? below(widen, out[r].lo) : out[r].lo;
+      changed = true;
+    }
+    if (out[r].hi > in[r].hi) {
+      in[r].hi = widen ? above(widen, out[r].hi) : out[r].hi;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// 深度优先搜索中回边的目标，每个环上都至少有一个，只在这些基本块拓宽就能保证迭代结束
+static bool *widening_points(ir_func_t *func) {
+  int n = func->nblocks;
+  bool *point = (bool *) calloc((unsigned) n, sizeof(bool));
+  int *state = (int *) calloc((unsigned) n, sizeof(int));   // 0 未访问，1 在栈上，2 已完成
+  int *stack = (int *) malloc((unsigned) n * sizeof(int));
+  int *next = (int *) calloc((unsigned) n, sizeof(int));
+  int top = 0;
+  stack[top++] = 0;
+  state[0] = 1;
+  while (top) {
+    int b = stack[top - 1], succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    if (next[b] == nsucc) {
+      state[b] = 2;
+      top--;
+      continue;
+    }
+    int s = succ[next[b]++];
+    if (state[s] == 1) {
+      point[s] = true;
+    } else if (state[s] == 0) {
+      state[s] = 1;
+      stack[top++] = s;
+    }
+  }
+  free(state);
+  free(stack);
+  free(next);
+  return point;
+}
+
+// 内联之后数组参数可能就是已知的全局数组或局部数组，它们的长度是常量：
+// 沿着只有一次定值的 mov 找到 gaddr/laddr 时，把 len 改写为 mov
+static void fold_lengths(ir_prog_t *prog, ir_func_t *func) {
+  int *ndefs = (int *) calloc((unsigned) func->nregs + 1, sizeof(int));
+  ir_inst_t **def = (ir_inst_t **) calloc((unsigned) func->nregs + 1, sizeof(ir_inst_t *));
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      ir_inst_t *inst = &func->blocks[b].insts[i];
+      if (inst->dst < 0) continue;
+      ndefs[inst->dst]++;
+      def[inst->dst] = inst;
+    }
+  // 参数在入口处已经有值
+  for (int r = 0; r < func->nparams; r++)
+    ndefs[r]++;
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      ir_inst_t *inst = &func->blocks[b].insts[i];
+      if (inst->op != IR_LEN) continue;
+      ir_val_t v = inst->a;
+      for (int hops = 0; v.kind == IRV_REG && ndefs[v.val] == 1 && hops < func->nregs; hops++) {
+        ir_inst_t *d = def[v.val];
+        if (d == NULL) break;
+        if (d->op == IR_GADDR || d->op == IR_LADDR) {
+          inst->op = IR_MOV;
+          inst->a = ir_imm(d->op == IR_GADDR ? prog->globals[d->sym].size : func->array_size[d->sym]);
+          break;
+        }
+        if (d->op != IR_MOV) break;
+        v = d->a;
+      }
+    }
+  free(ndefs);
+  free(def);
+}
+
+// 检查在 s 中一定通过
+static bool proven(ir_inst_t *inst, range_t *s) {
+  range_t a = range_of(s, inst->a), b = range_of(s, inst->b);
+  return a.lo >= 0 && a.hi < b.lo;
+}
+
+// 在每个基本块入口求出各个虚拟寄存器的区间：常量和已知的数组长度给出初值，循环条件在分支的两条边上收紧区间，
+// 通过的检查也收紧下标的区间。删除一定通过的检查，返回删除的个数
+int eliminate_bounds_checks(ir_prog_t *prog, ir_func_t *func) {
+  int n = func->nblocks, nregs = func->nregs;
+  fold_lengths(prog, func);
+  if ((long long) n * nregs > MAX_STATE) return 0;
+
+  range_t **in = (range_t **) calloc((unsigned) n, sizeof(range_t *));
+  int *updates = (int *) calloc((unsigned) n, sizeof(int));
+  int *work = (int *) malloc((unsigned) (n + 1) * sizeof(int));
+  bool *widen = widening_points(func);
+  thresholds_t thresholds = collect_thresholds(func);
+  bool *queued = (bool *) calloc((unsigned) n, sizeof(bool));
+  range_t *cur = (range_t *) malloc((unsigned) (nregs + 1) * sizeof(range_t));
+  range_t *edge = (range_t *) malloc((unsigned) (nregs + 1) * sizeof(range_t));
+
+  // 入口处参数和未赋值的变量可以是任何值
+  in[0] = (range_t *) malloc((unsigned) (nregs + 1) * sizeof(range_t));
+  for (int r = 0; r < nregs; r++)
+    in[0][r] = any;
+  int head = 0, tail = 0;
+  work[tail++] = 0;
+  queued[0] = true;
+  while (head != tail) {
+    int b = work[head];
+    head = (head + 1) % (n + 1);
+    queued[b] = false;
+    ir_block_t *bb = &func->blocks[b];
+    memcpy(cur, in[b], (unsigned) nregs * sizeof(range_t));
+    for (int i = 0; i < bb->size; i++)
+      step(&bb->insts[i], cur);
+    ir_inst_t *cond = branch_cond(bb);
+    int succ[2];
+    int nsucc = ir_succs(bb, succ);
+    for (int t = 0; t < nsucc; t++) {
+      memcpy(edge, cur, (unsigned) nregs * sizeof(range_t));
+      if (cond != NULL && nsucc == 2 && !assume(edge, t == 0 ? cond->op : negate(cond->op), cond->a, cond->b))
+        continue;
+      int s = succ[t];
+      if (in[s] == NULL) {
+        in[s] = (range_t *) malloc((unsigned) (nregs + 1) * sizeof(range_t));
+        memcpy(in[s], edge, (unsigned) nregs * sizeof(range_t));
+      } else if (!merge(in[s], edge, nregs, widen[s] && updates[s] >= WIDEN_AFTER ? &thresholds : NULL)) {
+        continue;
+      }
+      updates[s]++;
+      if (!queued[s]) {
+        queued[s] = true;
+        work[tail] = s;
+        tail = (tail + 1) % (n + 1);
+      }
+    }
+  }
+
+  int removed = 0;
+  for (int b = 0; b < n; b++) {
+    if (in[b] == NULL) continue;
+    ir_block_t *bb = &func->blocks[b];
+    memcpy(cur, in[b], (unsigned) nregs * sizeof(range_t));
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->op == IR_CHECK && proven(inst, cur)) {
+        ir_remove_inst(bb, i--);
+        removed++;
+        continue;
+      }
+      step(inst, cur);
+    }
+  }
+
+  for (int b = 0; b < n; b++)
+    free(in[b]);
+  free(in);
+  free(updates);
+  free(widen);
+  free(thresholds.vals);
+  free(work);
+  free(queued);
+  free(cur);
+  free(edge);
+  return removed;
+}
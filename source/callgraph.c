@@ -0,0 +1,179 @@
+#include <callgraph.h>
+
+// Tarjan 算法的状态
+typedef struct tarjan_t {
+  callgraph_t *cg;
+  int *index, *low, *stack;
+  bool *on_stack;
+  int counter, top, placed;
+} tarjan_t;
+
+static void strong_connect(tarjan_t *t, int v) {
+  callgraph_t *cg = t->cg;
+  t->index[v] = t->low[v] = t->counter++;
+  t->stack[t->top++] = v;
+  t->on_stack[v] = true;
+  for (int k = 0; k < cg->ncallees[v]; k++) {
+    int w = cg->callees[v][k];
+    if (t->index[w] < 0) {
+      strong_connect(t, w);
+      if (t->low[w] < t->low[v]) t->low[v] = t->low[w];
+    } else if (t->on_stack[w] && t->index[w] < t->low[v]) {
+      t->low[v] = t->index[w];
+    }
+  }
+  if (t->low[v] != t->index[v]) return;
+  // v 是分量的根，分量完成时它调用的分量都已经完成，所以编号是逆拓扑序
+  int id = cg->nsccs++, size = 0, w;
+  do {
+    w = t->stack[--t->top];
+    t->on_stack[w] = false;
+    cg->scc[w] = id;
+    cg->order[t->placed++] = w;
+    size++;
+  } while (w != v);
+  for (int i = t->placed - size; i < t->placed; i++)
+    cg->recursive[cg->order[i]] = size > 1;
+}
+
+static bool has_externals(ir_prog_t *prog) {
+  for (int f = 0; f < prog->nfuncs; f++)
+    if (prog->funcs[f]->external) return true;
+  for (int g = 0; g < prog->nglobals; g++)
+    if (prog->globals[g].external) return true;
+  return false;
+}
+
+static void mark_reachable(callgraph_t *cg, int f) {
+  int *stack = (int *) malloc((unsigned) cg->nfuncs * sizeof(int));
+  int top = 0;
+  cg->reachable[f] = true;
+  stack[top++] = f;
+  while (top) {
+    int v = stack[--top];
+    for (int k = 0; k < cg->ncallees[v]; k++) {
+      int w = cg->callees[v][k];
+      if (!cg->reachable[w]) {
+        cg->reachable[w] = true;
+        stack[top++] = w;
+      }
+    }
+  }
+  free(stack);
+}
+
+callgraph_t *callgraph_build(ir_prog_t *prog) {
+  int n = prog->nfuncs;
+  callgraph_t *cg = (callgraph_t *) calloc(1, sizeof(callgraph_t));
+  cg->nfuncs = n;
+  cg->ncallees = (int *) calloc((unsigned) n, sizeof(int));
+  cg->callees = (int **) calloc((unsigned) n, sizeof(int *));
+  cg->ncalls = (int *) calloc((unsigned) n, sizeof(int));
+  cg->scc = (int *) malloc((unsigned) n * sizeof(int));
+  cg->order = (int *) malloc((unsigned) n * sizeof(int));
+  cg->recursive = (bool *) calloc((unsigned) n, sizeof(bool));
+  cg->reachable = (bool *) calloc((unsigned) n, sizeof(bool));
+
+  unsigned *seen = (unsigned *) malloc((unsigned) (n / IR_BITS + 1) * sizeof(unsigned));
+  for (int f = 0; f < n; f++) {
+    ir_func_t *func = prog->funcs[f];
+    memset(seen, 0, (unsigned) (n / IR_BITS + 1) * sizeof(unsigned));
+    for (int b = 0; b < func->nblocks; b++)
+      for (int i = 0; i < func->blocks[b].size; i++) {
+        ir_inst_t *inst = &func->blocks[b].insts[i];
+        if (inst->op != IR_CALL) continue;
+        cg->ncalls[inst->sym]++;
+        // 直接递归在分量大小之外单独判断
+        if (inst->sym == f) cg->recursive[f] = true;
+        if (bit_test(seen, inst->sym)) continue;
+        bit_set(seen, inst->sym);
+        cg->callees[f] = (int *) realloc(cg->callees[f], (unsigned) (cg->ncallees[f] + 1) * sizeof(int));
+        cg->callees[f][cg->ncallees[f]++] = inst->sym;
+      }
+  }
+  free(seen);
+
+  bool *self = (bool *) malloc((unsigned) n + 1);
+  memcpy(self, cg->recursive, (unsigned) n);
+  tarjan_t t = {
+    .cg = cg,
+    .index = (int *) malloc((unsigned) n * sizeof(int)),
+    .low = (int *) malloc((unsigned) n * sizeof(int)),
+    .stack = (int *) malloc((unsigned) n * sizeof(int)),
+    .on_stack = (bool *) calloc((unsigned) n, sizeof(bool)),
+  };
+  for (int f = 0; f < n; f++)
+    t.index[f] = -1;
+  for (int f = 0; f < n; f++)
+    if (t.index[f] < 0) strong_connect(&t, f);
+  for (int f = 0; f < n; f++)
+    cg->recursive[f] = cg->recursive[f] || self[f];
+  free(self);
+  free(t.index);
+  free(t.low);
+  free(t.stack);
+  free(t.on_stack);
+
+  int m = ir_find_func(prog, "main");
+  if (m >= 0 && !prog->funcs[m]->external && !has_externals(prog)) {
+    mark_reachable(cg, m);
+  } else {
+    for (int f = 0; f < n; f++)
+      if (!cg->reachable[f]) mark_reachable(cg, f);
+  }
+  // 内建函数总是保留在固定的下标
+  cg->reachable[IR_INPUT] = cg->reachable[IR_OUTPUT] = true;
+  return cg;
+}
+
+void callgraph_free(callgraph_t *cg) {
+  for (int f = 0; f < cg->nfuncs; f++)
+    free(cg->callees[f]);
+  free(cg->callees);
+  free(cg->ncallees);
+  free(cg->ncalls);
+  free(cg->scc);
+  free(cg->order);
+  free(cg->recursive);
+  free(cg->reachable);
+  free(cg);
+}
+
+static void free_func(ir_func_t *func) {
+  for (int b = 0; b < func->nblocks; b++) {
+    for (int i = 0; i < func->blocks[b].size; i++)
+      free(func->blocks[b].insts[i].args);
+    free(func->blocks[b].insts);
+  }
+  free(func->blocks);
+  free(func->param_array);
+  free(func->array_size);
+  free(func);
+}
+
+int remove_unreachable_funcs(ir_prog_t *prog) {
+  callgraph_t *cg = callgraph_build(prog);
+  int *id = (int *) malloc((unsigned) prog->nfuncs * sizeof(int));
+  int cnt = 0, removed = 0;
+  for (int f = 0; f < prog->nfuncs; f++) {
+    if (cg->reachable[f]) {
+      id[f] = cnt;
+      prog->funcs[cnt++] = prog->funcs[f];
+    } else {
+      free_func(prog->funcs[f]);
+      removed++;
+    }
+  }
+  prog->nfuncs = cnt;
+  // 不可达的函数只被不可达的函数调用，剩下的调用都有新的下标
+  for (int f = 0; f < cnt && removed; f++) {
+    ir_func_t *func = prog->funcs[f];
+    for (int b = 0; b < func->nblocks; b++)
+      for (int i = 0; i < func->blocks[b].size; i++)
+        if (func->blocks[b].insts[i].op == IR_CALL)
+          func->blocks[b].insts[i].sym = id[func->blocks[b].insts[i].sym];
+  }
+  free(id);
+  callgraph_free(cg);
+  return removed;
+}
@@ -0,0 +1,846 @@
+#include <x86.h>
+
+static ir_prog_t *prog;
+static ir_func_t *func;
+static x86_func_t *xf;
+static regalloc_t *ra;
+static int nsaved;            // 保存被调用者保存寄存器占用的栈槽数
+static int *array_offset;     // 局部数组相对 %rbp 的偏移
+static int epilogue_label, depth_label;
+static int frame;             // 在 %rbp 之下分配的字节数
+static int nfails, cap_fails;
+static int *fail_label, *fail_line, *fail_func;  // 运行时错误时跳到函数末尾的桩 fail_label[k]，以行号 fail_line[k] 调用 fail_func[k]
+
+int x86_tail_calls = 0;
+
+static x86_opnd_t none(void) {
+  return (x86_opnd_t) { .kind = XO_NONE, .reg = -1, .index = -1, .scale = 1, .disp = 0, .sym = -1 };
+}
+
+static x86_opnd_t reg(int r) {
+  x86_opnd_t o = none();
+  o.kind = XO_REG;
+  o.reg = r;
+  return o;
+}
+
+static x86_opnd_t imm(int v) {
+  x86_opnd_t o = none();
+  o.kind = XO_IMM;
+  o.disp = v;
+  return o;
+}
+
+static x86_opnd_t mem(int base, int index, int scale, int disp) {
+  x86_opnd_t o = none();
+  o.kind = XO_MEM;
+  o.reg = base;
+  o.index = index;
+  o.scale = scale;
+  o.disp = disp;
+  return o;
+}
+
+static x86_opnd_t symbol(int kind, int sym) {
+  x86_opnd_t o = none();
+  o.kind = kind;
+  o.sym = sym;
+  return o;
+}
+
+static x86_inst_t *emit(x86_op_t op, int size, x86_opnd_t src, x86_opnd_t dst) {
+  if (xf->size == xf->cap) {
+    xf->cap = xf->cap ? 2 * xf->cap : 64;
+    xf->insts = (x86_inst_t *) realloc(xf->insts, (unsigned) xf->cap * sizeof(x86_inst_t));
+  }
+  x86_inst_t *inst = &xf->insts[xf->size++];
+  *inst = (x86_inst_t) { .op = op, .size = size, .cc = 0, .src = src, .dst = dst, .imm = none() };
+  return inst;
+}
+
+static void jump(x86_op_t op, int cc, int label) {
+  emit(op, 8, symbol(XO_LABEL, label), none())->cc = cc;
+}
+
+static int slot_offset(int slot) {
+  return -8 * (nsaved + slot + 1);
+}
+
+static x86_opnd_t loc(int vreg) {
+  if (ra->reg[vreg] >= 0)
+    return reg(ra->reg[vreg]);
+  assert(ra->slot[vreg] >= 0);
+  return mem(RBP, -1, 1, slot_offset(ra->slot[vreg]));
+}
+
+static x86_opnd_t val(ir_val_t v) {
+  return v.kind == IRV_IMM ? imm(v.val) : loc(v.val);
+}
+
+static bool same(x86_opnd_t a, x86_opnd_t b) {
+  if (a.kind != b.kind) return false;
+  if (a.kind == XO_REG) return a.reg == b.reg;
+  if (a.kind == XO_MEM) return a.reg == b.reg && a.index == b.index && a.disp == b.disp;
+  return false;
+}
+
+// 搬运一个完整的值（可能是数组首地址），内存到内存时经过 %r11
+static void move(x86_opnd_t src, x86_opnd_t dst) {
+  if (same(src, dst)) return;
+  if (src.kind == XO_IMM) {
+    emit(X_MOV, dst.kind == XO_REG ? 4 : 8, src, dst);
+    return;
+  }
+  if (src.kind == XO_MEM && dst.kind == XO_MEM) {
+    emit(X_MOV, 8, src, reg(R11));
+    src = reg(R11);
+  }
+  emit(X_MOV, 8, src, dst);
+}
+
+// 把若干个值同时搬到目标位置，目标寄存器互相作为源时用 %r11 打破环
+static void parallel_move(int n, x86_opnd_t *src, x86_opnd_t *dst) {
+  bool *done = (bool *) calloc((unsigned) n + 1, sizeof(bool));
+  int left = n;
+  while (left) {
+    bool progress = false;
+    for (int i = 0; i < n; i++) {
+      if (done[i]) continue;
+      bool blocked = false;
+      for (int j = 0; j < n && !blocked; j++)
+        if (j != i && !done[j] && dst[i].kind == XO_REG && src[j].kind == XO_REG && src[j].reg == dst[i].reg)
+          blocked = true;
+      if (blocked) continue;
+      move(src[i], dst[i]);
+      done[i] = true;
+      left--;
+      progress = true;
+    }
+    if (progress) continue;
+    // 只剩下寄存器之间的环
+    for (int i = 0; i < n; i++) {
+      if (done[i]) continue;
+      emit(X_MOV, 8, dst[i], reg(R11));
+      for (int j = 0; j < n; j++)
+        if (!done[j] && src[j].kind == XO_REG && src[j].reg == dst[i].reg)
+          src[j] = reg(R11);
+      break;
+    }
+  }
+  free(done);
+}
+
+static int cc_of(ir_op_t op) {
+  switch (op) {
+    case IR_LT: return CC_L;
+    case IR_LE: return CC_LE;
+    case IR_GT: return CC_G;
+    case IR_GE: return CC_GE;
+    case IR_EQ: return CC_E;
+    default: return CC_NE;
+  }
+}
+
+// 交换比较的两个操作数后对应的条件码
+static int swap_cc(int cc) {
+  switch (cc) {
+    case CC_L: return CC_G;
+    case CC_G: return CC_L;
+    case CC_LE: return CC_GE;
+    case CC_GE: return CC_LE;
+    default: return cc;
+  }
+}
+
+static void gen_arith(ir_inst_t *inst) {
+  x86_op_t op = inst->op == IR_ADD ? X_ADD : inst->op == IR_SUB ? X_SUB : X_IMUL;
+  bool commutative = op != X_SUB;
+  x86_opnd_t a = val(inst->a), b = val(inst->b), d = loc(inst->dst), t = d;
+  if (commutative && a.kind == XO_IMM) {
+    x86_opnd_t tmp = a;
+    a = b;
+    b = tmp;
+  }
+  if (d.kind == XO_REG && same(b, d) && !same(a, d)) {
+    if (commutative) {
+      b = a;
+      a = d;
+    } else {
+      t = reg(R11);
+    }
+  }
+  if (t.kind != XO_REG) t = reg(R11);
+  move(a, t);
+  if (op == X_IMUL && b.kind == XO_IMM) {
+    emit(X_IMUL, 4, t, t)->imm = b;
+  } else {
+    emit(op, 4, b, t);
+  }
+  move(t, d);
+}
+
+// 报告运行时错误的桩 fn 的标签，桩在函数末尾生成
+static int fail_stub(int lineno, int fn) {
+  if (nfails == cap_fails) {
+    cap_fails = cap_fails ? 2 * cap_fails : 16;
+    fail_label = (int *) realloc(fail_label, (unsigned) cap_fails * sizeof(int));
+    fail_line = (int *) realloc(fail_line, (unsigned) cap_fails * sizeof(int));
+    fail_func = (int *) realloc(fail_func, (unsigned) cap_fails * sizeof(int));
+  }
+  fail_label[nfails] = xf->nlabels++;
+  fail_line[nfails] = lineno;
+  fail_func[nfails] = fn;
+  return fail_label[nfails++];
+}
+
+// 和 ir_eval 一致：除数为 0 时报告错误，除数为 -1 时取相反数（INT_MIN / -1 为 INT_MIN），idiv 不会产生 SIGFPE
+static void gen_div(ir_inst_t *inst) {
+  x86_opnd_t b = val(inst->b);
+  if (b.kind == XO_IMM) {
+    if (b.disp == 0) {
+      jump(X_JMP, 0, fail_stub(inst->lineno, DIV_FAIL));
+      return;
+    }
+    move(val(inst->a), reg(RAX));
+    if (b.disp == -1) {
+      emit(X_IMUL, 4, reg(RAX), reg(RAX))->imm = imm(-1);
+    } else {
+      move(b, reg(R11));
+      emit(X_CDQ, 4, none(), none());
+      emit(X_IDIV, 4, reg(R11), none());
+    }
+    move(reg(RAX), loc(inst->dst));
+    return;
+  }
+  int neg = xf->nlabels++, done = xf->nlabels++;
+  if (b.kind == XO_REG) emit(X_TEST, 4, b, b);
+  else emit(X_CMP, 4, imm(0), b);
+  jump(X_JCC, CC_E, fail_stub(inst->lineno, DIV_FAIL));
+  move(val(inst->a), reg(RAX));
+  emit(X_CMP, 4, imm(-1), b);
+  jump(X_JCC, CC_E, neg);
+  emit(X_CDQ, 4, none(), none());
+  emit(X_IDIV, 4, b, none());
+  jump(X_JMP, 0, done);
+  emit(X_LABEL, 8, symbol(XO_LABEL, neg), none());
+  emit(X_IMUL, 4, reg(RAX), reg(RAX))->imm = imm(-1);
+  emit(X_LABEL, 8, symbol(XO_LABEL, done), none());
+  move(reg(RAX), loc(inst->dst));
+}
+
+// 比较 inst 的两个操作数，返回成立时的条件码
+static int gen_cmp(ir_inst_t *inst) {
+  x86_opnd_t a = val(inst->a), b = val(inst->b);
+  int cc = cc_of(inst->op);
+  if (a.kind == XO_IMM && b.kind != XO_IMM) {
+    x86_opnd_t tmp = a;
+    a = b;
+    b = tmp;
+    cc = swap_cc(cc);
+  }
+  if (a.kind == XO_IMM || (a.kind == XO_MEM && b.kind == XO_MEM)) {
+    move(a, reg(R11));
+    a = reg(R11);
+  }
+  emit(X_CMP, 4, b, a);
+  return cc;
+}
+
+static void gen_setcc(ir_inst_t *inst) {
+  int cc = gen_cmp(inst);
+  x86_opnd_t d = loc(inst->dst), t = d.kind == XO_REG ? d : reg(R11);
+  emit(X_SETCC, 1, none(), t)->cc = cc;
+  emit(X_MOVZBL, 4, t, t);
+  move(t, d);
+}
+
+// 数组元素的内存操作数，首地址溢出时放在 %r10，下标放在 %r11
+static x86_opnd_t element(ir_val_t base, ir_val_t index) {
+  x86_opnd_t b = val(base);
+  if (b.kind != XO_REG) {
+    emit(X_MOV, 8, b, reg(R10));
+    b = reg(R10);
+  }
+  if (index.kind == IRV_IMM)
+    return mem(b.reg, -1, 1, (int) (4u * (unsigned) index.val));
+  emit(X_MOVSLQ, 8, val(index), reg(R11));
+  return mem(b.reg, R11, 4, 0);
+}
+
+// 读取 32 位的内存操作数到虚拟寄存器 dst
+static void load32(x86_opnd_t m, int dst) {
+  x86_opnd_t d = loc(dst);
+  if (d.kind == XO_REG) {
+    emit(X_MOV, 4, m, d);
+  } else {
+    emit(X_MOV, 4, m, reg(R11));
+    move(reg(R11), d);
+  }
+}
+
+static void store32(ir_val_t v, x86_opnd_t m) {
+  x86_opnd_t s = val(v);
+  if (s.kind == XO_MEM) {
+    emit(X_MOV, 4, s, reg(RAX));
+    s = reg(RAX);
+  }
+  emit(X_MOV, 4, s, m);
+}
+
+static void lea(x86_opnd_t m, int dst) {
+  x86_opnd_t d = loc(dst);
+  x86_opnd_t t = d.kind == XO_REG ? d : reg(R11);
+  emit(X_LEA, 8, m, t);
+  move(t, d);
+}
+
+// 无符号比较同时排除负数下标，越界时跳到函数末尾的桩，正常路径上不跳转
+static void gen_check(ir_inst_t *inst) {
+  x86_opnd_t a = val(inst->a), b = val(inst->b);
+  if (a.kind == XO_IMM || (a.kind == XO_MEM && b.kind == XO_MEM)) {
+    move(a, reg(R11));
+    a = reg(R11);
+  }
+  emit(X_CMP, 4, b, a);
+  jump(X_JCC, CC_AE, fail_stub(inst->lineno, BOUNDS_FAIL));
+}
+
+static void gen_call(ir_inst_t *inst) {
+  int n = inst->nargs;
+  int nstack = n > 6 ? n - 6 : 0, pad = nstack % 2 ? 8 : 0;
+  // 第 7 个起的参数从右往左压栈，保持调用时 %rsp 16 字节对齐
+  if (pad) emit(X_SUB, 8, imm(pad), reg(RSP));
+  for (int i = n - 1; i >= 6; i--)
+    emit(X_PUSH, 8, val(inst->args[i]), none());
+  int nreg = n < 6 ? n : 6;
+  x86_opnd_t src[6], dst[6];
+  for (int i = 0; i < nreg; i++) {
+    src[i] = val(inst->args[i]);
+    dst[i] = reg(arg_regs[i]);
+  }
+  parallel_move(nreg, src, dst);
+  emit(X_CALL, 8, symbol(XO_FUNC, inst->sym), none());
+  if (nstack + pad / 8) emit(X_ADD, 8, imm(8 * nstack + pad), reg(RSP));
+  if (inst->dst >= 0) move(reg(RAX), loc(inst->dst));
+  if (16 + frame + 8 * nstack + pad > xf->frame_bytes) xf->frame_bytes = 16 + frame + 8 * nstack + pad;
+}
+
+// 恢复被调用者保存寄存器，弹出栈帧；之后 %rsp 指向返回地址
+static void gen_leave(void) {
+  int k = 0;
+  for (int r = 0; r < REG_CNT; r++)
+    if (ra->callee_used[r]) {
+      emit(X_MOV, 8, mem(RBP, -1, 1, -8 * (k + 1)), reg(r));
+      k++;
+    }
+  emit(X_LEAVE, 8, none(), none());
+}
+
+// 被调函数的栈上参数不能多于当前函数自己的，这样才能放进调用者为当前函数准备的位置
+static bool can_tail_call(int block, int i) {
+  ir_inst_t *inst = &func->blocks[block].insts[i];
+  return ir_is_tail_call(prog, func, &func->blocks[block], i) && (inst->nargs <= 6 || inst->nargs <= func->nparams);
+}
+
+// 尾调用：实参就位后弹出当前的栈帧，跳到被调函数，由它直接返回到当前函数的调用者。
+// 栈上的实参先压栈，寄存器实参就位后再依次搬到 16(%rbp) 起当前函数自己的栈上参数的位置，
+// 那里的参数已经在函数入口搬到了分配的位置，可以覆盖
+static void gen_tail_call(ir_inst_t *inst) {
+  int n = inst->nargs;
+  x86_tail_calls++;
+  // 调用自己并且没有局部数组时，实参直接搬到参数分配的位置，跳回入口的基本块
+  if (prog->funcs[inst->sym] == func && func->narrays == 0) {
+    x86_opnd_t *src = (x86_opnd_t *) malloc((unsigned) (n + 1) * sizeof(x86_opnd_t));
+    x86_opnd_t *dst = (x86_opnd_t *) malloc((unsigned) (n + 1) * sizeof(x86_opnd_t));
+    int m = 0;
+    bool in_memory = false;
+    for (int i = 0; i < n; i++) {
+      if (ra->reg[i] < 0 && ra->slot[i] < 0) continue;
+      src[m] = val(inst->args[i]);
+      dst[m] = loc(i);
+      in_memory |= dst[m++].kind == XO_MEM;
+    }
+    // 栈槽之间可能互为源和目标，经过栈搬运
+    if (in_memory) {
+      for (int i = 0; i < m; i++)
+        emit(X_PUSH, 8, src[i], none());
+      for (int i = m - 1; i >= 0; i--) {
+        emit(X_POP, 8, none(), reg(R11));
+        move(reg(R11), dst[i]);
+      }
+    } else {
+      parallel_move(m, src, dst);
+    }
+    free(src);
+    free(dst);
+    jump(X_JMP, 0, 0);
+    return;
+  }
+  for (int i = n - 1; i >= 6; i--)
+    emit(X_PUSH, 8, val(inst->args[i]), none());
+  int nreg = n < 6 ? n : 6;
+  x86_opnd_t src[6], dst[6];
+  for (int i = 0; i < nreg; i++) {
+    src[i] = val(inst->args[i]);
+    dst[i] = reg(arg_regs[i]);
+  }
+  parallel_move(nreg, src, dst);
+  for (int i = 6; i < n; i++) {
+    emit(X_POP, 8, none(), reg(R11));
+    emit(X_MOV, 8, reg(R11), mem(RBP, -1, 1, 16 + 8 * (i - 6)));
+  }
+  gen_leave();
+  emit(X_JMP, 8, symbol(XO_FUNC, inst->sym), none());
+}
+
+static void gen_branch(int block, int cc, int target, int other) {
+  if (target == block + 1) {
+    jump(X_JCC, cc ^ 1, other);
+  } else {
+    jump(X_JCC, cc, target);
+    if (other != block + 1) jump(X_JMP, 0, other);
+  }
+}
+
+static bool is_cmp(ir_op_t op) {
+  return op >= IR_LT && op <= IR_NE;
+}
+
+static void gen_block(int b) {
+  ir_block_t *bb = &func->blocks[b];
+  emit(X_LABEL, 8, symbol(XO_LABEL, b), none());
+  for (int i = 0; i < bb->size; i++) {
+    ir_inst_t *inst = &bb->insts[i];
+    // 只被紧随其后的 br 使用的比较直接生成 cmp + jcc
+    if (is_cmp(inst->op) && i == bb->size - 2) {
+      ir_inst_t *br = &bb->insts[i + 1];
+      if (br->op == IR_BR && br->a.kind == IRV_REG && br->a.val == inst->dst && !bit_test(ra->live->out[b], inst->dst)) {
+        gen_branch(b, gen_cmp(inst), br->target[0], br->target[1]);
+        return;
+      }
+    }
+    switch (inst->op) {
+      case IR_NOP:
+        break;
+      case IR_MOV:
+        move(val(inst->a), loc(inst->dst));
+        break;
+      case IR_ADD: case IR_SUB: case IR_MUL:
+        gen_arith(inst);
+        break;
+      case IR_DIV:
+        gen_div(inst);
+        break;
+      case IR_LT: case IR_LE: case IR_GT: case IR_GE: case IR_EQ: case IR_NE:
+        gen_setcc(inst);
+        break;
+      case IR_GLOAD:
+        load32(symbol(XO_GLOBAL, inst->sym), inst->dst);
+        break;
+      case IR_GSTORE:
+        store32(inst->a, symbol(XO_GLOBAL, inst->sym));
+        break;
+      case IR_GADDR:
+        lea(symbol(XO_GLOBAL, inst->sym), inst->dst);
+        break;
+      case IR_LADDR:
+        lea(mem(RBP, -1, 1, array_offset[inst->sym]), inst->dst);
+        break;
+      case IR_LOAD:
+        load32(element(inst->a, inst->b), inst->dst);
+        break;
+      case IR_STORE:
+        store32(inst->c, element(inst->a, inst->b));
+        break;
+      case IR_LEN:
+        load32(element(inst->a, ir_imm(-1)), inst->dst);
+        break;
+      case IR_CHECK:
+        gen_check(inst);
+        break;
+      case IR_CALL:
+        if (can_tail_call(b, i)) {
+          gen_tail_call(inst);
+          return;
+        }
+        gen_call(inst);
+        break;
+      case IR_JMP:
+        if (inst->target[0] != b + 1) jump(X_JMP, 0, inst->target[0]);
+        break;
+      case IR_BR: {
+        x86_opnd_t c = val(inst->a);
+        if (c.kind == XO_IMM) {
+          int target = inst->target[c.disp ? 0 : 1];
+          if (target != b + 1) jump(X_JMP, 0, target);
+          break;
+        }
+        if (c.kind == XO_REG) emit(X_TEST, 4, c, c);
+        else emit(X_CMP, 4, imm(0), c);
+        gen_branch(b, CC_NE, inst->target[0], inst->target[1]);
+        break;
+      }
+      case IR_RET:
+        if (inst->a.kind != IRV_NONE) move(val(inst->a), reg(RAX));
+        if (b != func->nblocks - 1) jump(X_JMP, 0, epilogue_label);
+        break;
+      default:
+        assert(0);
+    }
+  }
+}
+
+static void gen_prologue(void) {
+  emit(X_PUSH, 8, reg(RBP), none());
+  emit(X_MOV, 8, reg(RSP), reg(RBP));
+  // 栈按 -max-depth 层最大的栈帧分配（见 x86_stack_size），用完时在分配栈帧之前报告；
+  // 只读不写，不像计数器那样让每次调用都依赖上一次的写入
+  emit(X_CMP, 8, symbol(XO_GLOBAL, STACK_LIMIT), reg(RSP));
+  jump(X_JCC, CC_B, depth_label);
+
+  int saved[REG_CNT];
+  nsaved = 0;
+  for (int r = 0; r < REG_CNT; r++)
+    if (ra->callee_used[r]) saved[nsaved++] = r;
+  frame = 8 * (nsaved + ra->nslots);
+  array_offset = (int *) malloc((unsigned) func->narrays * sizeof(int) + 1);
+  // 每个数组前面是保存长度的一个 int
+  for (int i = 0; i < func->narrays; i++) {
+    frame += (4 * (func->array_size[i] + 1) + 7) / 8 * 8;
+    array_offset[i] = -frame + 4;
+  }
+  frame = (frame + 15) / 16 * 16;
+  xf->frame_bytes = 16 + frame;
+  if (frame) emit(X_SUB, 8, imm(frame), reg(RSP));
+  for (int k = 0; k < nsaved; k++)
+    emit(X_MOV, 8, reg(saved[k]), mem(RBP, -1, 1, -8 * (k + 1)));
+
+  // 参数从调用约定规定的位置搬到分配的位置
+  x86_opnd_t *src = (x86_opnd_t *) malloc((unsigned) (func->nparams + 1) * sizeof(x86_opnd_t));
+  x86_opnd_t *dst = (x86_opnd_t *) malloc((unsigned) (func->nparams + 1) * sizeof(x86_opnd_t));
+  int n = 0;
+  for (int i = 0; i < func->nparams; i++) {
+    if (ra->reg[i] < 0 && ra->slot[i] < 0) continue;
+    src[n] = i < 6 ? reg(arg_regs[i]) : mem(RBP, -1, 1, 16 + 8 * (i - 6));
+    dst[n++] = loc(i);
+  }
+  parallel_move(n, src, dst);
+  free(src);
+  free(dst);
+
+  // 局部数组按 0 初始化
+  for (int i = 0; i < func->narrays; i++) {
+    int size = func->array_size[i];
+    emit(X_MOV, 4, imm(size), mem(RBP, -1, 1, array_offset[i] - 4));
+    if (size <= 8) {
+      for (int k = 0; k < size; k++)
+        emit(X_MOV, 4, imm(0), mem(RBP, -1, 1, array_offset[i] + 4 * k));
+      continue;
+    }
+    int loop = xf->nlabels++;
+    emit(X_LEA, 8, mem(RBP, -1, 1, array_offset[i]), reg(R11));
+    emit(X_MOV, 4, imm(size), reg(RAX));
+    emit(X_LABEL, 8, symbol(XO_LABEL, loop), none());
+    emit(X_MOV, 4, imm(0), mem(R11, -1, 1, 0));
+    emit(X_ADD, 8, imm(4), reg(R11));
+    emit(X_SUB, 4, imm(1), reg(RAX));
+    jump(X_JCC, CC_NE, loop);
+  }
+}
+
+static void gen_epilogue(void) {
+  emit(X_LABEL, 8, symbol(XO_LABEL, epilogue_label), none());
+  gen_leave();
+  emit(X_RET, 8, none(), none());
+  // 调用过深的桩，不返回
+  emit(X_LABEL, 8, symbol(XO_LABEL, depth_label), none());
+  emit(X_MOV, 4, imm(func->lineno), reg(RDI));
+  emit(X_CALL, 8, symbol(XO_FUNC, DEPTH_FAIL), none());
+  // 下标越界和除以 0 的桩，不返回
+  for (int i = 0; i < nfails; i++) {
+    emit(X_LABEL, 8, symbol(XO_LABEL, fail_label[i]), none());
+    emit(X_MOV, 4, imm(fail_line[i]), reg(RDI));
+    emit(X_CALL, 8, symbol(XO_FUNC, fail_func[i]), none());
+  }
+}
+
+// 对第 f 个函数做指令选择，allocate 为假时不做寄存器分配，所有值都放在栈上
+x86_func_t *x86_select(ir_prog_t *p, int f, bool allocate) {
+  prog = p;
+  func = prog->funcs[f];
+  xf = (x86_func_t *) calloc(1, sizeof(x86_func_t));
+  xf->func = f;
+  ra = xf->ra = linear_scan(func, allocate);
+  // 标签 0 .. nblocks-1 对应基本块，nblocks 是函数出口，nblocks+1 是调用过深的桩
+  epilogue_label = func->nblocks;
+  depth_label = func->nblocks + 1;
+  xf->nlabels = func->nblocks + 2;
+  nfails = 0;
+
+  gen_prologue();
+  for (int b = 0; b < func->nblocks; b++)
+    gen_block(b);
+  gen_epilogue();
+  free(array_offset);
+  return xf;
+}
+
+// 容纳 max_depth 层调用的栈，每层按最大的栈帧计算（至少 256 字节，其他源文件中的函数的栈帧未知）。
+// 栈底是保护页，之上留出一个栈帧和 1 MB 给最后一层的栈帧和 input、output 等运行时函数，*limit 是栈的下限相对栈底的偏移。
+// 所以限制的是栈的字节数而不是调用数，栈帧较小的函数可以超过 max_depth 层
+size_t x86_stack_size(int max_frame, size_t *limit) {
+  if (max_frame < 256) max_frame = 256;
+  *limit = ((size_t) STACK_GUARD + (size_t) max_frame + (1u << 20) + 15) / 16 * 16;
+  return ((size_t) max_depth * (size_t) max_frame + *limit + 4095) / 4096 * 4096;
+}
+
+int x86_prog_size(ir_prog_t *p, x86_func_t **funcs) {
+  int n = 0;
+  for (int f = 0; f < p->nfuncs; f++) {
+    if (funcs[f] == NULL) continue;
+    for (int i = 0; i < funcs[f]->size; i++)
+      if (funcs[f]->insts[i].op != X_LABEL) n++;
+  }
+  return n;
+}
+
+static const char *reg_name[3][REG_CNT] = {
+  {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+  {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+  {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"},
+};
+
+static const char *cc_name[16] = {
+  [CC_B] = "b", [CC_AE] = "ae", [CC_E] = "e", [CC_NE] = "ne", [CC_L] = "l", [CC_GE] = "ge", [CC_LE] = "le", [CC_G] = "g",
+};
+
+static const char *op_name[X_OP_CNT] = {
+  [X_MOV] = "mov", [X_LEA] = "lea", [X_ADD] = "add", [X_SUB] = "sub", [X_IMUL] = "imul",
+  [X_CMP] = "cmp", [X_TEST] = "test", [X_IDIV] = "idiv", [X_PUSH] = "push", [X_POP] = "pop",
+};
+
+static void print_opnd(x86_func_t *f, x86_opnd_t o, int size) {
+  switch (o.kind) {
+    case XO_REG:
+      printf("%%%s", reg_name[size == 1 ? 0 : size == 4 ? 1 : 2][o.reg]);
+      break;
+    case XO_IMM:
+      printf("$%d", o.disp);
+      break;
+    case XO_MEM:
+      if (o.disp) printf("%d", o.disp);
+      if (o.index >= 0) printf("(%%%s,%%%s,%d)", reg_name[2][o.reg], reg_name[2][o.index], o.scale);
+      else printf("(%%%s)", reg_name[2][o.reg]);
+      break;
+    case XO_GLOBAL:
+      if (o.sym == STACK_LIMIT) printf("cm_stack_limit(%%rip)");
+      else printf("cm_%s(%%rip)", prog->globals[o.sym].name);
+      break;
+    case XO_LABEL:
+      printf(".L%d_%d", f->func, o.sym);
+      break;
+    case XO_FUNC:
+      if (o.sym == BOUNDS_FAIL) printf("cm_bounds_fail");
+      else if (o.sym == DEPTH_FAIL) printf("cm_depth_fail");
+      else if (o.sym == DIV_FAIL) printf("cm_div_fail");
+      else printf("cm_%s", prog->funcs[o.sym]->name);
+      break;
+  }
+}
+
+static void print_inst(x86_func_t *f, x86_inst_t *inst) {
+  char suffix = inst->size == 1 ? 'b' : inst->size == 4 ? 'l' : 'q';
+  switch (inst->op) {
+    case X_LABEL:
+      print_opnd(f, inst->src, 8);
+      printf(":\n");
+      return;
+    case X_MOVSLQ:
+      printf("  movslq ");
+      print_opnd(f, inst->src, 4);
+      printf(", ");
+      print_opnd(f, inst->dst, 8);
+      break;
+    case X_MOVZBL:
+      printf("  movzbl ");
+      print_opnd(f, inst->src, 1);
+      printf(", ");
+      print_opnd(f, inst->dst, 4);
+      break;
+    case X_CDQ:
+      printf("  cltd");
+      break;
+    case X_SETCC:
+      printf("  set%s ", cc_name[inst->cc]);
+      print_opnd(f, inst->dst, 1);
+      break;
+    case X_JMP:
+      printf("  jmp ");
+      print_opnd(f, inst->src, 8);
+      break;
+    case X_JCC:
+      printf("  j%s ", cc_name[inst->cc]);
+      print_opnd(f, inst->src, 8);
+      break;
+    case X_CALL:
+      printf("  call ");
+      print_opnd(f, inst->src, 8);
+      break;
+    case X_RET:
+      printf("  ret");
+      break;
+    case X_LEAVE:
+      printf("  leave");
+      break;
+    default:
+      printf("  %s%c ", op_name[inst->op], suffix);
+      if (inst->imm.kind != XO_NONE) {
+        print_opnd(f, inst->imm, inst->size);
+        printf(", ");
+      }
+      if (inst->src.kind != XO_NONE) print_opnd(f, inst->src, inst->size);
+      if (inst->src.kind != XO_NONE && inst->dst.kind != XO_NONE) printf(", ");
+      if (inst->dst.kind != XO_NONE) print_opnd(f, inst->dst, inst->size);
+  }
+  printf("\n");
+}
+
+// 运行时：input/output 通过 libc 实现，C 的 main 在 mmap 得到的 stack 字节的栈上调用 C-Minus 的 main
+static void print_runtime(ir_prog_t *p, size_t stack, size_t limit) {
+  printf("\n"
+         "cm_input:\n"
+         "  pushq %%rbp\n"
+         "  movq %%rsp, %%rbp\n"
+         "  subq $16, %%rsp\n"
+         "  movl $0, -4(%%rbp)\n"
+         "  leaq -4(%%rbp), %%rsi\n"
+         "  leaq .Lfmt_in(%%rip), %%rdi\n"
+         "  xorl %%eax, %%eax\n"
+         "  call scanf@PLT\n"
+         "  movl -4(%%rbp), %%eax\n"
+         "  leave\n"
+         "  ret\n"
+         "\n"
+         "cm_output:\n"
+         "  pushq %%rbp\n"
+         "  movq %%rsp, %%rbp\n"
+         "  movl %%edi, %%esi\n"
+         "  leaq .Lfmt_out(%%rip), %%rdi\n"
+         "  xorl %%eax, %%eax\n"
+         "  call printf@PLT\n"
+         "  popq %%rbp\n"
+         "  ret\n"
+         "\n"
+         "cm_bounds_fail:\n"
+         "  leaq .Lfmt_bounds(%%rip), %%rsi\n"
+         "  jmp .Lruntime_error\n"
+         "\n"
+         "cm_div_fail:\n"
+         "  leaq .Lfmt_div(%%rip), %%rsi\n"
+         "  jmp .Lruntime_error\n"
+         "\n"
+         "cm_depth_fail:\n"
+         "  leaq .Lfmt_depth(%%rip), %%rsi\n"
+         ".Lruntime_error:\n"
+         "  pushq %%rbp\n"
+         "  movq %%rsp, %%rbp\n"
+         "  pushq %%rdi\n"
+         "  pushq %%rsi\n"
+         "  xorl %%edi, %%edi\n"
+         "  call fflush@PLT\n"
+         "  movl -8(%%rbp), %%edx\n"
+         "  movq -16(%%rbp), %%rsi\n"
+         "  movq stderr@GOTPCREL(%%rip), %%rax\n"
+         "  movq (%%rax), %%rdi\n"
+         "  xorl %%eax, %%eax\n"
+         "  call fprintf@PLT\n"
+         "  movl $255, %%edi\n"
+         "  call exit@PLT\n");
+  // main 在其他源文件中时由那个文件提供入口
+  int m = ir_find_func(p, "main");
+  if (m >= 0 && !p->funcs[m]->external) {
+    int n = p->funcs[m]->nparams;
+    int nstack = n > 6 ? n - 6 : 0;
+    // mmap 失败时报告错误并退出，不在原来的栈上不检查深度地运行
+    printf("\n"
+           "  .globl main\n"
+           "main:\n"
+           "  pushq %%rbp\n"
+           "  movq %%rsp, %%rbp\n"
+           "  xorl %%edi, %%edi\n"
+           "  movabsq $%zu, %%rsi\n"
+           "  movl $3, %%edx\n"
+           "  movl $0x4022, %%ecx\n"
+           "  movl $-1, %%r8d\n"
+           "  xorl %%r9d, %%r9d\n"
+           "  call mmap@PLT\n"
+           "  cmpq $-1, %%rax\n"
+           "  je .Lno_stack\n"
+           "  leaq %zu(%%rax), %%rdx\n"
+           "  movq %%rdx, cm_stack_limit(%%rip)\n"
+           "  movabsq $%zu, %%rsp\n"
+           "  addq %%rax, %%rsp\n"
+           "  movq %%rax, %%rdi\n"
+           "  movl $%d, %%esi\n"
+           "  xorl %%edx, %%edx\n"
+           "  call mprotect@PLT\n", stack, limit, stack, STACK_GUARD);
+    if (nstack % 2) printf("  pushq $0\n");
+    for (int i = 0; i < nstack; i++) printf("  pushq $0\n");
+    for (int i = 0; i < n && i < 6; i++) printf("  xorl %%%s, %%%s\n", reg_name[1][arg_regs[i]], reg_name[1][arg_regs[i]]);
+    printf("  call cm_main\n"
+           "  leave\n"
+           "  ret\n"
+           ".Lno_stack:\n"
+           "  movq stderr@GOTPCREL(%%rip), %%rax\n"
+           "  movq (%%rax), %%rsi\n"
+           "  leaq .Lmsg_stack(%%rip), %%rdi\n"
+           "  call fputs@PLT\n"
+           "  movl $255, %%edi\n"
+           "  call exit@PLT\n");
+  }
+  printf("\n"
+         "  .section .rodata\n"
+         ".Lfmt_in:\n"
+         "  .string \"%%d\"\n"
+         ".Lfmt_out:\n"
+         "  .string \"%%d\\n\"\n"
+         ".Lfmt_bounds:\n"
+         "  .string \"Runtime error at line %%d (array index out of bounds)\\n\"\n"
+         ".Lfmt_div:\n"
+         "  .string \"Runtime error at line %%d (division by zero)\\n\"\n"
+         ".Lfmt_depth:\n"
+         "  .string \"Runtime error at line %%d (recursion too deep)\\n\"\n"
+         ".Lmsg_stack:\n"
+         "  .string \"Runtime error (cannot map %zu KB of stack for -max-depth)\\n\"\n", stack / 1024);
+}
+
+void x86_print(ir_prog_t *p, x86_func_t **funcs) {
+  prog = p;
+  printf("  .text\n");
+  int max_frame = 0;
+  for (int f = 0; f < p->nfuncs; f++) {
+    if (funcs[f] == NULL) continue;
+    if (funcs[f]->frame_bytes > max_frame) max_frame = funcs[f]->frame_bytes;
+    const char *name = p->funcs[f]->name;
+    printf("\n  .globl cm_%s\n  .type cm_%s, @function\ncm_%s:\n", name, name, name);
+    for (int i = 0; i < funcs[f]->size; i++)
+      print_inst(funcs[f], &funcs[f]->insts[i]);
+  }
+  size_t limit, stack = x86_stack_size(max_frame, &limit);
+  print_runtime(p, stack, limit);
+  // 栈的下限由所有源文件共用
+  printf("\n  .comm cm_stack_limit,8,8\n");
+  if (p->nglobals) printf("\n  .bss\n");
+  for (int g = 0; g < p->nglobals; g++) {
+    if (p->globals[g].external || p->globals[g].size) continue;
+    printf("  .globl cm_%s\n  .p2align 2\ncm_%s:\n  .zero 4\n", p->globals[g].name, p->globals[g].name);
+  }
+  // 数组前面的长度不为 0，放在 .data 中
+  if (p->nglobals) printf("\n  .data\n");
+  for (int g = 0; g < p->nglobals; g++) {
+    if (p->globals[g].external || p->globals[g].size == 0) continue;
+    printf("  .p2align 2\n  .long %d\n  .globl cm_%s\ncm_%s:\n  .zero %d\n", p->globals[g].size, p->globals[g].name, p->globals[g].name,
+           4 * p->globals[g].size);
+  }
+  printf("\n  .section .note.GNU-stack,\"\",@progbits\n");
+}
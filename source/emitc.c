@@ -0,0 +1,533 @@
+#include <emitc.h>
+#include <limits.h>
+
+// 局部名字。C 中的名字是 cm_ 加上原来的名字；C 的参数和函数体最外层的变量在同一个作用域中，
+// 局部名字也会遮住同名的函数，这两种情况下再加上编号（C-minus 的名字里没有下划线和数字，不会冲突）
+typedef struct name_t {
+  char name[64];
+  char cname[80];
+  bool array;
+  int depth;
+} name_t;
+
+static ir_prog_t *ir;
+static const char *source_path;
+static FILE *out;             // 为 NULL 时只统计函数需要的临时变量和数组，不输出
+static int mapped;            // 下一行输出对应的源程序行号，-1 表示还没有输出 #line
+static int level;             // 缩进层数
+
+static name_t *names;
+static int name_cnt, name_cap, depth, renamed;
+
+static int ntemps;            // 函数中的临时变量 meow_t1 .. meow_tN
+static int *hoisted;          // 嵌套语句块中的局部数组 meow_a1 .. meow_aN 的长度
+static int nhoisted, hoisted_cap;
+
+#define child(NODE, I) ((NODE)->symbol.child[I])
+#define size(NODE) ((NODE)->symbol.size)
+
+static void emit_expr(syntax_t *node);
+static void emit_stmt(syntax_t *node);
+
+static bool is_sym(syntax_t *node, const char *name) {
+  return node->type == SYMBOL && strcmp(node->symbol.name, name) == 0;
+}
+
+static bool is_tok(syntax_t *node, const char *name) {
+  return node->type == TOKEN && strcmp(node->token.name, name) == 0;
+}
+
+static void put(const char *fmt, ...) {
+  if (out == NULL) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(out, fmt, ap);
+  va_end(ap);
+}
+
+// 开始新的一行；lineno 与下一行已经对应的行号不同时先输出 #line，lineno 为 0 时沿用之前的对应
+static void begin_line(int lineno) {
+  if (out != NULL && lineno > 0 && lineno != mapped) {
+    fprintf(out, "#line %d \"", lineno);
+    for (const char *p = source_path; *p; p++) {
+      if (*p == '"' || *p == '\\') fputc('\\', out);
+      fputc(*p, out);
+    }
+    fprintf(out, "\"\n");
+    mapped = lineno;
+  }
+  put("%*s", 2 * level, "");
+}
+
+static void end_line(void) {
+  put("\n");
+  if (mapped >= 0) mapped++;
+}
+
+static int parse_int(syntax_t *tok) {
+  return (int) (unsigned) strtoul(tok->token.value, NULL, 10);
+}
+
+// 和 lower.c 相同：收集左嵌套或平坦的 param_list/arg_list 中的各项，items 为 NULL 时只计数
+static int collect_list(syntax_t *node, const char *list, syntax_t **items) {
+  if (!is_sym(node, list)) {
+    if (items) items[0] = node;
+    return 1;
+  }
+  // 只有一项的列表和平坦的列表（-F）直接是各项本身
+  if (is_flat_list(node)) {
+    for (int i = 0; items && i < size(node); i++)
+      items[i] = child(node, i);
+    return size(node);
+  }
+  int n = collect_list(child(node, 0), list, items);
+  if (items) items[n] = child(node, 2);
+  return n + 1;
+}
+
+static name_t *find_name(const char *name) {
+  for (int i = name_cnt - 1; i >= 0; i--)
+    if (strcmp(names[i].name, name) == 0)
+      return &names[i];
+  return NULL;
+}
+
+static const char *declare_name(syntax_t *id, bool array, bool clash) {
+  if (name_cnt == name_cap) {
+    name_cap = name_cap ? 2 * name_cap : 16;
+    names = (name_t *) realloc(names, (unsigned) name_cap * sizeof(name_t));
+  }
+  name_t *n = &names[name_cnt++];
+  strcpy(n->name, id->token.value);
+  if (clash || ir_find_func(ir, id->token.value) >= 0)
+    snprintf(n->cname, sizeof(n->cname), "cm_%s_%d", id->token.value, ++renamed);
+  else
+    snprintf(n->cname, sizeof(n->cname), "cm_%s", id->token.value);
+  n->array = array;
+  n->depth = depth;
+  return n->cname;
+}
+
+static void pop_scope(void) {
+  while (name_cnt > 0 && names[name_cnt - 1].depth == depth)
+    name_cnt--;
+  depth--;
+}
+
+static bool is_array(syntax_t *id) {
+  name_t *local = find_name(id->token.value);
+  if (local != NULL) return local->array;
+  for (int g = 0; g < ir->nglobals; g++)
+    if (strcmp(ir->globals[g].name, id->token.value) == 0)
+      return ir->globals[g].size != 0;
+  return false;
+}
+
+static void emit_name(syntax_t *id) {
+  name_t *local = find_name(id->token.value);
+  if (local != NULL) put("%s", local->cname);
+  else put("cm_%s", id->token.value);
+}
+
+// 求值没有副作用：不含函数调用和赋值
+static bool pure(syntax_t *node) {
+  if (node->type == TOKEN) return true;
+  if (is_sym(node, "call") || (is_sym(node, "expression") && size(node) == 3)) return false;
+  for (int i = 0; i < size(node); i++)
+    if (!pure(child(node, i))) return false;
+  return true;
+}
+
+// 值与求值顺序无关：整数常量，或者作为实参的数组名
+static bool stable(syntax_t *node) {
+  for (;;) {
+    if (is_tok(node, "INT")) return true;
+    if (node->type != SYMBOL) return false;
+    if (is_sym(node, "var")) return size(node) == 1 && is_array(child(node, 0));
+    if (is_sym(node, "factor") && size(node) == 3) node = child(node, 1);
+    else if (size(node) == 1) node = child(node, 0);
+    else return false;
+  }
+}
+
+// C 不规定运算数和实参的求值顺序，C-minus 则从左到右求值。有运算数带副作用时，把除了最后一个以外
+// 受求值顺序影响的运算数依次存入临时变量，由逗号运算符保证先后。需要时输出左括号并返回 true
+static bool sequence(syntax_t **ops, int n, int *temps) {
+  int unstable = 0;
+  bool effects = false;
+  for (int i = 0; i < n; i++) {
+    temps[i] = 0;
+    if (!stable(ops[i])) unstable++;
+    if (!pure(ops[i])) effects = true;
+  }
+  if (!effects || unstable < 2) return false;
+  put("(");
+  for (int i = 0, k = 0; k < unstable - 1; i++) {
+    if (stable(ops[i])) continue;
+    temps[i] = ++ntemps;
+    k++;
+    put("meow_t%d = ", temps[i]);
+    emit_expr(ops[i]);
+    put(", ");
+  }
+  return true;
+}
+
+static void operand(syntax_t *node, int temp) {
+  if (temp) put("meow_t%d", temp);
+  else emit_expr(node);
+}
+
+static void emit_int(syntax_t *tok) {
+  int v = parse_int(tok);
+  if (v == INT_MIN) put("(-%d - 1)", INT_MAX);
+  else if (v < 0) put("(%d)", v);
+  else put("%d", v);
+}
+
+static void emit_var(syntax_t *node) {
+  // var -> ID | ID [ expression ]
+  emit_name(child(node, 0));
+  if (size(node) == 4) {
+    put("[");
+    emit_expr(child(node, 2));
+    put("]");
+  }
+}
+
+static void emit_call(syntax_t *node) {
+  // call -> ID ( args )，input/output 是生成的程序中的 cm_input/cm_output
+  syntax_t *id = child(node, 0), *a = child(node, 2);
+  int n = size(a) ? collect_list(child(a, 0), "arg_list", NULL) : 0;
+  syntax_t **args = (syntax_t **) malloc((unsigned) (n + 1) * sizeof(syntax_t *));
+  int *temps = (int *) malloc((unsigned) (n + 1) * sizeof(int));
+  if (n)
+    collect_list(child(a, 0), "arg_list", args);
+  bool paren = sequence(args, n, temps);
+  put("cm_%s(", id->token.value);
+  for (int i = 0; i < n; i++) {
+    if (i) put(", ");
+    operand(args[i], temps[i]);
+  }
+  put(paren ? "))" : ")");
+  free(args);
+  free(temps);
+}
+
+static void emit_assign(syntax_t *node) {
+  // expression -> var = expression，下标先于右边求值。右边有副作用时（例如 x = (x = 3) + 1）先存入临时变量，
+  // 否则写入和右边的赋值之间没有顺序点
+  syntax_t *var = child(node, 0), *rhs = child(node, 2);
+  int value = pure(rhs) ? 0 : ++ntemps;
+  if (size(var) == 4) {
+    syntax_t *ops[2] = {child(var, 2), rhs};
+    int temps[2];
+    bool paren = sequence(ops, 2, temps);
+    // 右边不纯时下标要么是常量，要么已由 sequence 存入临时变量
+    if (value) {
+      put(paren ? "meow_t%d = " : "(meow_t%d = ", value);
+      emit_expr(rhs);
+      put(", ");
+      temps[1] = value;
+    }
+    emit_name(child(var, 0));
+    put("[");
+    operand(ops[0], temps[0]);
+    put("] = ");
+    operand(ops[1], temps[1]);
+    if (paren || value) put(")");
+    return;
+  }
+  if (value) {
+    put("(meow_t%d = ", value);
+    emit_expr(rhs);
+    put(", ");
+  }
+  emit_name(child(var, 0));
+  put(" = ");
+  operand(rhs, value);
+  if (value) put(")");
+}
+
+// 运算符的优先级和结合性与 C 相同，括号都来自源程序中的 factor
+static void emit_expr(syntax_t *node) {
+  if (is_sym(node, "expression") && size(node) == 3) {
+    emit_assign(node);
+  } else if (is_sym(node, "factor")) {
+    syntax_t *c = child(node, 0);
+    if (is_tok(c, "INT")) {
+      emit_int(c);
+    } else if (is_tok(c, "LP")) {
+      put("(");
+      emit_expr(child(node, 1));
+      put(")");
+    } else if (is_sym(c, "call")) {
+      emit_call(c);
+    } else {
+      emit_var(c);
+    }
+  } else if (size(node) == 3) {
+    // simple_expression / additive_expression / term 的二元运算，除法检查除数是否为 0
+    syntax_t *ops[2] = {child(node, 0), child(node, 2)};
+    syntax_t *op = child(child(node, 1), 0);
+    int temps[2];
+    bool paren = sequence(ops, 2, temps);
+    if (is_tok(op, "DIV")) put("meow_div(");
+    operand(ops[0], temps[0]);
+    put(is_tok(op, "DIV") ? ", " : " %s ", op->token.value);
+    operand(ops[1], temps[1]);
+    if (is_tok(op, "DIV")) put(", %d)", node->symbol.lineno);
+    if (paren) put(")");
+  } else {
+    assert(size(node) == 1);
+    emit_expr(child(node, 0));
+  }
+}
+
+static void emit_local(syntax_t *node) {
+  // var_declaration -> type ID ; | type ID [ NUM ] ;
+  // 局部数组和解释器一样每次调用只分配一次：函数体最外层的直接声明，嵌套语句块中的提前到函数开头
+  syntax_t *id = child(node, 1);
+  name_t *param = find_name(id->token.value);
+  bool clash = depth == 2 && param != NULL && param->depth == 1;
+  bool array = size(node) == 6;
+  const char *cname = declare_name(id, array, clash);
+  begin_line(id->token.lineno);
+  if (!array) {
+    put("int %s = 0;", cname);
+  } else if (depth == 2) {
+    put("int %s[%d] = {0};", cname, parse_int(child(node, 3)));
+  } else {
+    if (out == NULL) {
+      if (nhoisted == hoisted_cap) {
+        hoisted_cap = hoisted_cap ? 2 * hoisted_cap : 8;
+        hoisted = (int *) realloc(hoisted, (unsigned) hoisted_cap * sizeof(int));
+      }
+      hoisted[nhoisted] = parse_int(child(node, 3));
+    }
+    put("int *%s = meow_a%d;", cname, ++nhoisted);
+  }
+  end_line();
+}
+
+// 语句块中的声明和语句，花括号由调用者输出
+static void emit_block_body(syntax_t *node) {
+  // compound_stmt -> { local_declarations statement_list }
+  level++;
+  depth++;
+  list_iter_t it;
+  for (syntax_t *d = list_first(&it, child(node, 1)); d != NULL; d = list_next(&it))
+    emit_local(d);
+  for (syntax_t *stmt = list_first(&it, child(node, 2)); stmt != NULL; stmt = list_next(&it))
+    emit_stmt(stmt);
+  pop_scope();
+  level--;
+}
+
+// if/while 的分支总是加上花括号，结束在 } 之后的同一行
+static void emit_branch(syntax_t *stmt) {
+  put("{");
+  end_line();
+  if (is_sym(child(stmt, 0), "compound_stmt")) {
+    emit_block_body(child(stmt, 0));
+  } else {
+    level++;
+    emit_stmt(stmt);
+    level--;
+  }
+  begin_line(0);
+  put("}");
+}
+
+static void emit_if(syntax_t *node) {
+  // selection_stmt -> if ( expression ) statement [else statement]
+  put("if (");
+  emit_expr(child(node, 2));
+  put(") ");
+  emit_branch(child(node, 4));
+  if (size(node) == 7) {
+    put(" else ");
+    if (is_sym(child(child(node, 6), 0), "selection-statement"))
+      emit_if(child(child(node, 6), 0));
+    else
+      emit_branch(child(node, 6));
+  }
+}
+
+static void emit_stmt(syntax_t *node) {
+  // statement -> xxx_stmt
+  node = child(node, 0);
+  begin_line(node->symbol.lineno);
+  if (is_sym(node, "expression_stmt")) {
+    if (size(node) == 2)
+      emit_expr(child(node, 0));
+    put(";");
+  } else if (is_sym(node, "compound_stmt")) {
+    put("{");
+    end_line();
+    emit_block_body(node);
+    begin_line(0);
+    put("}");
+  } else if (is_sym(node, "selection-statement")) {
+    emit_if(node);
+  } else if (is_sym(node, "iteration_stmt")) {
+    put("while (");
+    emit_expr(child(node, 2));
+    put(") ");
+    emit_branch(child(node, 4));
+  } else {
+    assert(is_sym(node, "return_stmt"));
+    if (size(node) == 3) {
+      put("return ");
+      emit_expr(child(node, 1));
+      put(";");
+    } else {
+      put("return;");
+    }
+  }
+  end_line();
+}
+
+static bool ends_with_return(syntax_t *body) {
+  syntax_t *last = NULL;
+  list_iter_t it;
+  for (syntax_t *stmt = list_first(&it, child(body, 2)); stmt != NULL; stmt = list_next(&it))
+    last = stmt;
+  return last != NULL && is_sym(child(last, 0), "return_stmt");
+}
+
+// params 为 NULL 时是不带参数名的原型
+static void emit_signature(ir_func_t *f, syntax_t **params) {
+  put("%s cm_%s(", f->returns_value ? "int" : "void", f->name);
+  if (f->nparams == 0) put("void");
+  for (int i = 0; i < f->nparams; i++) {
+    put(i ? ", int" : "int");
+    if (params != NULL) put(" %s", find_name(child(params[i], 1)->token.value)->cname);
+    else if (f->param_array[i]) put(" ");
+    if (f->param_array[i]) put("[]");
+  }
+  put(")");
+}
+
+static void emit_function(syntax_t *node) {
+  // fun_declaration -> type ID ( params ) compound_stmt
+  syntax_t *id = child(node, 1), *ps = child(node, 3);
+  ir_func_t *f = ir->funcs[ir_find_func(ir, id->token.value)];
+  syntax_t *body = function_body(node);
+  syntax_t **params = (syntax_t **) malloc((unsigned) (f->nparams + 1) * sizeof(syntax_t *));
+  if (f->nparams)
+    collect_list(child(ps, 0), "param_list", params);
+  name_cnt = renamed = 0;
+  depth = 1;
+  for (int i = 0; i < f->nparams; i++)
+    declare_name(child(params[i], 1), f->param_array[i], false);
+  int renamed_params = renamed;
+
+  // 第一遍不输出，只统计函数开头要声明的临时变量和数组
+  FILE *saved = out;
+  out = NULL;
+  ntemps = nhoisted = 0;
+  emit_block_body(body);
+  out = saved;
+
+  end_line();
+  begin_line(node->symbol.lineno);
+  emit_signature(f, params);
+  put(" {");
+  end_line();
+  level++;
+  if (ntemps) {
+    begin_line(0);
+    for (int i = 1; i <= ntemps; i++)
+      put(i == 1 ? "int meow_t%d" : ", meow_t%d", i);
+    put(";");
+    end_line();
+  }
+  for (int i = 1; i <= nhoisted; i++) {
+    begin_line(0);
+    put("int meow_a%d[%d] = {0};", i, hoisted[i - 1]);
+    end_line();
+  }
+  level--;
+  ntemps = nhoisted = 0;
+  renamed = renamed_params;
+  emit_block_body(body);
+  // 落到函数末尾时隐式返回 0
+  if (f->returns_value && !ends_with_return(body)) {
+    level++;
+    begin_line(0);
+    put("return 0;");
+    end_line();
+    level--;
+  }
+  begin_line(0);
+  put("}");
+  end_line();
+  pop_scope();
+  free(params);
+}
+
+// 运行时：input/output 和解释器的行为相同，除法和解释器一样报告除数为 0 的运行时错误
+static const char *runtime =
+  "#include <stdio.h>\n"
+  "#include <stdlib.h>\n"
+  "\n"
+  "static inline int cm_input(void) {\n"
+  "  int x = 0;\n"
+  "  if (scanf(\"%d\", &x) != 1) x = 0;\n"
+  "  return x;\n"
+  "}\n"
+  "\n"
+  "static inline void cm_output(int x) {\n"
+  "  printf(\"%d\\n\", x);\n"
+  "}\n"
+  "\n"
+  "static inline int meow_div(int a, int b, int lineno) {\n"
+  "  if (b == 0) {\n"
+  "    fflush(stdout);\n"
+  "    fprintf(stderr, \"Runtime error at line %d (division by zero)\\n\", lineno);\n"
+  "    exit(-1);\n"
+  "  }\n"
+  "  return b == -1 ? (int) (0u - (unsigned) a) : a / b;\n"
+  "}\n";
+
+void emit_c(ir_prog_t *prog_ir, syntax_t *prog, const char *path) {
+  ir = prog_ir;
+  source_path = path;
+  out = stdout;
+  mapped = -1;
+  level = 0;
+  fprintf(out, "/* generated by meowCC from %s, compile with -fwrapv */\n", path);
+  fputs(runtime, out);
+
+  // 先声明所有函数，使函数可以互相递归调用；-m 模块中的名字作为外部声明
+  fputs("\n", out);
+  for (int f = 0; f < ir->nfuncs; f++) {
+    if (ir->funcs[f]->builtin) continue;
+    emit_signature(ir->funcs[f], NULL);
+    put(";\n");
+  }
+  if (ir->nglobals) fputs("\n", out);
+  for (int g = 0; g < ir->nglobals; g++) {
+    ir_global_t *global = &ir->globals[g];
+    put("%sint cm_%s", global->external ? "extern " : "", global->name);
+    if (global->size) put("[%d]", global->size);
+    put(";\n");
+  }
+  // main 在其他源文件中时由那个文件提供入口
+  int m = ir_find_func(ir, "main");
+  if (m >= 0 && !ir->funcs[m]->external) {
+    ir_func_t *main_func = ir->funcs[m];
+    put("\nint main(void) {\n  %scm_main(", main_func->returns_value ? "return " : "");
+    for (int i = 0; i < main_func->nparams; i++)
+      put(i ? ", 0" : "0");
+    put(main_func->returns_value ? ");\n}\n" : ");\n  return 0;\n}\n");
+  }
+
+  list_iter_t it;
+  for (syntax_t *d = list_first(&it, child(prog, 0)); d != NULL; d = list_next(&it)) {
+    syntax_t *dec = child(d, 0);
+    if (is_sym(dec, "fun_declaration"))
+      emit_function(dec);
+  }
+}
@@ -0,0 +1,23 @@
+#include <error.h>
+
+THREAD_LOCAL jmp_buf *error_handler = NULL;
+THREAD_LOCAL void (*diag_handler)(int lineno, const char *message) = NULL;
+
+void meow_report(int lineno, const char *fmt, ...) {
+  char message[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  if (diag_handler != NULL) {
+    diag_handler(lineno, message);
+  } else {
+    fputs(message, stderr);
+  }
+}
+
+void meow_fail(void) {
+  if (error_handler != NULL)
+    longjmp(*error_handler, 1);
+  exit(-1);
+}
@@ -0,0 +1,247 @@
+#include <optim.h>
+
+bool gvn_off = false;
+
+// 数组元素和全局标量分别编号内存的版本：标量不能取地址，gstore 不改变数组，store 也不改变标量
+#define MEM_ARRAY 0
+#define MEM_SCALAR 1
+
+// 值编号的键：同一个键的两条指令计算相同的值。mem 是读取时对应内存的版本，只用于 load 和 gload
+typedef struct vn_key_t {
+  ir_op_t op;
+  ir_val_t a, b;
+  int sym, mem;
+} vn_key_t;
+
+typedef struct entry_t {
+  bool used;
+  vn_key_t key;
+  ir_val_t val;
+} entry_t;
+
+typedef struct numbering_t {
+  ir_func_t *func;
+  dom_tree_t *dt;
+  ir_val_t *value;      // 被删除的指令的结果由什么代替，没有删除时是寄存器自己
+  int size;             // 散列表的大小，2 的幂
+  entry_t *table;
+  int *undo, nundo;     // 插入的位置，离开支配树的子树时按相反的顺序清除
+  bool *mem_phi[2];     // 内存在基本块入口汇合，需要新的版本
+  int nmems;
+  int removed;
+} numbering_t;
+
+static bool same_val(ir_val_t x, ir_val_t y) {
+  return x.kind == y.kind && (x.kind == IRV_NONE || x.val == y.val);
+}
+
+static bool same_key(vn_key_t *x, vn_key_t *y) {
+  return x->op == y->op && same_val(x->a, y->a) && same_val(x->b, y->b) && x->sym == y->sym && x->mem == y->mem;
+}
+
+static unsigned hash_key(vn_key_t *k) {
+  unsigned h = (unsigned) k->op;
+  h = h * 31u + (unsigned) k->a.kind * 7u + (k->a.kind == IRV_NONE ? 0u : (unsigned) k->a.val);
+  h = h * 31u + (unsigned) k->b.kind * 7u + (k->b.kind == IRV_NONE ? 0u : (unsigned) k->b.val);
+  h = h * 31u + (unsigned) k->sym;
+  h = h * 31u + (unsigned) k->mem;
+  return h ^ (h >> 16);
+}
+
+// 线性探测；清除按插入的相反顺序进行，后插入的同一探测链上的表项已经先被清除
+static entry_t *lookup(numbering_t *n, vn_key_t *k) {
+  unsigned i = hash_key(k) & (unsigned) (n->size - 1);
+  while (n->table[i].used && !same_key(&n->table[i].key, k))
+    i = (i + 1) & (unsigned) (n->size - 1);
+  return &n->table[i];
+}
+
+static void insert(numbering_t *n, vn_key_t *k, ir_val_t val) {
+  entry_t *e = lookup(n, k);
+  if (e->used) {
+    e->val = val;
+    return;
+  }
+  *e = (entry_t) { true, *k, val };
+  n->undo[n->nundo++] = (int) (e - n->table);
+}
+
+static ir_val_t resolve(numbering_t *n, ir_val_t v) {
+  while (v.kind == IRV_REG && !same_val(n->value[v.val], v))
+    v = n->value[v.val];
+  return v;
+}
+
+static bool commutative(ir_op_t op) {
+  return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE;
+}
+
+// 立即数放在后面，两个寄存器时编号小的放在前面
+static void normalize(vn_key_t *k) {
+  if (!commutative(k->op)) return;
+  if (k->a.kind == IRV_IMM && k->b.kind == IRV_REG) goto swap;
+  if (k->a.kind == k->b.kind && k->a.val > k->b.val) goto swap;
+  return;
+swap:;
+  ir_val_t t = k->a;
+  k->a = k->b;
+  k->b = t;
+}
+
+// 基本块开头的 phi：所有实参（除了自己）都相同时是多余的，和同一个基本块中前面的 phi 相同时也是多余的
+static bool redundant_phi(numbering_t *n, ir_block_t *bb, int i) {
+  ir_inst_t *phi = &bb->insts[i];
+  ir_val_t same = ir_none();
+  bool trivial = true;
+  for (int k = 0; k < phi->nargs && trivial; k++) {
+    ir_val_t v = phi->args[k] = resolve(n, phi->args[k]);
+    if (v.kind == IRV_REG && v.val == phi->dst) continue;
+    if (same.kind == IRV_NONE) same = v;
+    else if (!same_val(same, v)) trivial = false;
+  }
+  if (trivial) {
+    n->value[phi->dst] = same.kind == IRV_NONE ? ir_imm(0) : same;
+    return true;
+  }
+  for (int j = 0; j < i; j++) {
+    ir_inst_t *prev = &bb->insts[j];
+    bool equal = true;
+    for (int k = 0; k < phi->nargs && equal; k++)
+      equal = same_val(prev->args[k], phi->args[k]);
+    if (equal) {
+      n->value[phi->dst] = ir_reg(prev->dst);
+      return true;
+    }
+  }
+  return false;
+}
+
+// 返回 true 时删除这条指令
+static bool number_inst(numbering_t *n, ir_inst_t *inst, int mem[2]) {
+  inst->a = resolve(n, inst->a);
+  inst->b = resolve(n, inst->b);
+  inst->c = resolve(n, inst->c);
+  for (int k = 0; k < inst->nargs; k++)
+    inst->args[k] = resolve(n, inst->args[k]);
+  vn_key_t k = { inst->op, inst->a, inst->b, -1, -1 };
+  switch (inst->op) {
+    case IR_MOV:
+      n->value[inst->dst] = inst->a;
+      return true;
+    case IR_GADDR:
+    case IR_LADDR:
+    case IR_GLOAD:
+      k.sym = inst->sym;
+      if (inst->op == IR_GLOAD) k.mem = mem[MEM_SCALAR];
+      break;
+    case IR_LEN:
+    case IR_CHECK:
+      break;
+    case IR_LOAD:
+      k.mem = mem[MEM_ARRAY];
+      break;
+    case IR_STORE:
+      // 存入之后，同一个位置的读取得到存入的值
+      k = (vn_key_t) { IR_LOAD, inst->a, inst->b, -1, ++n->nmems };
+      mem[MEM_ARRAY] = n->nmems;
+      insert(n, &k, inst->c);
+      return false;
+    case IR_GSTORE:
+      k = (vn_key_t) { IR_GLOAD, ir_none(), ir_none(), inst->sym, ++n->nmems };
+      mem[MEM_SCALAR] = n->nmems;
+      insert(n, &k, inst->a);
+      return false;
+    case IR_CALL:
+      // input 和 output 不读写数组和全局变量
+      if (inst->sym != IR_INPUT && inst->sym != IR_OUTPUT) {
+        mem[MEM_ARRAY] = ++n->nmems;
+        mem[MEM_SCALAR] = ++n->nmems;
+      }
+      return false;
+    default:
+      if (!ir_is_binop(inst->op)) return false;
+      if (inst->a.kind == IRV_IMM && inst->b.kind == IRV_IMM && (inst->op != IR_DIV || inst->b.val != 0)) {
+        n->value[inst->dst] = ir_imm(ir_eval(inst->op, inst->a.val, inst->b.val));
+        return true;
+      }
+      normalize(&k);
+      break;
+  }
+  entry_t *e = lookup(n, &k);
+  if (e->used) {
+    if (inst->dst >= 0) n->value[inst->dst] = e->val;
+    return true;
+  }
+  insert(n, &k, inst->dst >= 0 ? ir_reg(inst->dst) : ir_none());
+  return false;
+}
+
+// 沿支配树先序处理，表中只有支配当前基本块的指令；entry 是直接支配者末尾的内存版本
+static void number_block(numbering_t *n, int b, const int entry[2]) {
+  int mark = n->nundo, mem[2];
+  ir_block_t *bb = &n->func->blocks[b];
+  for (int m = 0; m < 2; m++)
+    mem[m] = n->mem_phi[m][b] ? ++n->nmems : entry[m];
+  for (int i = 0; i < bb->size; i++) {
+    ir_inst_t *inst = &bb->insts[i];
+    bool drop = inst->op == IR_PHI ? redundant_phi(n, bb, i) : number_inst(n, inst, mem);
+    if (!drop) continue;
+    if (inst->op != IR_PHI) n->removed++;
+    ir_remove_inst(bb, i--);
+  }
+  // 后继的 phi 中来自这条边的实参
+  int succ[2];
+  int nsucc = ir_succs(bb, succ);
+  for (int t = 0; t < nsucc; t++) {
+    int s = succ[t], k = 0;
+    while (n->dt->preds[s][k] != b)
+      k++;
+    ir_block_t *sb = &n->func->blocks[s];
+    for (int i = 0; i < sb->size && sb->insts[i].op == IR_PHI; i++)
+      sb->insts[i].args[k] = resolve(n, sb->insts[i].args[k]);
+  }
+  for (int k = 0; k < n->dt->nkids[b]; k++)
+    number_block(n, n->dt->kids[b][k], mem);
+  while (n->nundo > mark)
+    n->table[n->undo[--n->nundo]].used = false;
+}
+
+int number_values(ir_func_t *func) {
+  int size = ir_func_size(func);
+  numbering_t n = { .func = func, .dt = dom_tree_build(func), .size = 16 };
+  while (n.size < 2 * size)
+    n.size *= 2;
+  n.table = (entry_t *) calloc((unsigned) n.size, sizeof(entry_t));
+  n.undo = (int *) malloc((unsigned) size * sizeof(int) + 1);
+  n.value = (ir_val_t *) malloc((unsigned) func->nregs * sizeof(ir_val_t) + 1);
+  for (int r = 0; r < func->nregs; r++)
+    n.value[r] = ir_reg(r);
+
+  // 写内存的基本块的迭代支配边界上，内存有多个版本汇合
+  bool *clobbers[2];
+  for (int m = 0; m < 2; m++) {
+    clobbers[m] = (bool *) calloc((unsigned) func->nblocks, sizeof(bool));
+    n.mem_phi[m] = (bool *) malloc((unsigned) func->nblocks * sizeof(bool));
+  }
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      ir_inst_t *inst = &func->blocks[b].insts[i];
+      bool call = inst->op == IR_CALL && inst->sym != IR_INPUT && inst->sym != IR_OUTPUT;
+      if (inst->op == IR_STORE || call) clobbers[MEM_ARRAY][b] = true;
+      if (inst->op == IR_GSTORE || call) clobbers[MEM_SCALAR][b] = true;
+    }
+  for (int m = 0; m < 2; m++)
+    iterated_frontier(func, n.dt, clobbers[m], n.mem_phi[m]);
+  int entry[2] = {0, 0};
+  number_block(&n, 0, entry);
+
+  for (int m = 0; m < 2; m++) {
+    free(clobbers[m]);
+    free(n.mem_phi[m]);
+  }
+  free(n.table);
+  free(n.undo);
+  free(n.value);
+  dom_tree_free(n.dt);
+  return n.removed;
+}
@@ -0,0 +1,146 @@
+#include <optim.h>
+#include <callgraph.h>
+
+// 内联的代价模型，单位是三地址码指令
+#define INLINE_SIZE 30          // 不超过这个大小的函数在每个调用点内联
+#define INLINE_ONCE_SIZE 300    // 只有一个调用点的函数，内联之后原来的函数被删除
+#define INLINE_GROWTH 5000      // 调用者内联之后不超过这个大小
+
+bool inline_dump = false, inline_off = false;
+
+// 待检查的基本块，拆分出的后半部分还要继续检查，复制进来的函数体不再检查
+typedef struct worklist_t {
+  int size, cap;
+  int *blocks;
+} worklist_t;
+
+static void push(worklist_t *w, int b) {
+  if (w->size == w->cap) {
+    w->cap = w->cap ? 2 * w->cap : 16;
+    w->blocks = (int *) realloc(w->blocks, (unsigned) w->cap * sizeof(int));
+  }
+  w->blocks[w->size++] = b;
+}
+
+static void remap(ir_val_t *v, int *reg) {
+  if (v->kind == IRV_REG) v->val = reg[v->val];
+}
+
+// 把 func 的基本块 b 中第 i 条指令（对 callee 的调用）替换为 callee 的函数体：
+// 调用之后的指令移到新的基本块，实参搬到新分配的寄存器中，return 改为搬运返回值并跳到新的基本块
+static void inline_call(ir_func_t *func, int b, int i, ir_func_t *callee, worklist_t *w) {
+  ir_inst_t call = func->blocks[b].insts[i];
+  int cont = ir_new_block(func);
+  for (int k = i + 1; k < func->blocks[b].size; k++)
+    *ir_emit(func, cont, IR_NOP, 0) = func->blocks[b].insts[k];
+  func->blocks[b].size = i;
+  push(w, cont);
+
+  int *reg = (int *) malloc((unsigned) (callee->nregs + 1) * sizeof(int));
+  for (int r = 0; r < callee->nregs; r++)
+    reg[r] = ir_new_reg(func);
+  int base = func->nblocks;
+  for (int k = 0; k < callee->nblocks; k++)
+    ir_new_block(func);
+
+  for (int p = 0; p < callee->nparams; p++) {
+    ir_inst_t *mov = ir_emit(func, b, IR_MOV, call.lineno);
+    mov->dst = reg[p];
+    mov->a = call.args[p];
+  }
+  ir_emit(func, b, IR_JMP, call.lineno)->target[0] = base;
+  free(call.args);
+
+  for (int k = 0; k < callee->nblocks; k++) {
+    ir_block_t *src = &callee->blocks[k];
+    for (int j = 0; j < src->size; j++) {
+      ir_inst_t inst = src->insts[j];
+      if (inst.op == IR_RET) {
+        if (call.dst >= 0) {
+          ir_inst_t *mov = ir_emit(func, base + k, IR_MOV, inst.lineno);
+          mov->dst = call.dst;
+          mov->a = inst.a.kind == IRV_NONE ? ir_imm(0) : inst.a;
+          remap(&mov->a, reg);
+        }
+        ir_emit(func, base + k, IR_JMP, inst.lineno)->target[0] = cont;
+        continue;
+      }
+      if (inst.dst >= 0) inst.dst = reg[inst.dst];
+      remap(&inst.a, reg);
+      remap(&inst.b, reg);
+      remap(&inst.c, reg);
+      // 没有实参的调用的 args 也不能和被调函数共用
+      inst.args = NULL;
+      if (inst.nargs) {
+        inst.args = (ir_val_t *) malloc((unsigned) inst.nargs * sizeof(ir_val_t));
+        for (int a = 0; a < inst.nargs; a++) {
+          inst.args[a] = src->insts[j].args[a];
+          remap(&inst.args[a], reg);
+        }
+      }
+      for (int t = 0; t < 2; t++)
+        if (inst.target[t] >= 0) inst.target[t] += base;
+      *ir_emit(func, base + k, inst.op, inst.lineno) = inst;
+    }
+  }
+  free(reg);
+}
+
+// 决定是否内联 caller 对 callee 的一次调用，不内联时 why 是原因
+static bool should_inline(ir_prog_t *prog, callgraph_t *cg, int caller, int callee, const char **why) {
+  ir_func_t *f = prog->funcs[caller], *g = prog->funcs[callee];
+  int size = ir_func_size(g);
+  if (g->external) {
+    *why = "external";
+  } else if (cg->recursive[callee]) {
+    *why = "recursive";
+  } else if (g->narrays) {
+    // 局部数组在每次调用时清零，内联之后要在调用者中额外清零，得不偿失
+    *why = "local arrays";
+  } else if (size > INLINE_SIZE && (cg->ncalls[callee] > 1 || size > INLINE_ONCE_SIZE)) {
+    *why = "too large";
+  } else if (ir_func_size(f) + size > INLINE_GROWTH) {
+    *why = "caller too large";
+  } else {
+    return true;
+  }
+  return false;
+}
+
+int inline_calls(ir_prog_t *prog) {
+  callgraph_t *cg = callgraph_build(prog);
+  int inlined = 0;
+  worklist_t w = {0, 0, NULL};
+  // 按逆拓扑序处理，被调用的函数先完成内联，每个调用点只需决定一次
+  for (int k = 0; k < cg->nfuncs; k++) {
+    int caller = cg->order[k];
+    ir_func_t *func = prog->funcs[caller];
+    if (func->builtin || func->external || !cg->reachable[caller]) continue;
+    w.size = 0;
+    for (int b = func->nblocks - 1; b >= 0; b--)
+      push(&w, b);
+    while (w.size) {
+      int b = w.blocks[--w.size];
+      for (int i = 0; i < func->blocks[b].size; i++) {
+        ir_inst_t *inst = &func->blocks[b].insts[i];
+        if (inst->op != IR_CALL || prog->funcs[inst->sym]->builtin) continue;
+        int callee = inst->sym;
+        const char *why = NULL;
+        bool yes = should_inline(prog, cg, caller, callee, &why);
+        if (inline_dump) {
+          fprintf(stderr, "inline: %s -> %s at line %d (%d instructions): %s%s\n", func->name, prog->funcs[callee]->name,
+                  inst->lineno, ir_func_size(prog->funcs[callee]), yes ? "inlined" : "not inlined, ", yes ? "" : why);
+        }
+        if (yes) {
+          // 后半部分放进新的基本块，稍后检查
+          inline_call(func, b, i, prog->funcs[callee], &w);
+          inlined++;
+          break;
+        }
+      }
+    }
+  }
+  free(w.blocks);
+  callgraph_free(cg);
+  return inlined;
+}
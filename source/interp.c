@@ -0,0 +1,537 @@
+#include <interp.h>
+#include <profile.h>
+#include <stdint.h>
+#include <limits.h>
+
+long long interp_steps = 0;
+long long interp_dispatches = 0, interp_iterations = 0;
+long long interp_calls = 0, interp_tail_calls = 0;
+int interp_max_depth = 0;
+int interp_fused = 0, interp_quickened = 0;
+bool interp_plain = false;
+
+// 字节码指令。三地址码中的立即数放在函数的常量寄存器中（紧跟在虚拟寄存器之后，每次调用时复制到栈帧），
+// 所以所有操作数都是寄存器编号，执行时不再区分操作数的种类
+typedef enum bc_op_t {
+  // 通用指令：第一次执行时解析全局变量的地址、被调函数或者除数，并把自己原地改写为专用指令
+  B_GLOAD, B_GSTORE, B_GADDR, B_CALL, B_TAIL, B_DIV,
+  // 专用指令
+  B_GLOADP,   // dst = *k
+  B_GSTOREP,  // *k = a
+  B_ADDR,     // dst = k
+  B_INPUT,    // dst = input()
+  B_OUTPUT,   // output(args[0])
+  B_CALLF,    // dst = 函数 k (args...)，k 是翻译好的 bc_func_t
+  B_TAILF,    // return 函数 k (args...)，被调函数的栈帧代替当前的栈帧
+  B_DIVC,     // dst = a / b，检查除数为 0
+  B_DIVK,     // dst = a / b，b 是不为 0 和 -1 的常量
+  B_MOV, B_ADD, B_SUB, B_MUL, B_LT, B_LE, B_GT, B_GE, B_EQ, B_NE,
+  B_LADDR, B_LOAD, B_STORE, B_LEN, B_CHECK, B_JMP, B_BR, B_RET,
+  // 超级指令，由三地址码中最常见的指令序列组合而成
+  B_BR_LT, B_BR_LE, B_BR_GT, B_BR_GE, B_BR_EQ, B_BR_NE,   // dst = a relop b; br dst
+  B_INC,      // [dst2 = r;] dst = r + k; r = dst，r 保存在 a 中
+  B_UPDATE,   // dst2 = a[b]; dst = dst2 + k; c[d] = dst
+} bc_op_t;
+
+typedef struct code_t {
+  bc_op_t op;
+  int weight;           // 代表的三地址码指令数，包括并入的跳转
+  int dst, dst2;
+  int a, b, c, d;
+  int target[2];        // 跳转目标在 code 中的下标
+  intptr_t k;           // 常量、全局变量的地址或者被调函数
+  int *args;            // 实参所在的寄存器
+  ir_inst_t *inst;      // 原来的指令，通用指令改写时使用
+} code_t;
+
+typedef struct bc_func_t {
+  ir_func_t *func;
+  int index;            // 在 program_ir->funcs 中的下标
+  int size;
+  code_t *code;
+  int nconsts;
+  intptr_t *consts;     // 常量寄存器 func->nregs .. 的初值
+  int array_words;      // 局部数组紧挨在寄存器前面，每个数组前面是保存长度的一个 int
+  int *array_offset;    // 局部数组长度所在的位置相对寄存器的偏移（以 intptr_t 计）
+} bc_func_t;
+
+// 调用者在调用时的状态，返回时恢复；sp 是压入被调函数的栈帧之前数据栈的位置
+typedef struct frame_t {
+  bc_func_t *bf;
+  code_t *pc;
+  intptr_t *regs;
+  int chunk;
+  intptr_t *sp;
+} frame_t;
+
+static ir_prog_t *program_ir;
+static int **global_mem;
+static bc_func_t **compiled;    // 第一次调用时才翻译，下标与 program_ir->funcs 相同
+
+// 栈帧放在分块的数据栈上，不在 C 的栈上递归：块的地址不变，局部数组的地址在调用期间有效
+#define CHUNK_WORDS (1 << 20)
+static intptr_t **chunks, *sp, *chunk_end;
+static int *chunk_words, nchunks, chunk;
+static frame_t *frames;
+static int nframes, cap_frames;
+static intptr_t *arg_buf;       // 尾调用时暂存实参
+
+void run_error(int lineno, const char *cause) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error at line %d (%s)\n", lineno, cause);
+  exit(-1);
+}
+
+// 全局数组前面多分配一个 int 保存长度（IR_LEN），返回首元素的地址
+static int *new_array(int size) {
+  int *mem = (int *) calloc((unsigned) size + 1, sizeof(int));
+  mem[0] = size;
+  return mem + 1;
+}
+
+static int reg_of(bc_func_t *bf, ir_val_t v) {
+  if (v.kind == IRV_REG) return v.val;
+  if (v.kind == IRV_NONE) return -1;
+  for (int i = 0; i < bf->nconsts; i++)
+    if (bf->consts[i] == v.val)
+      return bf->func->nregs + i;
+  bf->consts = (intptr_t *) realloc(bf->consts, (unsigned) (bf->nconsts + 1) * sizeof(intptr_t));
+  bf->consts[bf->nconsts] = v.val;
+  return bf->func->nregs + bf->nconsts++;
+}
+
+static bool is_reg(ir_val_t v, int reg) {
+  return v.kind == IRV_REG && v.val == reg;
+}
+
+static bool is_relop(ir_op_t op) {
+  return op >= IR_LT && op <= IR_NE;
+}
+
+// d = r + k 或 d = r - k（加法时也可以是 d = k + r），返回 r，不是这种形式时返回 -1
+static int add_const(ir_inst_t *inst, intptr_t *k) {
+  if (inst->op != IR_ADD && inst->op != IR_SUB) return -1;
+  if (inst->a.kind == IRV_REG && inst->b.kind == IRV_IMM) {
+    *k = inst->op == IR_ADD ? inst->b.val : (int) (0u - (unsigned) inst->b.val);
+    return inst->a.val;
+  }
+  if (inst->op == IR_ADD && inst->a.kind == IRV_IMM && inst->b.kind == IRV_REG) {
+    *k = inst->a.val;
+    return inst->b.val;
+  }
+  return -1;
+}
+
+// 从 insts[i] 开始组合超级指令，返回组合的指令数，不能组合时返回 0
+static int fuse(bc_func_t *bf, ir_inst_t *insts, int n, int i, code_t *c) {
+  ir_inst_t *x = &insts[i], *y = i + 1 < n ? &insts[i + 1] : NULL, *z = i + 2 < n ? &insts[i + 2] : NULL;
+  intptr_t k;
+  int r;
+  // 比较 + 条件跳转
+  if (y != NULL && is_relop(x->op) && y->op == IR_BR && is_reg(y->a, x->dst)) {
+    c->op = B_BR_LT + (x->op - IR_LT);
+    c->dst = x->dst;
+    c->a = reg_of(bf, x->a);
+    c->b = reg_of(bf, x->b);
+    c->target[0] = y->target[0];
+    c->target[1] = y->target[1];
+    return 2;
+  }
+  // 局部变量加常量：-O0 时先复写到临时寄存器
+  if (z != NULL && x->op == IR_MOV && x->a.kind == IRV_REG && (r = add_const(y, &k)) == x->dst
+      && z->op == IR_MOV && z->dst == x->a.val && is_reg(z->a, y->dst)) {
+    c->op = B_INC;
+    c->a = x->a.val;
+    c->dst2 = x->dst;
+    c->dst = y->dst;
+    c->k = k;
+    return 3;
+  }
+  if (y != NULL && (r = add_const(x, &k)) >= 0 && y->op == IR_MOV && y->dst == r && is_reg(y->a, x->dst)) {
+    c->op = B_INC;
+    c->a = r;
+    c->dst2 = c->dst = x->dst;
+    c->k = k;
+    return 2;
+  }
+  // 数组元素加常量
+  if (z != NULL && x->op == IR_LOAD && add_const(y, &k) == x->dst && z->op == IR_STORE && is_reg(z->c, y->dst)) {
+    c->op = B_UPDATE;
+    c->a = reg_of(bf, x->a);
+    c->b = reg_of(bf, x->b);
+    c->dst2 = x->dst;
+    c->dst = y->dst;
+    c->k = k;
+    c->c = reg_of(bf, z->a);
+    c->d = reg_of(bf, z->b);
+    return 3;
+  }
+  return 0;
+}
+
+static void translate(bc_func_t *bf, ir_inst_t *inst, code_t *c) {
+  static const bc_op_t ops[IR_OP_CNT] = {
+    [IR_MOV] = B_MOV, [IR_ADD] = B_ADD, [IR_SUB] = B_SUB, [IR_MUL] = B_MUL, [IR_DIV] = B_DIV,
+    [IR_LT] = B_LT, [IR_LE] = B_LE, [IR_GT] = B_GT, [IR_GE] = B_GE, [IR_EQ] = B_EQ, [IR_NE] = B_NE,
+    [IR_GLOAD] = B_GLOAD, [IR_GSTORE] = B_GSTORE, [IR_GADDR] = B_GADDR, [IR_LADDR] = B_LADDR,
+    [IR_LOAD] = B_LOAD, [IR_STORE] = B_STORE, [IR_LEN] = B_LEN, [IR_CHECK] = B_CHECK, [IR_CALL] = B_CALL, [IR_JMP] = B_JMP, [IR_BR] = B_BR,
+    [IR_RET] = B_RET,
+  };
+  c->op = ops[inst->op];
+  c->dst = inst->dst;
+  c->a = reg_of(bf, inst->a);
+  c->b = reg_of(bf, inst->b);
+  c->c = reg_of(bf, inst->c);
+  c->target[0] = inst->target[0];
+  c->target[1] = inst->target[1];
+  c->k = inst->op == IR_LADDR ? bf->array_offset[inst->sym] : inst->sym;
+  if (inst->op == IR_CALL) {
+    c->args = (int *) malloc((unsigned) inst->nargs * sizeof(int) + 1);
+    for (int i = 0; i < inst->nargs; i++)
+      c->args[i] = reg_of(bf, inst->args[i]);
+  }
+}
+
+// 按基本块的顺序排列指令；跳到下一个基本块的 jmp 并入前一条指令，不再分派
+static bc_func_t *compile(int f) {
+  if (compiled[f] != NULL) return compiled[f];
+  ir_func_t *func = program_ir->funcs[f];
+  bc_func_t *bf = (bc_func_t *) calloc(1, sizeof(bc_func_t));
+  bf->func = func;
+  bf->index = f;
+  bf->array_offset = (int *) malloc((unsigned) func->narrays * sizeof(int) + 1);
+  for (int i = func->narrays - 1; i >= 0; i--) {
+    bf->array_words += (int) ((sizeof(int) * (unsigned) (func->array_size[i] + 1) + sizeof(intptr_t) - 1) / sizeof(intptr_t));
+    bf->array_offset[i] = -bf->array_words;
+  }
+  int cap = 0;
+  for (int b = 0; b < func->nblocks; b++)
+    cap += func->blocks[b].size;
+  bf->code = (code_t *) calloc((unsigned) cap + 1, sizeof(code_t));
+  int *start = (int *) malloc((unsigned) func->nblocks * sizeof(int) + 1);
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    start[b] = bf->size;
+    for (int i = 0; i < bb->size;) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (!interp_plain && inst->op == IR_JMP && inst->target[0] == b + 1 && i > 0) {
+        bf->code[bf->size - 1].weight++;
+        i++;
+        continue;
+      }
+      code_t *c = &bf->code[bf->size++];
+      c->inst = inst;
+      int n = interp_plain ? 0 : fuse(bf, bb->insts, bb->size, i, c);
+      if (n > 0) {
+        interp_fused++;
+      } else {
+        translate(bf, inst, c);
+        n = 1;
+        // 尾调用和之后的 ret 一起执行，-plain-interp 时也一样，保证不增加调用深度
+        if (ir_is_tail_call(program_ir, func, bb, i)) {
+          c->op = B_TAIL;
+          n = 2;
+        }
+      }
+      c->weight = n;
+      i += n;
+    }
+  }
+  for (int i = 0; i < bf->size; i++) {
+    code_t *c = &bf->code[i];
+    if (c->op == B_JMP || c->op == B_BR || (c->op >= B_BR_LT && c->op <= B_BR_NE)) {
+      c->target[0] = start[c->target[0]];
+      if (c->op != B_JMP) c->target[1] = start[c->target[1]];
+    }
+  }
+  free(start);
+  compiled[f] = bf;
+  return bf;
+}
+
+// 通用指令改写为专用指令，-plain-interp 时保持原样，每次执行都重新解析
+#define QUICKEN(OP) do { if (!interp_plain) { pc->op = (OP); interp_quickened++; } } while (0)
+// 跳转，目标不在后面时是循环的一次迭代，剖析时记到跳转所在的行（while 语句的行）
+#define JUMP(T) do { \
+    int t_ = (T); \
+    if (t_ <= pc - code) { \
+      interp_iterations++; \
+      if (profile_loops) profile_loops[pc->inst->lineno]++; \
+    } \
+    pc = code + t_; \
+  } while (0)
+#define BINOP(EXPR) regs[pc->dst] = (EXPR); pc++; break
+#define RA ((int) regs[pc->a])
+#define RB ((int) regs[pc->b])
+#define WRAP(EXPR) ((int) (EXPR))
+
+// 从数据栈上分配 words 个字，当前块放不下时换到下一块
+static intptr_t *push_words(int words) {
+  if (chunk_end - sp < words) {
+    if (++chunk == nchunks) {
+      chunks = (intptr_t **) realloc(chunks, (unsigned) (nchunks + 1) * sizeof(intptr_t *));
+      chunk_words = (int *) realloc(chunk_words, (unsigned) (nchunks + 1) * sizeof(int));
+      chunks[nchunks] = NULL;
+      chunk_words[nchunks++] = 0;
+    }
+    if (chunk_words[chunk] < words) {
+      free(chunks[chunk]);
+      chunk_words[chunk] = words > CHUNK_WORDS ? words : CHUNK_WORDS;
+      chunks[chunk] = (intptr_t *) malloc((unsigned) chunk_words[chunk] * sizeof(intptr_t));
+    }
+    sp = chunks[chunk];
+    chunk_end = sp + chunk_words[chunk];
+  }
+  intptr_t *p = sp;
+  sp += words;
+  return p;
+}
+
+static void pop_to(int c, intptr_t *p) {
+  chunk = c;
+  sp = p;
+  chunk_end = chunks[c] + chunk_words[c];
+}
+
+// 在数据栈上建立 bf 的栈帧：寄存器和局部数组清零，复制常量，写入数组的长度，返回寄存器的起始位置
+static intptr_t *enter(bc_func_t *bf) {
+  ir_func_t *func = bf->func;
+  intptr_t *regs = push_words(bf->array_words + func->nregs + bf->nconsts) + bf->array_words;
+  memset(regs - bf->array_words, 0, (unsigned) (bf->array_words + func->nregs) * sizeof(intptr_t));
+  if (bf->nconsts)
+    memcpy(regs + func->nregs, bf->consts, (unsigned) bf->nconsts * sizeof(intptr_t));
+  for (int i = 0; i < func->narrays; i++)
+    *(int *) (regs + bf->array_offset[i]) = func->array_size[i];
+  if (profile_lines) profile_enter(bf->index);
+  return regs;
+}
+
+// 调用时在 frames 中记下调用者的状态，frames 的长度就是调用深度；main 的记录中 bf 为空
+static void push_frame(bc_func_t *caller, code_t *pc, intptr_t *regs, bc_func_t *callee) {
+  if (nframes >= max_depth)
+    run_error(callee->func->lineno, "recursion too deep");
+  if (nframes == cap_frames) {
+    cap_frames = cap_frames ? 2 * cap_frames : 256;
+    frames = (frame_t *) realloc(frames, (unsigned) cap_frames * sizeof(frame_t));
+  }
+  frames[nframes++] = (frame_t) { .bf = caller, .pc = pc, .regs = regs, .chunk = chunk, .sp = sp };
+  interp_calls++;
+  if (nframes > interp_max_depth) interp_max_depth = nframes;
+}
+
+// main 的参数都是 0
+static intptr_t exec(bc_func_t *bf) {
+  push_frame(NULL, NULL, NULL, bf);
+  intptr_t *regs = enter(bf);
+  code_t *code = bf->code, *pc = code;
+  for (;;) {
+    interp_dispatches++;
+    interp_steps += pc->weight;
+    if (profile_lines) profile_lines[pc->inst->lineno] += pc->weight;
+    switch (pc->op) {
+      case B_GLOAD:
+        pc->k = (intptr_t) global_mem[pc->inst->sym];
+        QUICKEN(B_GLOADP);
+        /* fallthrough */
+      case B_GLOADP:
+        BINOP(*(int *) pc->k);
+      case B_GSTORE:
+        pc->k = (intptr_t) global_mem[pc->inst->sym];
+        QUICKEN(B_GSTOREP);
+        /* fallthrough */
+      case B_GSTOREP:
+        *(int *) pc->k = RA;
+        pc++;
+        break;
+      case B_GADDR:
+        pc->k = (intptr_t) global_mem[pc->inst->sym];
+        QUICKEN(B_ADDR);
+        /* fallthrough */
+      case B_ADDR:
+        BINOP(pc->k);
+      case B_TAIL:
+        pc->k = (intptr_t) compile(pc->inst->sym);
+        QUICKEN(B_TAILF);
+        goto tail;
+      case B_CALL: {
+        ir_func_t *callee = program_ir->funcs[pc->inst->sym];
+        if (!callee->builtin) {
+          pc->k = (intptr_t) compile(pc->inst->sym);
+          QUICKEN(B_CALLF);
+          goto call;
+        }
+        if (strcmp(callee->name, "input") == 0) {
+          QUICKEN(B_INPUT);
+          goto input;
+        }
+        QUICKEN(B_OUTPUT);
+        goto output;
+      }
+      case B_INPUT:
+      input: {
+        int x = 0;
+        if (scanf("%d", &x) != 1) x = 0;
+        BINOP(x);
+      }
+      case B_OUTPUT:
+      output:
+        printf("%d\n", (int) regs[pc->args[0]]);
+        pc++;
+        break;
+      case B_CALLF:
+      call: {
+        bc_func_t *callee = (bc_func_t *) pc->k;
+        push_frame(bf, pc, regs, callee);
+        intptr_t *caller = regs;
+        regs = enter(callee);
+        for (int i = 0; i < callee->func->nparams; i++)
+          regs[i] = caller[pc->args[i]];
+        bf = callee;
+        pc = code = bf->code;
+        break;
+      }
+      case B_TAILF:
+      tail: {
+        // 实参先复制出来，当前的栈帧出栈，被调函数的栈帧放在同一个位置，返回到当前的调用者
+        bc_func_t *callee = (bc_func_t *) pc->k;
+        for (int i = 0; i < callee->func->nparams; i++)
+          arg_buf[i] = regs[pc->args[i]];
+        if (profile_lines) profile_leave();
+        pop_to(frames[nframes - 1].chunk, frames[nframes - 1].sp);
+        regs = enter(callee);
+        memcpy(regs, arg_buf, (unsigned) callee->func->nparams * sizeof(intptr_t));
+        interp_tail_calls++;
+        bf = callee;
+        pc = code = bf->code;
+        break;
+      }
+      case B_DIV:
+        if (pc->inst->b.kind == IRV_IMM && pc->inst->b.val != 0 && pc->inst->b.val != -1)
+          QUICKEN(B_DIVK);
+        else
+          QUICKEN(B_DIVC);
+        /* fallthrough */
+      case B_DIVC:
+        if (RB == 0)
+          run_error(pc->inst->lineno, "division by zero");
+        BINOP(ir_eval(IR_DIV, RA, RB));
+      case B_DIVK:
+        BINOP(RA / RB);
+      case B_MOV:
+        BINOP(regs[pc->a]);
+      case B_ADD:
+        BINOP(WRAP((unsigned) RA + (unsigned) RB));
+      case B_SUB:
+        BINOP(WRAP((unsigned) RA - (unsigned) RB));
+      case B_MUL:
+        BINOP(WRAP((unsigned) RA * (unsigned) RB));
+      case B_LT:
+        BINOP(RA < RB);
+      case B_LE:
+        BINOP(RA <= RB);
+      case B_GT:
+        BINOP(RA > RB);
+      case B_GE:
+        BINOP(RA >= RB);
+      case B_EQ:
+        BINOP(RA == RB);
+      case B_NE:
+        BINOP(RA != RB);
+      case B_LADDR:
+        BINOP((intptr_t) ((int *) (regs + pc->k) + 1));
+      case B_LOAD:
+        BINOP(((int *) regs[pc->a])[regs[pc->b]]);
+      case B_STORE:
+        ((int *) regs[pc->a])[regs[pc->b]] = (int) regs[pc->c];
+        pc++;
+        break;
+      case B_LEN:
+        BINOP(((int *) regs[pc->a])[-1]);
+      case B_CHECK:
+        // 负数转为无符号数之后大于任何长度
+        if ((unsigned) RA >= (unsigned) RB)
+          run_error(pc->inst->lineno, "array index out of bounds");
+        pc++;
+        break;
+      case B_JMP:
+        JUMP(pc->target[0]);
+        break;
+      case B_BR:
+        JUMP(regs[pc->a] ? pc->target[0] : pc->target[1]);
+        break;
+      case B_RET: {
+        intptr_t result = pc->a < 0 ? 0 : regs[pc->a];
+        frame_t *f = &frames[--nframes];
+        if (profile_lines) profile_leave();
+        pop_to(f->chunk, f->sp);
+        if (f->bf == NULL) return result;
+        bf = f->bf;
+        code = bf->code;
+        pc = f->pc;
+        regs = f->regs;
+        if (pc->dst >= 0) regs[pc->dst] = result;
+        pc++;
+        break;
+      }
+      case B_BR_LT: case B_BR_LE: case B_BR_GT: case B_BR_GE: case B_BR_EQ: case B_BR_NE: {
+        int a = RA, b = RB, cond;
+        switch (pc->op) {
+          case B_BR_LT: cond = a < b; break;
+          case B_BR_LE: cond = a <= b; break;
+          case B_BR_GT: cond = a > b; break;
+          case B_BR_GE: cond = a >= b; break;
+          case B_BR_EQ: cond = a == b; break;
+          default: cond = a != b; break;
+        }
+        regs[pc->dst] = cond;
+        JUMP(cond ? pc->target[0] : pc->target[1]);
+        break;
+      }
+      case B_INC: {
+        intptr_t old = regs[pc->a];
+        regs[pc->dst2] = old;
+        regs[pc->dst] = regs[pc->a] = WRAP((unsigned) old + (unsigned) pc->k);
+        pc++;
+        break;
+      }
+      case B_UPDATE: {
+        int old = ((int *) regs[pc->a])[regs[pc->b]];
+        regs[pc->dst2] = old;
+        int now = WRAP((unsigned) old + (unsigned) pc->k);
+        regs[pc->dst] = now;
+        ((int *) regs[pc->c])[regs[pc->d]] = now;
+        pc++;
+        break;
+      }
+      default:
+        run_error(pc->inst->lineno, "bad instruction");
+    }
+  }
+}
+
+int interp_run(ir_prog_t *prog) {
+  program_ir = prog;
+  int m = ir_find_func(prog, "main");
+  if (m < 0) {
+    fprintf(stderr, "missing main function\n");
+    exit(-1);
+  }
+  global_mem = (int **) malloc((unsigned) prog->nglobals * sizeof(int *) + 1);
+  for (int i = 0; i < prog->nglobals; i++)
+    global_mem[i] = prog->globals[i].size ? new_array(prog->globals[i].size) : (int *) calloc(1, sizeof(int));
+  compiled = (bc_func_t **) calloc((unsigned) prog->nfuncs + 1, sizeof(bc_func_t *));
+  if (profile_report_path || profile_stacks_path) profile_start(prog);
+  int max_params = 0;
+  for (int f = 0; f < prog->nfuncs; f++)
+    if (prog->funcs[f]->nparams > max_params) max_params = prog->funcs[f]->nparams;
+  arg_buf = (intptr_t *) malloc((unsigned) max_params * sizeof(intptr_t) + 1);
+  chunks = (intptr_t **) malloc(sizeof(intptr_t *));
+  chunk_words = (int *) malloc(sizeof(int));
+  chunks[0] = (intptr_t *) malloc(CHUNK_WORDS * sizeof(intptr_t));
+  chunk_words[0] = CHUNK_WORDS;
+  nchunks = 1;
+  pop_to(0, chunks[0]);
+  int ret = (int) exec(compile(m));
+  fflush(stdout);
+  return ret;
+}
@@ -0,0 +1,426 @@
+#include <ir.h>
+#include <limits.h>
+
+static const char *op_name[IR_OP_CNT] = {
+  [IR_NOP] = "nop",
+  [IR_MOV] = "mov",
+  [IR_ADD] = "+",
+  [IR_SUB] = "-",
+  [IR_MUL] = "*",
+  [IR_DIV] = "/",
+  [IR_LT] = "<",
+  [IR_LE] = "<=",
+  [IR_GT] = ">",
+  [IR_GE] = ">=",
+  [IR_EQ] = "==",
+  [IR_NE] = "!=",
+  [IR_GLOAD] = "gload",
+  [IR_GSTORE] = "gstore",
+  [IR_GADDR] = "gaddr",
+  [IR_LADDR] = "laddr",
+  [IR_LOAD] = "load",
+  [IR_STORE] = "store",
+  [IR_LEN] = "len",
+  [IR_CHECK] = "check",
+  [IR_CALL] = "call",
+  [IR_JMP] = "jmp",
+  [IR_BR] = "br",
+  [IR_RET] = "ret",
+  [IR_PHI] = "phi",
+};
+
+int max_depth = 1000000;
+
+ir_val_t ir_reg(int reg) {
+  return (ir_val_t) { .kind = IRV_REG, .val = reg };
+}
+
+ir_val_t ir_imm(int imm) {
+  return (ir_val_t) { .kind = IRV_IMM, .val = imm };
+}
+
+ir_val_t ir_none(void) {
+  return (ir_val_t) { .kind = IRV_NONE, .val = 0 };
+}
+
+ir_prog_t *ir_new_prog(void) {
+  ir_prog_t *prog = (ir_prog_t *) calloc(1, sizeof(ir_prog_t));
+  // 内建函数：int input(void) 和 void output(int x)
+  ir_func_t *input = ir_new_func(prog, "input", 0);
+  input->builtin = true;
+  input->returns_value = true;
+  ir_func_t *output = ir_new_func(prog, "output", 0);
+  output->builtin = true;
+  output->nparams = output->nregs = 1;
+  output->param_array = (bool *) calloc(1, sizeof(bool));
+  return prog;
+}
+
+ir_func_t *ir_new_func(ir_prog_t *prog, const char *name, int lineno) {
+  if (prog->nfuncs == prog->cap_funcs) {
+    prog->cap_funcs = prog->cap_funcs ? 2 * prog->cap_funcs : 8;
+    prog->funcs = (ir_func_t **) realloc(prog->funcs, (unsigned) prog->cap_funcs * sizeof(ir_func_t *));
+  }
+  ir_func_t *func = (ir_func_t *) calloc(1, sizeof(ir_func_t));
+  strcpy(func->name, name);
+  func->lineno = lineno;
+  prog->funcs[prog->nfuncs++] = func;
+  return func;
+}
+
+int ir_new_global(ir_prog_t *prog, const char *name, int size) {
+  if (prog->nglobals == prog->cap_globals) {
+    prog->cap_globals = prog->cap_globals ? 2 * prog->cap_globals : 8;
+    prog->globals = (ir_global_t *) realloc(prog->globals, (unsigned) prog->cap_globals * sizeof(ir_global_t));
+  }
+  strcpy(prog->globals[prog->nglobals].name, name);
+  prog->globals[prog->nglobals].size = size;
+  prog->globals[prog->nglobals].lineno = 0;
+  prog->globals[prog->nglobals].external = false;
+  return prog->nglobals++;
+}
+
+int ir_new_block(ir_func_t *func) {
+  if (func->nblocks == func->cap_blocks) {
+    func->cap_blocks = func->cap_blocks ? 2 * func->cap_blocks : 8;
+    func->blocks = (ir_block_t *) realloc(func->blocks, (unsigned) func->cap_blocks * sizeof(ir_block_t));
+  }
+  func->blocks[func->nblocks] = (ir_block_t) { .size = 0, .cap = 0, .insts = NULL };
+  return func->nblocks++;
+}
+
+int ir_new_reg(ir_func_t *func) {
+  return func->nregs++;
+}
+
+ir_inst_t *ir_emit(ir_func_t *func, int block, ir_op_t op, int lineno) {
+  ir_block_t *bb = &func->blocks[block];
+  if (bb->size == bb->cap) {
+    bb->cap = bb->cap ? 2 * bb->cap : 8;
+    bb->insts = (ir_inst_t *) realloc(bb->insts, (unsigned) bb->cap * sizeof(ir_inst_t));
+  }
+  ir_inst_t *inst = &bb->insts[bb->size++];
+  *inst = (ir_inst_t) {
+    .op = op,
+    .dst = -1,
+    .a = ir_none(), .b = ir_none(), .c = ir_none(),
+    .sym = -1,
+    .target = {-1, -1},
+    .nargs = 0,
+    .args = NULL,
+    .lineno = lineno
+  };
+  return inst;
+}
+
+// 在第 i 条指令之前插入一条指令，返回的指针在下一次插入之前有效
+ir_inst_t *ir_insert(ir_func_t *func, int block, int i, ir_op_t op, int lineno) {
+  ir_emit(func, block, op, lineno);
+  ir_block_t *bb = &func->blocks[block];
+  ir_inst_t inst = bb->insts[bb->size - 1];
+  memmove(&bb->insts[i + 1], &bb->insts[i], (unsigned) (bb->size - 1 - i) * sizeof(ir_inst_t));
+  bb->insts[i] = inst;
+  return &bb->insts[i];
+}
+
+void ir_remove_inst(ir_block_t *block, int i) {
+  free(block->insts[i].args);
+  memmove(&block->insts[i], &block->insts[i + 1], (unsigned) (block->size - i - 1) * sizeof(ir_inst_t));
+  block->size--;
+}
+
+int ir_find_func(ir_prog_t *prog, const char *name) {
+  for (int i = 0; i < prog->nfuncs; i++)
+    if (strcmp(prog->funcs[i]->name, name) == 0)
+      return i;
+  return -1;
+}
+
+bool ir_is_terminator(ir_op_t op) {
+  return op == IR_JMP || op == IR_BR || op == IR_RET;
+}
+
+// 删除后会改变程序行为的指令；除数可能为 0 的除法会报告运行时错误
+bool ir_has_side_effect(ir_inst_t *inst) {
+  ir_op_t op = inst->op;
+  if (op == IR_DIV) return inst->b.kind != IRV_IMM || inst->b.val == 0;
+  return op == IR_GSTORE || op == IR_STORE || op == IR_CALL || op == IR_CHECK || ir_is_terminator(op);
+}
+
+// 按 32 位补码回绕计算二元运算，调用者保证除数不为 0
+int ir_eval(ir_op_t op, int a, int b) {
+  switch (op) {
+    case IR_ADD: return (int) ((unsigned) a + (unsigned) b);
+    case IR_SUB: return (int) ((unsigned) a - (unsigned) b);
+    case IR_MUL: return (int) ((unsigned) a * (unsigned) b);
+    case IR_DIV: return a == INT_MIN && b == -1 ? INT_MIN : a / b;
+    case IR_LT: return a < b;
+    case IR_LE: return a <= b;
+    case IR_GT: return a > b;
+    case IR_GE: return a >= b;
+    case IR_EQ: return a == b;
+    case IR_NE: return a != b;
+    default:
+      assert(0);
+      return 0;
+  }
+}
+
+// return f(...)：调用之后紧接着返回它的结果，调用者的栈帧可以交给被调函数。
+// 调用者的局部数组随栈帧一起释放，所以调用者有局部数组时被调函数不能有数组参数
+bool ir_is_tail_call(ir_prog_t *prog, ir_func_t *func, ir_block_t *block, int i) {
+  ir_inst_t *call = &block->insts[i];
+  if (call->op != IR_CALL || i + 1 >= block->size) return false;
+  ir_inst_t *ret = &block->insts[i + 1];
+  if (ret->op != IR_RET) return false;
+  if (ret->a.kind != IRV_NONE && !(ret->a.kind == IRV_REG && ret->a.val == call->dst)) return false;
+  ir_func_t *callee = prog->funcs[call->sym];
+  if (callee->builtin) return false;
+  for (int k = 0; k < callee->nparams && func->narrays; k++)
+    if (callee->param_array[k]) return false;
+  return true;
+}
+
+bool ir_is_binop(ir_op_t op) {
+  return op >= IR_ADD && op <= IR_NE;
+}
+
+// 把 inst 读取的虚拟寄存器写入 uses，返回个数（可能重复）
+int ir_inst_uses(ir_inst_t *inst, int *uses) {
+  int n = 0;
+  if (inst->a.kind == IRV_REG) uses[n++] = inst->a.val;
+  if (inst->b.kind == IRV_REG) uses[n++] = inst->b.val;
+  if (inst->c.kind == IRV_REG) uses[n++] = inst->c.val;
+  for (int i = 0; i < inst->nargs; i++)
+    if (inst->args[i].kind == IRV_REG) uses[n++] = inst->args[i].val;
+  return n;
+}
+
+int ir_func_size(ir_func_t *func) {
+  int n = 0;
+  for (int i = 0; i < func->nblocks; i++)
+    n += func->blocks[i].size;
+  return n;
+}
+
+int ir_prog_size(ir_prog_t *prog) {
+  int n = 0;
+  for (int i = 0; i < prog->nfuncs; i++)
+    n += ir_func_size(prog->funcs[i]);
+  return n;
+}
+
+// 后继基本块写入 succ，返回个数
+int ir_succs(ir_block_t *block, int *succ) {
+  if (block->size == 0) return 0;
+  ir_inst_t *last = &block->insts[block->size - 1];
+  if (last->op == IR_JMP) {
+    succ[0] = last->target[0];
+    return 1;
+  }
+  if (last->op == IR_BR) {
+    succ[0] = last->target[0];
+    succ[1] = last->target[1];
+    return succ[0] == succ[1] ? 1 : 2;
+  }
+  return 0;
+}
+
+// 前驱表，preds[b] 中有 npreds[b] 个前驱，按前驱的编号从小到大排列
+int **ir_preds(ir_func_t *func, int *npreds) {
+  int n = func->nblocks;
+  int **preds = (int **) calloc((unsigned) n, sizeof(int *));
+  for (int b = 0; b < n; b++) {
+    int succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    for (int s = 0; s < nsucc; s++) {
+      preds[succ[s]] = (int *) realloc(preds[succ[s]], (unsigned) (npreds[succ[s]] + 1) * sizeof(int));
+      preds[succ[s]][npreds[succ[s]]++] = b;
+    }
+  }
+  return preds;
+}
+
+void ir_free_preds(ir_func_t *func, int **preds) {
+  for (int b = 0; b < func->nblocks; b++)
+    free(preds[b]);
+  free(preds);
+}
+
+// 经典的逆向数据流迭代，求出每个基本块入口和出口的活跃虚拟寄存器
+ir_live_t *ir_liveness(ir_func_t *func) {
+  ir_live_t *live = (ir_live_t *) malloc(sizeof(ir_live_t));
+  int words = live->words = func->nregs / IR_BITS + 1;
+  int n = func->nblocks;
+  live->in = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  live->out = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  unsigned **use = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  unsigned **def = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  int cap_uses = 16;
+  int *uses = (int *) malloc((unsigned) cap_uses * sizeof(int));
+
+  for (int b = 0; b < n; b++) {
+    live->in[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    live->out[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    use[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    def[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->nargs + 3 > cap_uses) {
+        cap_uses = inst->nargs + 3;
+        uses = (int *) realloc(uses, (unsigned) cap_uses * sizeof(int));
+      }
+      int nuse = ir_inst_uses(inst, uses);
+      for (int k = 0; k < nuse; k++)
+        if (!bit_test(def[b], uses[k]))
+          bit_set(use[b], uses[k]);
+      if (inst->dst >= 0)
+        bit_set(def[b], inst->dst);
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = n - 1; b >= 0; b--) {
+      int succ[2];
+      int nsucc = ir_succs(&func->blocks[b], succ);
+      for (int w = 0; w < words; w++) {
+        unsigned out = 0;
+        for (int s = 0; s < nsucc; s++)
+          out |= live->in[succ[s]][w];
+        unsigned in = use[b][w] | (out & ~def[b][w]);
+        if (out != live->out[b][w] || in != live->in[b][w]) {
+          live->out[b][w] = out;
+          live->in[b][w] = in;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for (int b = 0; b < n; b++) {
+    free(use[b]);
+    free(def[b]);
+  }
+  free(use);
+  free(def);
+  free(uses);
+  return live;
+}
+
+void ir_free_liveness(ir_func_t *func, ir_live_t *live) {
+  for (int b = 0; b < func->nblocks; b++) {
+    free(live->in[b]);
+    free(live->out[b]);
+  }
+  free(live->in);
+  free(live->out);
+  free(live);
+}
+
+static void print_val(ir_val_t v) {
+  if (v.kind == IRV_REG) printf("t%d", v.val);
+  else if (v.kind == IRV_IMM) printf("%d", v.val);
+  else printf("_");
+}
+
+static void print_inst(ir_prog_t *prog, ir_func_t *func, ir_inst_t *inst) {
+  printf("  ");
+  if (inst->dst >= 0) printf("t%d = ", inst->dst);
+  switch (inst->op) {
+    case IR_MOV:
+      print_val(inst->a);
+      break;
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_LT: case IR_LE: case IR_GT: case IR_GE: case IR_EQ: case IR_NE:
+      print_val(inst->a);
+      printf(" %s ", op_name[inst->op]);
+      print_val(inst->b);
+      break;
+    case IR_GLOAD:
+    case IR_GADDR:
+      printf("%s @%s", op_name[inst->op], prog->globals[inst->sym].name);
+      break;
+    case IR_GSTORE:
+      printf("gstore @%s, ", prog->globals[inst->sym].name);
+      print_val(inst->a);
+      break;
+    case IR_LADDR:
+      printf("laddr $%d[%d]", inst->sym, func->array_size[inst->sym]);
+      break;
+    case IR_LOAD:
+      print_val(inst->a);
+      printf("[");
+      print_val(inst->b);
+      printf("]");
+      break;
+    case IR_STORE:
+      print_val(inst->a);
+      printf("[");
+      print_val(inst->b);
+      printf("] = ");
+      print_val(inst->c);
+      break;
+    case IR_LEN:
+      printf("len ");
+      print_val(inst->a);
+      break;
+    case IR_CHECK:
+      printf("check ");
+      print_val(inst->a);
+      printf(" < ");
+      print_val(inst->b);
+      break;
+    case IR_CALL:
+    case IR_PHI:
+      if (inst->op == IR_CALL) printf("call %s(", prog->funcs[inst->sym]->name);
+      else printf("phi(");
+      for (int i = 0; i < inst->nargs; i++) {
+        if (i) printf(", ");
+        print_val(inst->args[i]);
+      }
+      printf(")");
+      break;
+    case IR_JMP:
+      printf("jmp L%d", inst->target[0]);
+      break;
+    case IR_BR:
+      printf("br ");
+      print_val(inst->a);
+      printf(", L%d, L%d", inst->target[0], inst->target[1]);
+      break;
+    case IR_RET:
+      printf("ret");
+      if (inst->a.kind != IRV_NONE) {
+        printf(" ");
+        print_val(inst->a);
+      }
+      break;
+    default:
+      printf("%s", op_name[inst->op]);
+  }
+  printf("\n");
+}
+
+void print_ir(ir_prog_t *prog) {
+  for (int i = 0; i < prog->nglobals; i++) {
+    if (prog->globals[i].external) printf("extern ");
+    if (prog->globals[i].size) printf("global @%s[%d]\n", prog->globals[i].name, prog->globals[i].size);
+    else printf("global @%s\n", prog->globals[i].name);
+  }
+  for (int f = 0; f < prog->nfuncs; f++) {
+    ir_func_t *func = prog->funcs[f];
+    if (func->builtin) continue;
+    printf(func->external ? "\nextern function %s %s(" : "\nfunction %s %s(", func->returns_value ? "int" : "void", func->name);
+    for (int i = 0; i < func->nparams; i++)
+      printf(i ? ", t%d%s" : "t%d%s", i, func->param_array[i] ? "[]" : "");
+    printf(")\n");
+    for (int b = 0; b < func->nblocks; b++) {
+      printf("L%d:\n", b);
+      for (int i = 0; i < func->blocks[b].size; i++)
+        print_inst(prog, func, &func->blocks[b].insts[i]);
+    }
+  }
+}
@@ -0,0 +1,388 @@
+#define _DEFAULT_SOURCE
+#include <jit.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <x86.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// 需要回填的 32 位相对偏移：pos 处的值等于目标地址减去 end
+typedef struct fixup_t {
+  int pos, end;
+  int target;
+} fixup_t;
+
+typedef struct fixups_t {
+  int size, cap;
+  fixup_t *items;
+} fixups_t;
+
+static unsigned char *code;
+static int code_size, code_cap;
+static fixups_t label_fix, call_fix, data_fix;
+static int *label_pos;
+
+static void byte(int b) {
+  if (code_size == code_cap) {
+    code_cap = code_cap ? 2 * code_cap : 4096;
+    code = (unsigned char *) realloc(code, (unsigned) code_cap);
+  }
+  code[code_size++] = (unsigned char) b;
+}
+
+static void dword(int v) {
+  unsigned u = (unsigned) v;
+  for (int i = 0; i < 4; i++)
+    byte((int) ((u >> (8 * i)) & 0xff));
+}
+
+static void patch(int pos, int v) {
+  memcpy(code + pos, &v, 4);
+}
+
+// 在当前位置留出 4 字节，之后回填为到 target 的偏移
+static void add_fixup(fixups_t *fix, int end, int target) {
+  if (fix->size == fix->cap) {
+    fix->cap = fix->cap ? 2 * fix->cap : 64;
+    fix->items = (fixup_t *) realloc(fix->items, (unsigned) fix->cap * sizeof(fixup_t));
+  }
+  fix->items[fix->size++] = (fixup_t) { .pos = code_size, .end = end, .target = target };
+  dword(0);
+}
+
+static bool fits8(int v) {
+  return v >= -128 && v < 128;
+}
+
+// 编码带 ModRM 的指令，r 是 reg 字段（寄存器或扩展操作码），rm 是寄存器或内存操作数
+// byte_reg 表示 rm 是 8 位寄存器，imm_size 是紧随其后的立即数长度，用于计算 %rip 相对偏移
+static void modrm(bool w, bool two_byte, int opcode, int r, x86_opnd_t rm, bool byte_reg, int imm_size) {
+  int rex = 0x40 | (w ? 8 : 0) | (r >= 8 ? 4 : 0);
+  if (rm.kind == XO_MEM && rm.index >= 8) rex |= 2;
+  if ((rm.kind == XO_REG || rm.kind == XO_MEM) && rm.reg >= 8) rex |= 1;
+  // %spl、%bpl、%sil、%dil 必须带 REX 前缀
+  if (rex != 0x40 || (byte_reg && rm.kind == XO_REG && rm.reg >= RSP && rm.reg <= RDI))
+    byte(rex);
+  if (two_byte) byte(0x0f);
+  byte(opcode);
+  r &= 7;
+  switch (rm.kind) {
+    case XO_REG:
+      byte(0xc0 | r << 3 | (rm.reg & 7));
+      break;
+    case XO_GLOBAL:
+      byte(r << 3 | 5);
+      add_fixup(&data_fix, code_size + 4 + imm_size, rm.sym);
+      break;
+    case XO_MEM: {
+      int mod = rm.disp == 0 && (rm.reg & 7) != RBP ? 0 : fits8(rm.disp) ? 1 : 2;
+      if (rm.index >= 0) {
+        int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        byte(mod << 6 | r << 3 | 4);
+        byte(scale << 6 | (rm.index & 7) << 3 | (rm.reg & 7));
+      } else if ((rm.reg & 7) == RSP) {
+        byte(mod << 6 | r << 3 | 4);
+        byte(0x24);
+      } else {
+        byte(mod << 6 | r << 3 | (rm.reg & 7));
+      }
+      if (mod == 1) byte(rm.disp & 0xff);
+      if (mod == 2) dword(rm.disp);
+      break;
+    }
+    default:
+      assert(0);
+  }
+}
+
+// add、sub、cmp 的扩展操作码，对应的 r/m 形式操作码为 ext << 3 | 1
+static int alu_ext(x86_op_t op) {
+  return op == X_ADD ? 0 : op == X_SUB ? 5 : 7;
+}
+
+static void encode(x86_inst_t *inst) {
+  bool w = inst->size == 8;
+  x86_opnd_t s = inst->src, d = inst->dst;
+  switch (inst->op) {
+    case X_MOV:
+      if (s.kind == XO_IMM && d.kind == XO_REG && !w) {
+        if (d.reg >= 8) byte(0x41);
+        byte(0xb8 + (d.reg & 7));
+        dword(s.disp);
+      } else if (s.kind == XO_IMM) {
+        modrm(w, false, 0xc7, 0, d, false, 4);
+        dword(s.disp);
+      } else if (s.kind == XO_REG) {
+        modrm(w, false, 0x89, s.reg, d, false, 0);
+      } else {
+        modrm(w, false, 0x8b, d.reg, s, false, 0);
+      }
+      break;
+    case X_MOVSLQ:
+      modrm(true, false, 0x63, d.reg, s, false, 0);
+      break;
+    case X_MOVZBL:
+      modrm(false, true, 0xb6, d.reg, s, true, 0);
+      break;
+    case X_LEA:
+      modrm(true, false, 0x8d, d.reg, s, false, 0);
+      break;
+    case X_ADD: case X_SUB: case X_CMP: {
+      int ext = alu_ext(inst->op);
+      if (s.kind == XO_IMM && fits8(s.disp)) {
+        modrm(w, false, 0x83, ext, d, false, 1);
+        byte(s.disp & 0xff);
+      } else if (s.kind == XO_IMM) {
+        modrm(w, false, 0x81, ext, d, false, 4);
+        dword(s.disp);
+      } else if (s.kind == XO_REG) {
+        modrm(w, false, ext << 3 | 1, s.reg, d, false, 0);
+      } else {
+        modrm(w, false, ext << 3 | 3, d.reg, s, false, 0);
+      }
+      break;
+    }
+    case X_TEST:
+      modrm(w, false, 0x85, s.reg, d, false, 0);
+      break;
+    case X_IMUL:
+      if (inst->imm.kind == XO_IMM && fits8(inst->imm.disp)) {
+        modrm(w, false, 0x6b, d.reg, s, false, 1);
+        byte(inst->imm.disp & 0xff);
+      } else if (inst->imm.kind == XO_IMM) {
+        modrm(w, false, 0x69, d.reg, s, false, 4);
+        dword(inst->imm.disp);
+      } else {
+        modrm(w, true, 0xaf, d.reg, s, false, 0);
+      }
+      break;
+    case X_CDQ:
+      byte(0x99);
+      break;
+    case X_IDIV:
+      modrm(w, false, 0xf7, 7, s, false, 0);
+      break;
+    case X_SETCC:
+      modrm(false, true, 0x90 + inst->cc, 0, d, true, 0);
+      break;
+    case X_JMP:
+      // 尾调用跳到其他函数
+      byte(0xe9);
+      add_fixup(s.kind == XO_FUNC ? &call_fix : &label_fix, code_size + 4, s.sym);
+      break;
+    case X_JCC:
+      byte(0x0f);
+      byte(0x80 + inst->cc);
+      add_fixup(&label_fix, code_size + 4, s.sym);
+      break;
+    case X_CALL:
+      byte(0xe8);
+      add_fixup(&call_fix, code_size + 4, s.sym);
+      break;
+    case X_RET:
+      byte(0xc3);
+      break;
+    case X_LEAVE:
+      byte(0xc9);
+      break;
+    case X_PUSH:
+      if (s.kind == XO_REG) {
+        if (s.reg >= 8) byte(0x41);
+        byte(0x50 + (s.reg & 7));
+      } else if (s.kind == XO_IMM) {
+        byte(0x68);
+        dword(s.disp);
+      } else {
+        modrm(false, false, 0xff, 6, s, false, 0);
+      }
+      break;
+    case X_POP:
+      if (d.reg >= 8) byte(0x41);
+      byte(0x58 + (d.reg & 7));
+      break;
+    case X_LABEL:
+      label_pos[s.sym] = code_size;
+      break;
+    default:
+      assert(0);
+  }
+}
+
+static int jit_input(void) {
+  int x;
+  if (scanf("%d", &x) != 1) x = 0;
+  return x;
+}
+
+static void jit_output(int x) {
+  printf("%d\n", x);
+}
+
+static void jit_bounds_fail(int lineno) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error at line %d (array index out of bounds)\n", lineno);
+  exit(-1);
+}
+
+static void jit_div_fail(int lineno) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error at line %d (division by zero)\n", lineno);
+  exit(-1);
+}
+
+static void jit_depth_fail(int lineno) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error at line %d (recursion too deep)\n", lineno);
+  exit(-1);
+}
+
+// 跳到宿主程序中 addr 处的函数的跳板：movabs $addr, %rax; jmp *%rax
+static void trampoline(unsigned long long addr) {
+  byte(0x48);
+  byte(0xb8);
+  for (int i = 0; i < 8; i++)
+    byte((int) ((addr >> (8 * i)) & 0xff));
+  byte(0xff);
+  byte(0xe0);
+}
+
+static double elapsed_ms(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - start->tv_sec) * 1e3 + (double) (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+bool jit_run(ir_prog_t *prog, bool allocate, bool report, int *ret) {
+  int m = ir_find_func(prog, "main");
+  if (m < 0 || prog->funcs[m]->nparams > 6) return false;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  code_size = 0;
+  label_fix.size = call_fix.size = data_fix.size = 0;
+  int *func_pos = (int *) malloc((unsigned) prog->nfuncs * sizeof(int));
+
+  // 内建函数通过跳板调用宿主程序中的实现，不受 rel32 的范围限制
+  for (int f = 0; f < prog->nfuncs; f++) {
+    if (!prog->funcs[f]->builtin) continue;
+    func_pos[f] = code_size;
+    if (f == IR_INPUT) trampoline((unsigned long long) (size_t) jit_input);
+    else trampoline((unsigned long long) (size_t) jit_output);
+  }
+  int bounds_pos = code_size;
+  trampoline((unsigned long long) (size_t) jit_bounds_fail);
+  int depth_pos = code_size;
+  trampoline((unsigned long long) (size_t) jit_depth_fail);
+  int div_pos = code_size;
+  trampoline((unsigned long long) (size_t) jit_div_fail);
+  // 入口：切换到 %rdi 指向的栈顶，以全为 0 的参数调用 main，返回时恢复原来的栈
+  int entry_pos = code_size;
+  x86_inst_t enter[] = {
+    { .op = X_PUSH, .size = 8, .src = { .kind = XO_REG, .reg = RBP } },
+    { .op = X_MOV, .size = 8, .src = { .kind = XO_REG, .reg = RSP }, .dst = { .kind = XO_REG, .reg = RBP } },
+    { .op = X_MOV, .size = 8, .src = { .kind = XO_REG, .reg = RDI }, .dst = { .kind = XO_REG, .reg = RSP } },
+  };
+  for (int i = 0; i < 3; i++)
+    encode(&enter[i]);
+  for (int i = 0; i < prog->funcs[m]->nparams; i++) {
+    x86_inst_t zero = { .op = X_MOV, .size = 4, .src = { .kind = XO_IMM, .disp = 0 }, .dst = { .kind = XO_REG, .reg = arg_regs[i] } };
+    encode(&zero);
+  }
+  x86_inst_t call_main = { .op = X_CALL, .size = 8, .src = { .kind = XO_FUNC, .sym = m } };
+  x86_inst_t leave = { .op = X_LEAVE, .size = 8 }, ret_inst = { .op = X_RET, .size = 8 };
+  encode(&call_main);
+  encode(&leave);
+  encode(&ret_inst);
+  int max_frame = 0, tail_calls = x86_tail_calls;
+  for (int f = 0; f < prog->nfuncs; f++) {
+    if (prog->funcs[f]->builtin) continue;
+    x86_func_t *xf = x86_select(prog, f, allocate);
+    if (xf->frame_bytes > max_frame) max_frame = xf->frame_bytes;
+    while (code_size % 16) byte(0x90);
+    func_pos[f] = code_size;
+    label_pos = (int *) malloc((unsigned) xf->nlabels * sizeof(int));
+    label_fix.size = 0;
+    for (int i = 0; i < xf->size; i++)
+      encode(&xf->insts[i]);
+    for (int i = 0; i < label_fix.size; i++)
+      patch(label_fix.items[i].pos, label_pos[label_fix.items[i].target] - label_fix.items[i].end);
+    free(label_pos);
+  }
+  for (int i = 0; i < call_fix.size; i++) {
+    int t = call_fix.items[i].target;
+    int target = t == BOUNDS_FAIL ? bounds_pos : t == DEPTH_FAIL ? depth_pos : t == DIV_FAIL ? div_pos : func_pos[t];
+    patch(call_fix.items[i].pos, target - call_fix.items[i].end);
+  }
+
+  // 代码页之后紧跟全局变量所在的数据页，代码通过 %rip 相对地址访问全局变量
+  long page = sysconf(_SC_PAGESIZE);
+  int code_bytes = (int) ((code_size + page - 1) / page * page);
+  int *global_pos = (int *) malloc((unsigned) prog->nglobals * sizeof(int) + 1);
+  int data_size = 0;
+  // 数组前面是保存长度的一个 int
+  for (int g = 0; g < prog->nglobals; g++) {
+    if (prog->globals[g].size) data_size += 4;
+    global_pos[g] = data_size;
+    data_size += 4 * (prog->globals[g].size ? prog->globals[g].size : 1);
+  }
+  // 全局变量之后是 8 字节对齐的栈的下限
+  int stack_limit = (data_size + 7) / 8 * 8;
+  data_size = stack_limit + 8;
+  int data_bytes = (int) ((data_size + page - 1) / page * page);
+  for (int i = 0; i < data_fix.size; i++) {
+    int t = data_fix.items[i].target;
+    patch(data_fix.items[i].pos, code_bytes + (t == STACK_LIMIT ? stack_limit : global_pos[t]) - data_fix.items[i].end);
+  }
+
+  // W^X：写入机器码后代码页改为只读可执行，数据页保持可读写
+  unsigned char *mem = (unsigned char *) mmap(NULL, (size_t) (code_bytes + data_bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return false;
+  memcpy(mem, code, (size_t) code_size);
+  for (int g = 0; g < prog->nglobals; g++)
+    if (prog->globals[g].size) memcpy(mem + code_bytes + global_pos[g] - 4, &prog->globals[g].size, 4);
+  if (mprotect(mem, (size_t) code_bytes, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, (size_t) (code_bytes + data_bytes));
+    return false;
+  }
+  // 栈按 -max-depth 层调用的大小映射，只有用到的页才分配内存
+  size_t limit, stack_bytes = x86_stack_size(max_frame, &limit);
+  unsigned char *stack = (unsigned char *) mmap(NULL, stack_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  // 映射失败时不在原来的栈上不检查深度地运行，而是报告并交给精确计数的解释器
+  if (stack == MAP_FAILED) {
+    fprintf(stderr, "jit: cannot map %zu KB of stack for -max-depth, falling back to the interpreter\n", stack_bytes / 1024);
+    munmap(mem, (size_t) (code_bytes + data_bytes));
+    return false;
+  }
+  mprotect(stack, STACK_GUARD, PROT_NONE);
+  unsigned char *lowest = stack + limit;
+  memcpy(mem + code_bytes + stack_limit, &lowest, sizeof(lowest));
+  if (report) {
+    fprintf(stderr, "jit: %d bytes of machine code in %.3f ms, %d tail calls, %zu KB of stack\n", code_size, elapsed_ms(&start),
+            x86_tail_calls - tail_calls, stack_bytes / 1024);
+  }
+
+  int (*entry)(void *);
+  *(void **) &entry = mem + entry_pos;
+  *ret = entry(stack + stack_bytes);
+  fflush(stdout);
+  munmap(stack, stack_bytes);
+  munmap(mem, (size_t) (code_bytes + data_bytes));
+  free(func_pos);
+  free(global_pos);
+  return true;
+}
+
+#else
+
+// 其他平台上总是回退到解释器
+bool jit_run(ir_prog_t *prog, bool allocate, bool report, int *ret) {
+  (void) prog;
+  (void) allocate;
+  (void) report;
+  (void) ret;
+  return false;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <lexer.h>
+#include <error.h>
 
 typedef enum {
     START,
@@ -30,12 +31,12 @@ token_t* new_token(const char *name, int lineno, const char *value) {
 // @param line: the line number
 // @returns the next token
 token_t* getToken(FILE *fp, int *line) {
-    char c;
+    int c;
     State state = START;
     char value[64];
     int i = 0;
 
-    while ((c = (char) fgetc(fp)) != EOF) {
+    while ((c = fgetc(fp)) != EOF) {
         switch (state) {
             case START:
                 if (isspace(c)) {
@@ -47,23 +48,23 @@ token_t* getToken(FILE *fp, int *line) {
                 } else if (c == '<' || c == '>') {
                     // 处理关系运算符
                     state = RELOP;
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (c == '=') {
                     // 处理赋值操作符
                     state = ASSIGN;
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (c == '!') {
                     // 处理叹号
                     state = SHARP;
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (isdigit(c)) {
                     // 处理数字
                     state = NUM;
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (isalpha(c)) {
                     // 处理标识符或关键字
                     state = WORD;
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (c == ';') {
                     // 处理分号
                     return new_token("SEMI", *line, ";");
@@ -145,9 +146,12 @@ token_t* getToken(FILE *fp, int *line) {
                 }
                 break;
             case NUM:
-                if (isdigit(c)) {
+                if (i == (int) sizeof(value) - 1 && isalnum(c)) {
+                    // 词素超出 token_t 的 value 长度
+                    return new_token("EXCEPTION", *line, "TOKEN_TOO_LONG");
+                } else if (isdigit(c)) {
                     // 继续读取数字
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (isalpha(c)) {
                     // 数字后面有字母，进入PANIC状态
                     value[i] = '\0';
@@ -160,9 +164,12 @@ token_t* getToken(FILE *fp, int *line) {
                 }
                 break;
             case WORD:
-                if (isalpha(c)) {
+                if (i == (int) sizeof(value) - 1 && isalnum(c)) {
+                    // 词素超出 token_t 的 value 长度
+                    return new_token("EXCEPTION", *line, "TOKEN_TOO_LONG");
+                } else if (isalpha(c)) {
                     // 继续读取标识符或关键字
-                    value[i++] = c;
+                    value[i++] = (char) c;
                 } else if (isdigit(c)) {
                     // 标识符或关键字后面有数字，进入PANIC状态
                     return new_token("EXCEPTION", *line, "INVALID_TOKEN");
@@ -205,8 +212,8 @@ token_t* getToken(FILE *fp, int *line) {
                 }
                 break;
             default:
-                fprintf(stderr, "LEXER_PANIC: INVALID STATE");
-                exit(-1);
+                meow_report(*line, "LEXER_PANIC: INVALID STATE");
+                meow_fail();
         }
     }
 
@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+#include <libmeow.h>
+#include <lexer.h>
+#include <syntax.h>
+#include <error.h>
+
+typedef struct diag_t {
+  int lineno;
+  char *message;
+} diag_t;
+
+struct meow_compilation_t {
+  int flags;
+  token_t **tokens;     // tokens[ntokens] 是末尾的 EOT（分析过时）
+  int ntokens, cap;
+  bool has_eot;
+  syntax_t *root;
+  void **blocks;        // 语法分析树所在的内存，以 NULL 结尾
+  int nblocks;
+  diag_t *diags;
+  int ndiags;
+  bool failed;
+  FILE *fp;
+};
+
+// 正在分析的结果，diag_handler 把诊断信息记到这里
+static meow_compilation_t *current;
+
+// 分析期间替换掉的全局状态
+typedef struct saved_t {
+  jmp_buf *error_handler;
+  void (*diag_handler)(int, const char *);
+  bool compact_expr, skeleton_bodies, share_subtrees, flat_lists, abstract_syntax;
+} saved_t;
+
+static void collect(int lineno, const char *message) {
+  meow_compilation_t *c = current;
+  diag_t *diags = (diag_t *) realloc(c->diags, (unsigned) (c->ndiags + 1) * sizeof(diag_t));
+  if (diags == NULL) return;
+  c->diags = diags;
+  size_t len = strlen(message);
+  while (len > 0 && message[len - 1] == '\n') len--;
+  char *copy = (char *) malloc(len + 1);
+  if (copy == NULL) return;
+  memcpy(copy, message, len);
+  copy[len] = '\0';
+  c->diags[c->ndiags].lineno = lineno;
+  c->diags[c->ndiags++].message = copy;
+}
+
+static void push_token(meow_compilation_t *c, token_t *tok) {
+  if (c->ntokens + 1 >= c->cap) {
+    c->cap = c->cap ? 2 * c->cap : 256;
+    c->tokens = (token_t **) realloc(c->tokens, (unsigned) c->cap * sizeof(token_t *));
+  }
+  c->tokens[c->ntokens++] = tok;
+}
+
+// 和 meowCC 一样，遇到第一个词法错误就停止
+static int lex(meow_compilation_t *c, const char *source, size_t size) {
+  int line_number = 1;
+  // 空输入时 fmemopen 可能失败，此时没有词法单元
+  c->fp = size ? fmemopen((void *) source, size, "r") : NULL;
+  token_t *tok;
+  while (c->fp != NULL && (tok = getToken(c->fp, &line_number)) != NULL) {
+    if (strcmp(tok->name, "EXCEPTION") == 0) {
+      meow_report(tok->lineno, "lexical error at line %d, type %s\n", tok->lineno, tok->value);
+      free(tok);
+      c->failed = true;
+      break;
+    }
+    push_token(c, tok);
+  }
+  return line_number;
+}
+
+static void enter(meow_compilation_t *c, jmp_buf *env, saved_t *saved) {
+  saved->error_handler = error_handler;
+  saved->diag_handler = diag_handler;
+  saved->compact_expr = compact_expr;
+  saved->skeleton_bodies = skeleton_bodies;
+  saved->share_subtrees = share_subtrees;
+  saved->flat_lists = flat_lists;
+  saved->abstract_syntax = abstract_syntax;
+  current = c;
+  error_handler = env;
+  diag_handler = collect;
+  token_list = c->tokens;
+  token_cnt = c->ntokens;
+  compact_expr = (c->flags & MEOW_COMPACT) != 0;
+  skeleton_bodies = (c->flags & MEOW_SKELETON) != 0;
+  share_subtrees = (c->flags & MEOW_SHARED) != 0;
+  flat_lists = (c->flags & MEOW_FLAT) != 0;
+  abstract_syntax = (c->flags & MEOW_AST) != 0;
+}
+
+// 恢复全局状态，并接管这次分析分配的节点
+static void leave(meow_compilation_t *c, saved_t *saved) {
+  error_handler = saved->error_handler;
+  diag_handler = saved->diag_handler;
+  compact_expr = saved->compact_expr;
+  skeleton_bodies = saved->skeleton_bodies;
+  share_subtrees = saved->share_subtrees;
+  flat_lists = saved->flat_lists;
+  abstract_syntax = saved->abstract_syntax;
+  current = NULL;
+  token_list = NULL;
+  token_cnt = 0;
+  void **blocks = parser_detach();
+  int n = 0;
+  while (blocks[n] != NULL) n++;
+  c->blocks = (void **) realloc(c->blocks, (unsigned) (c->nblocks + n + 1) * sizeof(void *));
+  memcpy(c->blocks + c->nblocks, blocks, (unsigned) (n + 1) * sizeof(void *));
+  c->nblocks += n;
+  free(blocks);
+}
+
+static void parse(meow_compilation_t *c, int flags, int line_number) {
+  push_token(c, new_token("EOT", line_number, "EOT"));
+  c->ntokens--;
+  c->has_eot = true;
+  token_list = c->tokens;
+  token_cnt = c->ntokens;
+  syntax_t *root = flags & MEOW_EXPRESSION ? expression(true) : program(true);
+  if (token_cnt != current_token_cnt) {
+    meow_report(token_list[current_token_cnt]->lineno, "SYNTATIC PANIC: EXTRA TOKENS\n");
+    c->failed = true;
+  } else {
+    c->root = root;
+  }
+}
+
+meow_compilation_t *meow_compile(const char *source, size_t size, int flags) {
+  meow_compilation_t *c = (meow_compilation_t *) calloc(1, sizeof(meow_compilation_t));
+  if (c == NULL) return NULL;
+  c->flags = flags;
+  jmp_buf env;
+  saved_t saved;
+  enter(c, &env, &saved);
+  // 词法分析和语法分析中的错误报告之后 longjmp 回到这里
+  if (setjmp(env) == 0) {
+    int line_number = lex(c, source, size);
+    if (!c->failed && !(flags & MEOW_LEX_ONLY))
+      parse(c, flags, line_number);
+  } else {
+    c->failed = true;
+  }
+  if (c->fp != NULL) {
+    fclose(c->fp);
+    c->fp = NULL;
+  }
+  leave(c, &saved);
+  return c;
+}
+
+const meow_node_t *meow_function_body(meow_compilation_t *c, const meow_node_t *fun) {
+  // 函数体是最后一个子节点，MEOW_AST 时 fun_declaration 的子节点比语法分析树少
+  syntax_t *body = fun->symbol.child[fun->symbol.size - 1];
+  if (strcmp(body->symbol.name, "lazy_compound_stmt") != 0) return body;
+  jmp_buf env;
+  saved_t saved;
+  enter(c, &env, &saved);
+  if (setjmp(env) == 0) {
+    body = function_body((syntax_t *) fun);
+  } else {
+    body = NULL;
+    c->failed = true;
+  }
+  leave(c, &saved);
+  return body;
+}
+
+void meow_free(meow_compilation_t *c) {
+  if (c == NULL) return;
+  for (int i = 0; i < c->ntokens + (c->has_eot ? 1 : 0); i++)
+    free(c->tokens[i]);
+  free(c->tokens);
+  for (int i = 0; c->blocks != NULL && c->blocks[i] != NULL; i++)
+    free(c->blocks[i]);
+  free(c->blocks);
+  for (int i = 0; i < c->ndiags; i++)
+    free(c->diags[i].message);
+  free(c->diags);
+  free(c);
+}
+
+int meow_ok(const meow_compilation_t *c) {
+  return !c->failed;
+}
+
+int meow_token_count(const meow_compilation_t *c) {
+  return c->ntokens;
+}
+
+const char *meow_token_name(const meow_compilation_t *c, int index) {
+  return c->tokens[index]->name;
+}
+
+const char *meow_token_value(const meow_compilation_t *c, int index) {
+  return c->tokens[index]->value;
+}
+
+int meow_token_line(const meow_compilation_t *c, int index) {
+  return c->tokens[index]->lineno;
+}
+
+const meow_node_t *meow_root(const meow_compilation_t *c) {
+  return c->root;
+}
+
+const char *meow_node_name(const meow_node_t *node) {
+  return node->type == TOKEN ? node->token.name : node->symbol.name;
+}
+
+const char *meow_node_value(const meow_node_t *node) {
+  return node->type == TOKEN ? node->token.value : NULL;
+}
+
+int meow_node_line(const meow_node_t *node) {
+  return node->type == TOKEN ? node->token.lineno : node->symbol.lineno;
+}
+
+int meow_node_child_count(const meow_node_t *node) {
+  return node->type == TOKEN ? 0 : node->symbol.size;
+}
+
+const meow_node_t *meow_node_child(const meow_node_t *node, int index) {
+  return node->symbol.child[index];
+}
+
+int meow_diag_count(const meow_compilation_t *c) {
+  return c->ndiags;
+}
+
+const char *meow_diag_message(const meow_compilation_t *c, int index) {
+  return c->diags[index].message;
+}
+
+int meow_diag_line(const meow_compilation_t *c, int index) {
+  return c->diags[index].lineno;
+}
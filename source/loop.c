@@ -0,0 +1,398 @@
+#include <optim.h>
+
+bool loop_off = false;
+
+// 自然循环：循环头以及能不经过循环头到达回边起点的基本块
+typedef struct loop_t {
+  int header, size;
+  unsigned *body;
+} loop_t;
+
+typedef struct loops_t {
+  int nloops, words;
+  loop_t *loops;
+} loops_t;
+
+static int compare_size(const void *x, const void *y) {
+  return ((const loop_t *) x)->size - ((const loop_t *) y)->size;
+}
+
+// 迭代求支配集合，找出回边 b -> h（h 支配 b），同一个循环头的回边合并为一个循环
+//
+// 循环按大小从小到大排列，嵌套的内层循环在前；位集留出了给前置基本块的空间
+static loops_t *find_loops(ir_func_t *func) {
+  int n = func->nblocks, words = (2 * n) / IR_BITS + 1;
+  int *npreds = (int *) calloc((unsigned) n, sizeof(int));
+  int **preds = ir_preds(func, npreds);
+
+  bool *reachable = (bool *) calloc((unsigned) n, sizeof(bool));
+  int *stack = (int *) malloc((unsigned) n * sizeof(int));
+  int top = 0;
+  reachable[0] = true;
+  stack[top++] = 0;
+  while (top) {
+    int b = stack[--top], succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    for (int s = 0; s < nsucc; s++)
+      if (!reachable[succ[s]]) {
+        reachable[succ[s]] = true;
+        stack[top++] = succ[s];
+      }
+  }
+
+  unsigned *dom = (unsigned *) malloc((unsigned) (n * words) * sizeof(unsigned));
+  unsigned *now = (unsigned *) malloc((unsigned) words * sizeof(unsigned));
+  for (int b = 0; b < n; b++)
+    memset(&dom[b * words], b ? 0xff : 0, (unsigned) words * sizeof(unsigned));
+  bit_set(dom, 0);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = 1; b < n; b++) {
+      if (!reachable[b]) continue;
+      memset(now, 0xff, (unsigned) words * sizeof(unsigned));
+      for (int p = 0; p < npreds[b]; p++) {
+        if (!reachable[preds[b][p]]) continue;
+        unsigned *d = &dom[preds[b][p] * words];
+        for (int w = 0; w < words; w++)
+          now[w] &= d[w];
+      }
+      bit_set(now, b);
+      if (memcmp(now, &dom[b * words], (unsigned) words * sizeof(unsigned)) != 0) {
+        memcpy(&dom[b * words], now, (unsigned) words * sizeof(unsigned));
+        changed = true;
+      }
+    }
+  }
+
+  loops_t *ls = (loops_t *) calloc(1, sizeof(loops_t));
+  ls->words = words;
+  int *loop_of = (int *) malloc((unsigned) n * sizeof(int));
+  for (int b = 0; b < n; b++)
+    loop_of[b] = -1;
+  for (int b = 0; b < n; b++) {
+    if (!reachable[b]) continue;
+    int succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    for (int s = 0; s < nsucc; s++) {
+      int h = succ[s];
+      if (!bit_test(&dom[b * words], h)) continue;
+      if (loop_of[h] < 0) {
+        loop_of[h] = ls->nloops;
+        ls->loops = (loop_t *) realloc(ls->loops, (unsigned) (ls->nloops + 1) * sizeof(loop_t));
+        ls->loops[ls->nloops++] = (loop_t) {
+          .header = h,
+          .size = 1,
+          .body = (unsigned *) calloc((unsigned) words, sizeof(unsigned))
+        };
+        bit_set(ls->loops[loop_of[h]].body, h);
+      }
+      loop_t *l = &ls->loops[loop_of[h]];
+      if (bit_test(l->body, b)) continue;
+      bit_set(l->body, b);
+      l->size++;
+      top = 0;
+      stack[top++] = b;
+      while (top) {
+        int x = stack[--top];
+        for (int p = 0; p < npreds[x]; p++) {
+          int y = preds[x][p];
+          if (!reachable[y] || bit_test(l->body, y)) continue;
+          bit_set(l->body, y);
+          l->size++;
+          stack[top++] = y;
+        }
+      }
+    }
+  }
+  if (ls->nloops)
+    qsort(ls->loops, (unsigned) ls->nloops, sizeof(loop_t), compare_size);
+
+  ir_free_preds(func, preds);
+  free(npreds);
+  free(reachable);
+  free(stack);
+  free(dom);
+  free(now);
+  free(loop_of);
+  return ls;
+}
+
+static void free_loops(loops_t *ls) {
+  for (int k = 0; k < ls->nloops; k++)
+    free(ls->loops[k].body);
+  free(ls->loops);
+  free(ls);
+}
+
+// 返回循环 k 的前置基本块：循环外只有一个以 jmp 跳到循环头的前驱时直接使用它，
+// 否则新建一个跳到循环头的基本块，循环外的前驱都改为跳到它；新的基本块属于包含循环头的外层循环
+static int preheader(ir_func_t *func, loops_t *ls, int k) {
+  loop_t *l = &ls->loops[k];
+  int h = l->header, outside = -1, cnt = 0;
+  for (int b = 0; b < func->nblocks; b++) {
+    if (bit_test(l->body, b)) continue;
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    if (last->target[0] == h || last->target[1] == h) {
+      outside = b;
+      cnt++;
+    }
+  }
+  if (cnt == 1) {
+    ir_block_t *bb = &func->blocks[outside];
+    if (bb->insts[bb->size - 1].op == IR_JMP) return outside;
+  }
+  int lineno = func->blocks[h].insts[0].lineno;
+  int p = ir_new_block(func);
+  for (int b = 0; b < p; b++) {
+    if (bit_test(l->body, b)) continue;
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    for (int t = 0; t < 2; t++)
+      if (last->target[t] == h) last->target[t] = p;
+  }
+  ir_emit(func, p, IR_JMP, lineno)->target[0] = h;
+  for (int o = 0; o < ls->nloops; o++)
+    if (o != k && bit_test(ls->loops[o].body, h)) {
+      bit_set(ls->loops[o].body, p);
+      ls->loops[o].size++;
+    }
+  return p;
+}
+
+// 统计循环中每个虚拟寄存器被定值的次数
+static void count_defs(ir_func_t *func, unsigned *body, int *defs) {
+  memset(defs, 0, (unsigned) (func->nregs + 1) * sizeof(int));
+  for (int b = 0; b < func->nblocks; b++) {
+    if (!bit_test(body, b)) continue;
+    for (int i = 0; i < func->blocks[b].size; i++)
+      if (func->blocks[b].insts[i].dst >= 0) defs[func->blocks[b].insts[i].dst]++;
+  }
+}
+
+static bool invariant(ir_val_t v, int *defs) {
+  return v.kind != IRV_REG || defs[v.val] == 0;
+}
+
+// 没有副作用、不会出错、只依赖操作数的指令；除法只在除数是 0 和 -1 以外的常量时外提
+static bool movable(ir_inst_t *inst) {
+  // 数组的长度在数组存在期间不变，读取它不会出错
+  if (inst->op == IR_MOV || inst->op == IR_GADDR || inst->op == IR_LADDR || inst->op == IR_LEN) return true;
+  if (inst->op == IR_DIV) return inst->b.kind == IRV_IMM && inst->b.val != 0 && inst->b.val != -1;
+  return ir_is_binop(inst->op);
+}
+
+// 把循环中操作数都是循环不变量的指令移到前置基本块，外提之后的结果也是循环不变量
+//
+// 被外提的寄存器在整个函数中只能有一次定值，这样在循环外读到的值不变；参数在入口有一次隐含的定值，
+// 所以在循环中被赋值的参数不外提，否则之前读到的是新的值
+static int hoist_loop(ir_func_t *func, unsigned *body, int pre, int *defs, int *all_defs) {
+  int hoisted = 0;
+  count_defs(func, body, defs);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = 0; b < func->nblocks; b++) {
+      if (!bit_test(body, b)) continue;
+      ir_block_t *bb = &func->blocks[b];
+      for (int i = 0; i < bb->size; ) {
+        ir_inst_t inst = bb->insts[i];
+        if (inst.dst < 0 || all_defs[inst.dst] != 1 || !movable(&inst) || !invariant(inst.a, defs) || !invariant(inst.b, defs)) {
+          i++;
+          continue;
+        }
+        ir_remove_inst(bb, i);
+        *ir_insert(func, pre, func->blocks[pre].size - 1, inst.op, inst.lineno) = inst;
+        defs[inst.dst] = 0;
+        hoisted++;
+        changed = true;
+      }
+    }
+  }
+  return hoisted;
+}
+
+// 由内向外处理每个循环，返回外提的指令数
+int hoist_invariants(ir_func_t *func) {
+  loops_t *ls = find_loops(func);
+  int hoisted = 0;
+  int *defs = (int *) malloc((unsigned) (func->nregs + 1) * sizeof(int));
+  int *all_defs = (int *) calloc((unsigned) func->nregs + 1, sizeof(int));
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++)
+      if (func->blocks[b].insts[i].dst >= 0) all_defs[func->blocks[b].insts[i].dst]++;
+  for (int r = 0; r < func->nparams; r++)
+    all_defs[r]++;
+  for (int k = 0; k < ls->nloops; k++) {
+    if (ls->loops[k].header == 0) continue;
+    int pre = preheader(func, ls, k);
+    hoisted += hoist_loop(func, ls->loops[k].body, pre, defs, all_defs);
+  }
+  free(defs);
+  free(all_defs);
+  free_loops(ls);
+  return hoisted;
+}
+
+// 基本归纳变量：在循环中只有一次定值 v = v + c（或 v = v - c），c 是循环不变量，
+// 或者经过临时寄存器 t = v + c; v = t
+typedef struct ivar_t {
+  int block, index;     // 定值 v 的指令
+  ir_val_t step;
+} ivar_t;
+
+// inst 是 v + c、c + v 或 v - c（c 是常量）时返回真，步长写入 step
+static bool linear(ir_inst_t *inst, int v, int *defs, ir_val_t *step) {
+  if (inst->op == IR_ADD && inst->a.kind == IRV_REG && inst->a.val == v && invariant(inst->b, defs)) {
+    *step = inst->b;
+  } else if (inst->op == IR_ADD && inst->b.kind == IRV_REG && inst->b.val == v && invariant(inst->a, defs)) {
+    *step = inst->a;
+  } else if (inst->op == IR_SUB && inst->a.kind == IRV_REG && inst->a.val == v && inst->b.kind == IRV_IMM) {
+    *step = ir_imm((int) (0u - (unsigned) inst->b.val));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// 在同一个基本块中找 reg 在第 i 条指令之前的最后一次定值
+static int def_before(ir_block_t *bb, int i, int reg) {
+  for (int j = i - 1; j >= 0; j--)
+    if (bb->insts[j].dst == reg) return j;
+  return -1;
+}
+
+// 找出循环中的基本归纳变量，iv[v].block 为 -1 表示 v 不是
+static void find_ivars(ir_func_t *func, unsigned *body, int *defs, ivar_t *iv) {
+  for (int r = 0; r < func->nregs; r++)
+    iv[r].block = -1;
+  for (int b = 0; b < func->nblocks; b++) {
+    if (!bit_test(body, b)) continue;
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      int v = inst->dst;
+      if (v < 0 || defs[v] != 1) continue;
+      ir_val_t step;
+      if (!linear(inst, v, defs, &step)) {
+        if (inst->op != IR_MOV || inst->a.kind != IRV_REG || defs[inst->a.val] != 1) continue;
+        int j = def_before(bb, i, inst->a.val);
+        if (j < 0 || !linear(&bb->insts[j], v, defs, &step)) continue;
+      }
+      iv[v] = (ivar_t) { .block = b, .index = i, .step = step };
+    }
+  }
+}
+
+// 找到一条可以削弱的乘法 x = y * m（m 是循环不变量），y 是基本归纳变量 v，
+// 或者在同一个基本块中刚由 v + k、v - k 算出（其间 v 不变），base 返回 v，offset 返回 y 的定值
+static bool find_mul(ir_func_t *func, unsigned *body, int *defs, ivar_t *iv, int *block, int *index,
+                     int *base, ir_inst_t *offset, ir_val_t *factor) {
+  for (int b = 0; b < func->nblocks; b++) {
+    if (!bit_test(body, b)) continue;
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->op != IR_MUL) continue;
+      for (int side = 0; side < 2; side++) {
+        ir_val_t y = side ? inst->b : inst->a, m = side ? inst->a : inst->b;
+        if (y.kind != IRV_REG || !invariant(m, defs)) continue;
+        *block = b;
+        *index = i;
+        *factor = m;
+        if (iv[y.val].block >= 0) {
+          *base = y.val;
+          offset->op = IR_NOP;
+          return true;
+        }
+        if (defs[y.val] != 1) continue;
+        int j = def_before(bb, i, y.val);
+        if (j < 0) continue;
+        ir_inst_t *d = &bb->insts[j];
+        if ((d->op != IR_ADD && d->op != IR_SUB) || d->a.kind != IRV_REG || iv[d->a.val].block < 0
+            || !invariant(d->b, defs))
+          continue;
+        int v = d->a.val;
+        if (iv[v].block == b && iv[v].index > j && iv[v].index < i) continue;
+        *base = v;
+        *offset = *d;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// 把循环中对归纳变量的乘法改为随归纳变量递增的寄存器 s：前置基本块中 s = y * m，
+// 每次 v 增加 c 之后 s 增加 c * m，乘法改为 x = s；乘法和加法都按补码回绕，结果不变
+static int reduce_loop(ir_func_t *func, unsigned *body, int pre) {
+  int reduced = 0;
+  int *defs = NULL;
+  for (;;) {
+    defs = (int *) realloc(defs, (unsigned) (func->nregs + 1) * sizeof(int));
+    count_defs(func, body, defs);
+    ivar_t *iv = (ivar_t *) malloc((unsigned) (func->nregs + 1) * sizeof(ivar_t));
+    find_ivars(func, body, defs, iv);
+    int block, index, base;
+    ir_inst_t offset;
+    ir_val_t factor;
+    if (!find_mul(func, body, defs, iv, &block, &index, &base, &offset, &factor)) {
+      free(iv);
+      break;
+    }
+    ivar_t v = iv[base];
+    free(iv);
+
+    int lineno = func->blocks[block].insts[index].lineno;
+    int s = ir_new_reg(func);
+    ir_val_t y = ir_reg(base);
+    if (offset.op != IR_NOP) {
+      ir_inst_t *add = ir_insert(func, pre, func->blocks[pre].size - 1, offset.op, lineno);
+      add->dst = ir_new_reg(func);
+      add->a = y;
+      add->b = offset.b;
+      y = ir_reg(add->dst);
+    }
+    ir_inst_t *init = ir_insert(func, pre, func->blocks[pre].size - 1, IR_MUL, lineno);
+    init->dst = s;
+    init->a = y;
+    init->b = factor;
+    // 步长和因子都是常量时直接相乘，步长为 1 时加上因子本身
+    ir_val_t inc = factor;
+    if (v.step.kind == IRV_IMM && factor.kind == IRV_IMM) {
+      inc = ir_imm(ir_eval(IR_MUL, v.step.val, factor.val));
+    } else if (v.step.kind != IRV_IMM || v.step.val != 1) {
+      ir_inst_t *mul = ir_insert(func, pre, func->blocks[pre].size - 1, IR_MUL, lineno);
+      mul->dst = ir_new_reg(func);
+      mul->a = v.step;
+      mul->b = factor;
+      inc = ir_reg(mul->dst);
+    }
+
+    ir_inst_t *mul = &func->blocks[block].insts[index];
+    mul->op = IR_MOV;
+    mul->a = ir_reg(s);
+    mul->b = ir_none();
+    ir_inst_t *step = ir_insert(func, v.block, v.index + 1, IR_ADD, func->blocks[v.block].insts[v.index].lineno);
+    step->dst = s;
+    step->a = ir_reg(s);
+    step->b = inc;
+    reduced++;
+  }
+  free(defs);
+  return reduced;
+}
+
+// 由内向外处理每个循环，返回削弱的乘法数
+int reduce_strength(ir_func_t *func) {
+  loops_t *ls = find_loops(func);
+  int reduced = 0;
+  for (int k = 0; k < ls->nloops; k++) {
+    if (ls->loops[k].header == 0) continue;
+    int pre = preheader(func, ls, k);
+    reduced += reduce_loop(func, ls->loops[k].body, pre);
+  }
+  free_loops(ls);
+  return reduced;
+}
@@ -0,0 +1,671 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ir.h>
+#include <error.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// 局部名字的种类
+#define LOCAL_SCALAR 0    // 标量，保存在虚拟寄存器 index 中
+#define LOCAL_ARRAY 1     // 局部数组，index 是局部数组下标
+#define PARAM_ARRAY 2     // 数组参数，首地址保存在虚拟寄存器 index 中
+
+// 翻译深度嵌套的函数体需要和主线程相当的栈空间
+#define WORKER_STACK_SIZE (8 << 20)
+
+typedef struct local_t {
+  char name[64];
+  int kind;
+  int index;
+  int depth;
+} local_t;
+
+// 第二步中翻译的一个函数体
+typedef struct job_t {
+  syntax_t *fun;
+  int visible;          // 在函数之前声明的全局变量数，函数只能看到这些全局变量
+  char *message;        // 并行翻译时第一个错误的信息，没有出错时为 NULL
+} job_t;
+
+typedef struct worker_t {
+  pthread_t thread;
+  void **blocks;        // -k 时工作线程分析函数体分配的节点，交给主线程
+} worker_t;
+
+int lower_threads = 1;
+bool check_bounds = false;
+
+// 第一步之后只读，第二步中各个线程只修改自己翻译的函数
+static ir_prog_t *ir;
+static THREAD_LOCAL ir_func_t *func;
+static THREAD_LOCAL int cur_block;
+
+static THREAD_LOCAL local_t *locals;
+static THREAD_LOCAL int local_cnt, local_cap, depth, nvisible;
+
+static job_t *jobs;
+static int njobs, jobs_cap, next_job, first_failed;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static THREAD_LOCAL char *captured;
+
+#define child(NODE, I) ((NODE)->symbol.child[I])
+#define size(NODE) ((NODE)->symbol.size)
+
+static ir_val_t lower_expr(syntax_t *node);
+static void lower_stmt(syntax_t *node);
+
+// 和语法错误一样通过 meow_report()/meow_fail() 报告，并行翻译时由工作线程记下
+void sem_error(int lineno, const char *cause, const char *name) {
+  meow_report(lineno, "Semantic error at line %d (%s: %s)\n", lineno, cause, name);
+  meow_fail();
+}
+
+static bool is_sym(syntax_t *node, const char *name) {
+  return node->type == SYMBOL && strcmp(node->symbol.name, name) == 0;
+}
+
+static bool is_tok(syntax_t *node, const char *name) {
+  return node->type == TOKEN && strcmp(node->token.name, name) == 0;
+}
+
+static int find_global(const char *name) {
+  for (int i = 0; i < nvisible; i++)
+    if (strcmp(ir->globals[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+static local_t *find_local(const char *name) {
+  for (int i = local_cnt - 1; i >= 0; i--)
+    if (strcmp(locals[i].name, name) == 0)
+      return &locals[i];
+  return NULL;
+}
+
+static void declare_local(syntax_t *id, int kind, int index) {
+  for (int i = local_cnt - 1; i >= 0 && locals[i].depth == depth; i--)
+    if (strcmp(locals[i].name, id->token.value) == 0)
+      sem_error(id->token.lineno, "redefinition", id->token.value);
+  if (local_cnt == local_cap) {
+    local_cap = local_cap ? 2 * local_cap : 16;
+    locals = (local_t *) realloc(locals, (unsigned) local_cap * sizeof(local_t));
+  }
+  strcpy(locals[local_cnt].name, id->token.value);
+  locals[local_cnt].kind = kind;
+  locals[local_cnt].index = index;
+  locals[local_cnt].depth = depth;
+  local_cnt++;
+}
+
+static void pop_scope(void) {
+  while (local_cnt > 0 && locals[local_cnt - 1].depth == depth)
+    local_cnt--;
+  depth--;
+}
+
+static void capture(int lineno, const char *message) {
+  (void) lineno;
+  captured = strdup(message);
+}
+
+static ir_inst_t *emit(ir_op_t op, int lineno) {
+  return ir_emit(func, cur_block, op, lineno);
+}
+
+static int parse_int(syntax_t *tok) {
+  return (int) (unsigned) strtoul(tok->token.value, NULL, 10);
+}
+
+// 收集左嵌套或平坦的 param_list/arg_list 中的各项，items 为 NULL 时只计数
+// 最内层的 list 可能被省略，直接是 param/expression 本身
+static int collect_list(syntax_t *node, const char *list, syntax_t **items) {
+  if (!is_sym(node, list)) {
+    if (items) items[0] = node;
+    return 1;
+  }
+  // 只有一项的列表和平坦的列表（-F）直接是各项本身
+  if (is_flat_list(node)) {
+    for (int i = 0; items && i < size(node); i++)
+      items[i] = child(node, i);
+    return size(node);
+  }
+  int n = collect_list(child(node, 0), list, items);
+  if (items) items[n] = child(node, 2);
+  return n + 1;
+}
+
+// 沿着 expression -> simple_expression -> ... -> factor -> var 的单产生式链
+// 找到不带下标的 var，用于识别作为实参传递的数组名
+static syntax_t *bare_var(syntax_t *node) {
+  while (node->type == SYMBOL && size(node) == 1 && !is_sym(node, "var"))
+    node = child(node, 0);
+  if (node->type == SYMBOL && is_sym(node, "var") && size(node) == 1)
+    return child(node, 0);
+  return NULL;
+}
+
+// 数组的首地址，id 不是数组时返回 IRV_NONE
+static ir_val_t array_base(syntax_t *id) {
+  local_t *local = find_local(id->token.value);
+  if (local != NULL) {
+    if (local->kind == PARAM_ARRAY)
+      return ir_reg(local->index);
+    if (local->kind == LOCAL_ARRAY) {
+      ir_inst_t *inst = emit(IR_LADDR, id->token.lineno);
+      inst->dst = ir_new_reg(func);
+      inst->sym = local->index;
+      return ir_reg(inst->dst);
+    }
+    return ir_none();
+  }
+  int g = find_global(id->token.value);
+  if (g < 0)
+    sem_error(id->token.lineno, "undeclared identifier", id->token.value);
+  if (ir->globals[g].size == 0)
+    return ir_none();
+  ir_inst_t *inst = emit(IR_GADDR, id->token.lineno);
+  inst->dst = ir_new_reg(func);
+  inst->sym = g;
+  return ir_reg(inst->dst);
+}
+
+// -check-bounds 时检查 index 是 id 的合法下标；数组参数的长度在运行时从首地址前面读取
+static void check_index(syntax_t *id, ir_val_t base, ir_val_t index) {
+  if (!check_bounds) return;
+  ir_val_t length;
+  local_t *local = find_local(id->token.value);
+  if (local != NULL && local->kind == PARAM_ARRAY) {
+    ir_inst_t *inst = emit(IR_LEN, id->token.lineno);
+    inst->dst = ir_new_reg(func);
+    inst->a = base;
+    length = ir_reg(inst->dst);
+  } else if (local != NULL) {
+    length = ir_imm(func->array_size[local->index]);
+  } else {
+    length = ir_imm(ir->globals[find_global(id->token.value)].size);
+  }
+  ir_inst_t *inst = emit(IR_CHECK, id->token.lineno);
+  inst->a = index;
+  inst->b = length;
+}
+
+static ir_val_t value_of(syntax_t *node) {
+  ir_val_t v = lower_expr(node);
+  if (v.kind == IRV_NONE)
+    sem_error(node->symbol.lineno, "void value used", node->symbol.name);
+  return v;
+}
+
+static ir_val_t lower_call(syntax_t *node) {
+  // call -> ID ( args )
+  syntax_t *id = child(node, 0), *a = child(node, 2);
+  int f = ir_find_func(ir, id->token.value);
+  if (f < 0)
+    sem_error(id->token.lineno, "undeclared function", id->token.value);
+  ir_func_t *callee = ir->funcs[f];
+
+  // args -> empty | arg_list
+  int nargs = size(a) ? collect_list(child(a, 0), "arg_list", NULL) : 0;
+  if (nargs != callee->nparams)
+    sem_error(id->token.lineno, "wrong number of arguments", id->token.value);
+  syntax_t **exprs = (syntax_t **) malloc((unsigned) (nargs + 1) * sizeof(syntax_t *));
+  if (nargs)
+    collect_list(child(a, 0), "arg_list", exprs);
+
+  ir_val_t *args = (ir_val_t *) malloc((unsigned) (nargs + 1) * sizeof(ir_val_t));
+  for (int i = 0; i < nargs; i++) {
+    syntax_t *bare = bare_var(exprs[i]);
+    ir_val_t base = bare ? array_base(bare) : ir_none();
+    if (callee->param_array[i]) {
+      if (base.kind == IRV_NONE)
+        sem_error(exprs[i]->symbol.lineno, "array expected", id->token.value);
+      args[i] = base;
+    } else {
+      if (base.kind != IRV_NONE)
+        sem_error(exprs[i]->symbol.lineno, "array used as value", bare->token.value);
+      args[i] = value_of(exprs[i]);
+    }
+  }
+  free(exprs);
+
+  ir_inst_t *inst = emit(IR_CALL, id->token.lineno);
+  inst->sym = f;
+  inst->nargs = nargs;
+  inst->args = args;
+  if (!callee->returns_value)
+    return ir_none();
+  inst->dst = ir_new_reg(func);
+  return ir_reg(inst->dst);
+}
+
+static ir_val_t lower_var_read(syntax_t *node) {
+  syntax_t *id = child(node, 0);
+  if (size(node) == 4) {
+    // var -> ID [ expression ]
+    ir_val_t base = array_base(id);
+    if (base.kind == IRV_NONE)
+      sem_error(id->token.lineno, "subscripted value is not an array", id->token.value);
+    ir_val_t index = value_of(child(node, 2));
+    check_index(id, base, index);
+    ir_inst_t *inst = emit(IR_LOAD, id->token.lineno);
+    inst->dst = ir_new_reg(func);
+    inst->a = base;
+    inst->b = index;
+    return ir_reg(inst->dst);
+  }
+  // var -> ID
+  local_t *local = find_local(id->token.value);
+  if (local != NULL) {
+    if (local->kind != LOCAL_SCALAR)
+      sem_error(id->token.lineno, "array used as value", id->token.value);
+    ir_inst_t *inst = emit(IR_MOV, id->token.lineno);
+    inst->dst = ir_new_reg(func);
+    inst->a = ir_reg(local->index);
+    return ir_reg(inst->dst);
+  }
+  int g = find_global(id->token.value);
+  if (g < 0)
+    sem_error(id->token.lineno, "undeclared identifier", id->token.value);
+  if (ir->globals[g].size)
+    sem_error(id->token.lineno, "array used as value", id->token.value);
+  ir_inst_t *inst = emit(IR_GLOAD, id->token.lineno);
+  inst->dst = ir_new_reg(func);
+  inst->sym = g;
+  return ir_reg(inst->dst);
+}
+
+static ir_val_t lower_assign(syntax_t *node) {
+  // expression -> var = expression
+  syntax_t *var = child(node, 0), *id = child(var, 0);
+  if (size(var) == 4) {
+    ir_val_t base = array_base(id);
+    if (base.kind == IRV_NONE)
+      sem_error(id->token.lineno, "subscripted value is not an array", id->token.value);
+    ir_val_t index = value_of(child(var, 2));
+    ir_val_t value = value_of(child(node, 2));
+    check_index(id, base, index);
+    ir_inst_t *inst = emit(IR_STORE, id->token.lineno);
+    inst->a = base;
+    inst->b = index;
+    inst->c = value;
+    return value;
+  }
+  ir_val_t value = value_of(child(node, 2));
+  local_t *local = find_local(id->token.value);
+  if (local != NULL) {
+    if (local->kind != LOCAL_SCALAR)
+      sem_error(id->token.lineno, "assignment to array", id->token.value);
+    ir_inst_t *inst = emit(IR_MOV, id->token.lineno);
+    inst->dst = local->index;
+    inst->a = value;
+    return value;
+  }
+  int g = find_global(id->token.value);
+  if (g < 0)
+    sem_error(id->token.lineno, "undeclared identifier", id->token.value);
+  if (ir->globals[g].size)
+    sem_error(id->token.lineno, "assignment to array", id->token.value);
+  ir_inst_t *inst = emit(IR_GSTORE, id->token.lineno);
+  inst->sym = g;
+  inst->a = value;
+  return value;
+}
+
+static ir_op_t binop(syntax_t *op) {
+  syntax_t *tok = child(op, 0);
+  if (is_tok(tok, "PLUS")) return IR_ADD;
+  if (is_tok(tok, "MINUS")) return IR_SUB;
+  if (is_tok(tok, "STAR")) return IR_MUL;
+  if (is_tok(tok, "DIV")) return IR_DIV;
+  if (is_tok(tok, "LESS")) return IR_LT;
+  if (is_tok(tok, "LEQ")) return IR_LE;
+  if (is_tok(tok, "GREAT")) return IR_GT;
+  if (is_tok(tok, "GEQ")) return IR_GE;
+  if (is_tok(tok, "EQUAL")) return IR_EQ;
+  assert(is_tok(tok, "NEQ"));
+  return IR_NE;
+}
+
+static ir_val_t lower_expr(syntax_t *node) {
+  if (is_sym(node, "expression") && size(node) == 3)
+    return lower_assign(node);
+  if (is_sym(node, "factor")) {
+    syntax_t *c = child(node, 0);
+    if (is_tok(c, "INT"))
+      return ir_imm(parse_int(c));
+    if (is_tok(c, "LP"))
+      return lower_expr(child(node, 1));
+    if (is_sym(c, "call"))
+      return lower_call(c);
+    return lower_var_read(c);
+  }
+  if (size(node) == 3) {
+    // simple_expression / additive_expression / term 的二元运算
+    ir_val_t a = value_of(child(node, 0));
+    ir_val_t b = value_of(child(node, 2));
+    ir_inst_t *inst = emit(binop(child(node, 1)), node->symbol.lineno);
+    inst->dst = ir_new_reg(func);
+    inst->a = a;
+    inst->b = b;
+    return ir_reg(inst->dst);
+  }
+  // 单产生式
+  assert(size(node) == 1);
+  return lower_expr(child(node, 0));
+}
+
+static void lower_var_declaration(syntax_t *node, bool global) {
+  // var_declaration -> type ID ; | type ID [ NUM ] ;
+  syntax_t *type = child(node, 0), *id = child(node, 1);
+  if (strcmp(type->token.value, "void") == 0)
+    sem_error(id->token.lineno, "variable declared void", id->token.value);
+  int array_size = size(node) == 6 ? parse_int(child(node, 3)) : 0;
+  if (size(node) == 6 && array_size <= 0)
+    sem_error(id->token.lineno, "bad array size", id->token.value);
+  if (global) {
+    if (find_global(id->token.value) >= 0 || ir_find_func(ir, id->token.value) >= 0)
+      sem_error(id->token.lineno, "redefinition", id->token.value);
+    int g = ir_new_global(ir, id->token.value, array_size);
+    ir->globals[g].lineno = id->token.lineno;
+    nvisible = ir->nglobals;
+  } else if (array_size) {
+    func->array_size = (int *) realloc(func->array_size, (unsigned) (func->narrays + 1) * sizeof(int));
+    func->array_size[func->narrays] = array_size;
+    declare_local(id, LOCAL_ARRAY, func->narrays++);
+  } else {
+    // 局部标量按 0 初始化，使所有执行方式的结果确定
+    int reg = ir_new_reg(func);
+    declare_local(id, LOCAL_SCALAR, reg);
+    ir_inst_t *inst = emit(IR_MOV, id->token.lineno);
+    inst->dst = reg;
+    inst->a = ir_imm(0);
+  }
+}
+
+static void lower_compound(syntax_t *node) {
+  // compound_stmt -> { local_declarations statement_list }
+  depth++;
+  list_iter_t it;
+  for (syntax_t *d = list_first(&it, child(node, 1)); d != NULL; d = list_next(&it))
+    lower_var_declaration(d, false);
+  for (syntax_t *stmt = list_first(&it, child(node, 2)); stmt != NULL; stmt = list_next(&it))
+    lower_stmt(stmt);
+  pop_scope();
+}
+
+static void lower_stmt(syntax_t *node) {
+  // statement -> xxx_stmt
+  node = child(node, 0);
+  if (is_sym(node, "expression_stmt")) {
+    if (size(node) == 2)
+      lower_expr(child(node, 0));
+  } else if (is_sym(node, "compound_stmt")) {
+    lower_compound(node);
+  } else if (is_sym(node, "selection-statement")) {
+    ir_val_t cond = value_of(child(node, 2));
+    int then_block = ir_new_block(func);
+    int else_block = size(node) == 7 ? ir_new_block(func) : -1;
+    int join_block = ir_new_block(func);
+    ir_inst_t *br = emit(IR_BR, node->symbol.lineno);
+    br->a = cond;
+    br->target[0] = then_block;
+    br->target[1] = else_block >= 0 ? else_block : join_block;
+    cur_block = then_block;
+    lower_stmt(child(node, 4));
+    emit(IR_JMP, node->symbol.lineno)->target[0] = join_block;
+    if (else_block >= 0) {
+      cur_block = else_block;
+      lower_stmt(child(node, 6));
+      emit(IR_JMP, node->symbol.lineno)->target[0] = join_block;
+    }
+    cur_block = join_block;
+  } else if (is_sym(node, "iteration_stmt")) {
+    int head_block = ir_new_block(func);
+    int body_block = ir_new_block(func);
+    int exit_block = ir_new_block(func);
+    emit(IR_JMP, node->symbol.lineno)->target[0] = head_block;
+    cur_block = head_block;
+    ir_val_t cond = value_of(child(node, 2));
+    ir_inst_t *br = emit(IR_BR, node->symbol.lineno);
+    br->a = cond;
+    br->target[0] = body_block;
+    br->target[1] = exit_block;
+    cur_block = body_block;
+    lower_stmt(child(node, 4));
+    emit(IR_JMP, node->symbol.lineno)->target[0] = head_block;
+    cur_block = exit_block;
+  } else {
+    assert(is_sym(node, "return_stmt"));
+    ir_inst_t *ret;
+    if (size(node) == 3) {
+      if (!func->returns_value)
+        sem_error(node->symbol.lineno, "return value in void function", func->name);
+      ir_val_t value = value_of(child(node, 1));
+      ret = emit(IR_RET, node->symbol.lineno);
+      ret->a = value;
+    } else {
+      if (func->returns_value)
+        sem_error(node->symbol.lineno, "missing return value", func->name);
+      ret = emit(IR_RET, node->symbol.lineno);
+    }
+    // 之后的语句不可达，但仍然需要一个基本块来容纳它们
+    cur_block = ir_new_block(func);
+  }
+}
+
+static void declare_function(syntax_t *node) {
+  // fun_declaration -> type ID ( params ) compound_stmt
+  syntax_t *type = child(node, 0), *id = child(node, 1), *ps = child(node, 3);
+  if (find_global(id->token.value) >= 0 || ir_find_func(ir, id->token.value) >= 0)
+    sem_error(id->token.lineno, "redefinition", id->token.value);
+  ir_func_t *f = ir_new_func(ir, id->token.value, id->token.lineno);
+  f->returns_value = strcmp(type->token.value, "int") == 0;
+  if (is_sym(child(ps, 0), "param_list")) {
+    syntax_t *pl = child(ps, 0);
+    int n = collect_list(pl, "param_list", NULL);
+    syntax_t **params = (syntax_t **) malloc((unsigned) n * sizeof(syntax_t *));
+    collect_list(pl, "param_list", params);
+    f->nparams = n;
+    f->param_array = (bool *) calloc((unsigned) n, sizeof(bool));
+    for (int i = 0; i < n; i++) {
+      // param -> type ID | type ID [ ]
+      if (strcmp(child(params[i], 0)->token.value, "void") == 0)
+        sem_error(child(params[i], 1)->token.lineno, "parameter declared void", child(params[i], 1)->token.value);
+      f->param_array[i] = size(params[i]) == 4;
+    }
+    free(params);
+  }
+  f->nregs = f->nparams;
+}
+
+static void lower_function(syntax_t *node) {
+  syntax_t *id = child(node, 1), *ps = child(node, 3);
+  func = ir->funcs[ir_find_func(ir, id->token.value)];
+  cur_block = ir_new_block(func);
+
+  depth++;
+  if (func->nparams) {
+    syntax_t **params = (syntax_t **) malloc((unsigned) func->nparams * sizeof(syntax_t *));
+    collect_list(child(ps, 0), "param_list", params);
+    for (int i = 0; i < func->nparams; i++)
+      declare_local(child(params[i], 1), func->param_array[i] ? PARAM_ARRAY : LOCAL_SCALAR, i);
+    free(params);
+  }
+  lower_compound(function_body(node));
+  pop_scope();
+
+  // 落到函数末尾时隐式返回
+  ir_inst_t *ret = emit(IR_RET, node->symbol.lineno);
+  if (func->returns_value)
+    ret->a = ir_imm(0);
+}
+
+// 登记所有函数的签名，使函数可以互相递归调用；globals 时同时登记全局变量
+static void declare_unit(syntax_t *prog, bool globals) {
+  list_iter_t it;
+  for (syntax_t *d = list_first(&it, child(prog, 0)); d != NULL; d = list_next(&it)) {
+    syntax_t *dec = child(d, 0);
+    if (is_sym(dec, "fun_declaration"))
+      declare_function(dec);
+    else if (globals)
+      lower_var_declaration(dec, true);
+  }
+}
+
+// 收集要翻译的函数体；globals 时按原来的顺序登记全局变量，使全局变量先声明后使用。
+// 全局变量的错误记在 *pending 中并停止收集，在它之前的函数体中的错误先报告
+static void collect_unit(syntax_t *prog, bool globals, char **pending) {
+  jmp_buf env, *saved_handler = error_handler;
+  void (*saved_diag)(int, const char *) = diag_handler;
+  error_handler = &env;
+  diag_handler = capture;
+  if (setjmp(env) == 0) {
+    list_iter_t it;
+    for (syntax_t *d = list_first(&it, child(prog, 0)); d != NULL; d = list_next(&it)) {
+      syntax_t *dec = child(d, 0);
+      if (is_sym(dec, "fun_declaration")) {
+        if (njobs == jobs_cap) {
+          jobs_cap = jobs_cap ? 2 * jobs_cap : 64;
+          jobs = (job_t *) realloc(jobs, (unsigned) jobs_cap * sizeof(job_t));
+        }
+        jobs[njobs++] = (job_t) {.fun = dec, .visible = nvisible};
+      } else if (globals) {
+        lower_var_declaration(dec, true);
+      }
+    }
+  } else {
+    *pending = captured;
+  }
+  error_handler = saved_handler;
+  diag_handler = saved_diag;
+}
+
+static void lower_job(job_t *job) {
+  local_cnt = depth = 0;
+  nvisible = job->visible;
+  lower_function(job->fun);
+}
+
+// 领取下一个函数体，出错的函数之后的不必再翻译
+static int take(void) {
+  pthread_mutex_lock(&lock);
+  int i = next_job < njobs && next_job < first_failed ? next_job++ : -1;
+  pthread_mutex_unlock(&lock);
+  return i;
+}
+
+static void *work(void *arg) {
+  worker_t *w = (worker_t *) arg;
+  jmp_buf env;
+  error_handler = &env;
+  diag_handler = capture;
+  int i;
+  while ((i = take()) >= 0) {
+    if (setjmp(env) == 0) {
+      lower_job(&jobs[i]);
+    } else {
+      jobs[i].message = captured;
+      pthread_mutex_lock(&lock);
+      if (i < first_failed) first_failed = i;
+      pthread_mutex_unlock(&lock);
+    }
+  }
+  free(locals);
+  locals = NULL;
+  local_cap = 0;
+  w->blocks = parser_detach();
+  return NULL;
+}
+
+// 第二步：各个函数体互不依赖，全局的表只读。多个线程时每个函数体的第一个错误先记下，
+// 最后报告源程序中最靠前的一个，和顺序翻译相同
+static void lower_jobs(void) {
+  int nthreads = lower_threads > 0 ? lower_threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads > njobs) nthreads = njobs;
+  if (nthreads <= 1) {
+    for (int i = 0; i < njobs; i++)
+      lower_job(&jobs[i]);
+    return;
+  }
+  next_job = 0;
+  first_failed = njobs;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+  worker_t *workers = (worker_t *) calloc((unsigned) nthreads, sizeof(worker_t));
+  int started = 0;
+  while (started < nthreads && pthread_create(&workers[started].thread, &attr, work, &workers[started]) == 0)
+    started++;
+  pthread_attr_destroy(&attr);
+  for (int t = 0; t < started; t++)
+    pthread_join(workers[t].thread, NULL);
+  // 一个线程也没能启动时由主线程自己翻译
+  if (started == 0) {
+    for (int i = 0; i < njobs; i++)
+      lower_job(&jobs[i]);
+  }
+  for (int t = 0; t < started; t++)
+    parser_adopt(workers[t].blocks);
+  free(workers);
+  if (first_failed < njobs) {
+    fputs(jobs[first_failed].message, stderr);
+    exit(-1);
+  }
+}
+
+// 把另一个源文件的接口作为外部声明加入程序
+static void import_interface(ir_prog_t *from) {
+  for (int g = 0; g < from->nglobals; g++) {
+    ir_global_t *src = &from->globals[g];
+    if (find_global(src->name) >= 0 || ir_find_func(ir, src->name) >= 0)
+      sem_error(src->lineno, "redefinition", src->name);
+    int i = ir_new_global(ir, src->name, src->size);
+    ir->globals[i].lineno = src->lineno;
+    ir->globals[i].external = true;
+    nvisible = ir->nglobals;
+  }
+  for (int f = 0; f < from->nfuncs; f++) {
+    ir_func_t *src = from->funcs[f];
+    if (src->builtin) continue;
+    if (find_global(src->name) >= 0 || ir_find_func(ir, src->name) >= 0)
+      sem_error(src->lineno, "redefinition", src->name);
+    ir_func_t *dst = ir_new_func(ir, src->name, src->lineno);
+    dst->external = true;
+    dst->returns_value = src->returns_value;
+    dst->nparams = dst->nregs = src->nparams;
+    dst->param_array = (bool *) calloc((unsigned) src->nparams + 1, sizeof(bool));
+    memcpy(dst->param_array, src->param_array, (unsigned) src->nparams * sizeof(bool));
+  }
+}
+
+ir_prog_t *lower_program(syntax_t *prog) {
+  return lower_units(&prog, 1, NULL, 0);
+}
+
+ir_prog_t *lower_interface(syntax_t *prog) {
+  ir = ir_new_prog();
+  declare_unit(prog, true);
+  return ir;
+}
+
+ir_prog_t *lower_units(syntax_t **progs, int n, ir_prog_t **imports, int nimports) {
+  ir = ir_new_prog();
+  local_cnt = depth = nvisible = 0;
+  for (int i = 0; i < nimports; i++)
+    import_interface(imports[i]);
+  // 第一步：顺序登记所有函数的签名和全局变量
+  for (int i = 0; i < n; i++)
+    declare_unit(progs[i], n > 1);
+  char *pending = NULL;
+  njobs = 0;
+  for (int i = 0; i < n && pending == NULL; i++)
+    collect_unit(progs[i], n == 1, &pending);
+  lower_jobs();
+  free(jobs);
+  jobs = NULL;
+  jobs_cap = 0;
+  if (pending != NULL) {
+    fputs(pending, stderr);
+    exit(-1);
+  }
+  return ir;
+}
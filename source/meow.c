@@ -1,23 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
 #include <basics.h>
 #include <lexer.h>
 #include <syntax.h>
+#include <ir.h>
+#include <optim.h>
+#include <interp.h>
+#include <x86.h>
+#include <jit.h>
+#include <meowbin.h>
+#include <parallel.h>
+#include <module.h>
+#include <pipeline.h>
+#include <emitc.h>
+#include <profile.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
 
 FILE *source_fp;
 int indent = 0;
 bool lexer_only = false, exp_only = false;
 bool debug_lexicon = false;
-token_t **token_list;
-int token_cnt;
-extern int current_token_cnt;
+bool ir_only = false, run_program = false, show_stats = false;
+bool emit_asm = false, jit_program = false, emit_c_source = false;
+bool binary_output = false;
+int opt_level = 0;
+int parse_threads = 1;
+bool pipeline_lexing = false;
+bool stream_output = false;
+const char **module_paths = NULL;
+int nmodules = 0;
+
+static struct option long_options[] = {
+  {"jit", no_argument, NULL, 'j'},
+  {"emit-c", no_argument, NULL, 'C'},
+  {"plain-interp", no_argument, NULL, 'I'},
+  {"dump-inline", no_argument, NULL, 'D'},
+  {"no-inline", no_argument, NULL, 'N'},
+  {"nested", no_argument, NULL, 'n'},
+  {"no-loop-opt", no_argument, NULL, 'L'},
+  {"profile", required_argument, NULL, 'R'},
+  {"profile-stacks", required_argument, NULL, 'T'},
+  {"ast", no_argument, NULL, 'A'},
+  {"check-bounds", no_argument, NULL, 'B'},
+  {"no-bounds-opt", no_argument, NULL, 'X'},
+  {"no-gvn", no_argument, NULL, 'G'},
+  {"verify-ssa", no_argument, NULL, 'V'},
+  {"stream", no_argument, NULL, 'W'},
+  {"max-depth", required_argument, NULL, 'M'},
+  {NULL, 0, NULL, 0}
+};
+
+static double ms_since(struct timespec *start, struct timespec *now) {
+  return (double) (now->tv_sec - start->tv_sec) * 1e3 + (double) (now->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// 语法分析的节点数和用时，以及从词法分析开始的总用时（墙上时间，并行分析时不累加各个线程）
+static void report_parse(struct timespec *lex_start, struct timespec *start) {
+  if (show_stats) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(stderr, "parse: %d tokens, %lld nodes, %.1f KB, %.1f ms, %.1f ms with lexing\n", token_cnt, parse_steps,
+            (double) share_stats.bytes / 1024, ms_since(start, &now), ms_since(lex_start, &now));
+    // -stream 时语法分析已经打印并释放了各个声明，峰值只包含最大的一个声明
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "memory: peak RSS %ld KB\n", usage.ru_maxrss);
+    if (share_subtrees) {
+      fprintf(stderr, "share: %lld of %lld nodes shared (%.1f%%), %.1f KB -> %.1f KB, table %.1f KB\n",
+              share_stats.shared_nodes, parse_steps, 100.0 * (double) share_stats.shared_nodes / (double) (parse_steps ? parse_steps : 1),
+              (double) share_stats.bytes / 1024, (double) (share_stats.bytes - share_stats.shared_bytes) / 1024,
+              (double) share_stats.table_bytes / 1024);
+    }
+  }
+}
+
+// -stream 时 declaration_list 每分析完一个声明就打印它
+static void print_streamed(syntax_t *dec, int k) {
+  print_declaration(dec, k, indent);
+}
 
 int main(int argc, char *argv[]){
   int opt;
-  while ((opt = getopt(argc, argv, "dhlei:")) != -1) {
+  while ((opt = getopt_long_only(argc, argv, "dhlei:O:trsSbcFHPp:km:", long_options, NULL)) != -1) {
     switch (opt)
     {
       case 'h': {
-        printf("Usage: %s [OPTIONS] SOURCE\nOptions: hlei:" , argv[0]);
+        printf("Usage: %s [OPTIONS] SOURCE\nOptions: hlei:O:trsSbcFHPp:km:, -jit, -emit-c, -plain-interp, -dump-inline, -no-inline, -no-loop-opt, -check-bounds, -no-bounds-opt, -no-gvn, -verify-ssa, -nested, -stream, -ast, -max-depth N, -profile FILE, -profile-stacks FILE" , argv[0]);
         break;
       }
       case 'l': {
@@ -36,8 +105,129 @@ int main(int argc, char *argv[]){
         indent = atoi(optarg);
         break;
       }
+      case 'O': {
+        opt_level = atoi(optarg);
+        break;
+      }
+      case 't': {
+        ir_only = true;
+        break;
+      }
+      case 'r': {
+        run_program = true;
+        break;
+      }
+      case 's': {
+        show_stats = true;
+        break;
+      }
+      case 'S': {
+        emit_asm = true;
+        break;
+      }
+      case 'b': {
+        binary_output = true;
+        break;
+      }
+      case 'c': {
+        compact_expr = true;
+        break;
+      }
+      case 'F': {
+        flat_lists = true;
+        break;
+      }
+      case 'n': {
+        print_nested = true;
+        break;
+      }
+      case 'H': {
+        share_subtrees = true;
+        break;
+      }
+      case 'P': {
+        pipeline_lexing = true;
+        break;
+      }
+      case 'k': {
+        skeleton_bodies = true;
+        break;
+      }
+      case 'm': {
+        module_paths = (const char **) realloc(module_paths, (unsigned) (nmodules + 1) * sizeof(const char *));
+        module_paths[nmodules++] = optarg;
+        break;
+      }
+      case 'p': {
+        parse_threads = atoi(optarg);
+        break;
+      }
+      case 'j': {
+        jit_program = true;
+        break;
+      }
+      case 'C': {
+        emit_c_source = true;
+        break;
+      }
+      case 'I': {
+        interp_plain = true;
+        break;
+      }
+      case 'D': {
+        inline_dump = true;
+        break;
+      }
+      case 'N': {
+        inline_off = true;
+        break;
+      }
+      case 'L': {
+        loop_off = true;
+        break;
+      }
+      case 'R': {
+        profile_report_path = optarg;
+        break;
+      }
+      case 'T': {
+        profile_stacks_path = optarg;
+        break;
+      }
+      case 'A': {
+        abstract_syntax = true;
+        break;
+      }
+      case 'B': {
+        check_bounds = true;
+        break;
+      }
+      case 'X': {
+        bounds_off = true;
+        break;
+      }
+      case 'G': {
+        gvn_off = true;
+        break;
+      }
+      case 'V': {
+        ssa_verify = true;
+        break;
+      }
+      case 'W': {
+        stream_output = true;
+        break;
+      }
+      case 'M': {
+        max_depth = atoi(optarg);
+        if (max_depth < 1) {
+          fprintf(stderr, "-max-depth must be at least 1 (main itself)\n");
+          exit(-1);
+        }
+        break;
+      }
       default: {
-        fprintf(stderr, "Usage: %s [OPTIONS] SOURCE\nOptions: hlei:" , argv[0]);
+        fprintf(stderr, "Usage: %s [OPTIONS] SOURCE\nOptions: hlei:O:trsSbcFHPp:km:, -jit, -emit-c, -plain-interp, -dump-inline, -no-inline, -no-loop-opt, -check-bounds, -no-bounds-opt, -no-gvn, -verify-ssa, -nested, -stream, -ast, -max-depth N, -profile FILE, -profile-stacks FILE" , argv[0]);
         exit(-1);
       }
     }
@@ -46,6 +236,30 @@ int main(int argc, char *argv[]){
     fprintf(stderr, "missing source file\n");
     exit(-1);
   }
+  // 只有翻译为中间代码时才需要模块的接口，运行程序时还需要模块的函数体
+  bool lowering = !lexer_only && !exp_only && (ir_only || run_program || emit_asm || jit_program || emit_c_source);
+  bool linking = run_program || jit_program;
+  if (abstract_syntax && (lowering || binary_output)) {
+    fprintf(stderr, "-ast only prints the tree, lowering and binary output need the full parse tree\n");
+    exit(-1);
+  }
+  // 共用的节点保留第一次出现时的行号，语义错误和运行时错误会报告错误的行
+  if (share_subtrees && lowering) {
+    fprintf(stderr, "-H keeps the line of the first occurrence of a shared subtree, lowering needs the line of every node\n");
+    exit(-1);
+  }
+  if (stream_output && (lowering || binary_output || lexer_only || exp_only || debug_lexicon || share_subtrees || pipeline_lexing || parse_threads != 1)) {
+    fprintf(stderr, "-stream only prints the tree of a whole program, parsed sequentially on one thread without -H\n");
+    exit(-1);
+  }
+  module_t **modules = (module_t **) malloc((unsigned) (nmodules + 1) * sizeof(module_t *));
+  for (int i = 0; i < nmodules && lowering; i++) {
+    modules[i] = module_load(module_paths[i], linking);
+    if (show_stats) {
+      fprintf(stderr, "module %s: interface %s\n", module_paths[i], modules[i]->cached ? "cached" : "rebuilt");
+    }
+  }
+
   source_fp = fopen(argv[optind], "r");
   if (source_fp == NULL) {
     fprintf(stderr, "open source file failed\n");
@@ -53,23 +267,23 @@ int main(int argc, char *argv[]){
   }
   
   int line_number = 1, max_token_cnt = 1048576;
-  token_list = (token_t **) malloc((unsigned) max_token_cnt * sizeof(token_t *));
+  token_list = (token_t **) malloc((unsigned) (max_token_cnt + 1) * sizeof(token_t *));
 
-  token_t *now_token;
-  while ((now_token = getToken(source_fp, &line_number)) != NULL) {
-    if (strcmp(now_token->name, "EXCEPTION") == 0) {
-      fprintf(stderr, "lexical error at line %d, type %s\n", now_token->lineno, now_token->value);
-      exit(-1);
-    }
-    if (token_cnt >= max_token_cnt) {
-      fprintf(stderr, "LEXER_PANIC: too many tokens");
-      exit(-1);
-    }
-    token_list[token_cnt++] = now_token;
-    // printf("Token {name: %s, line: %d, value: %s}\n", now_token->name, now_token->lineno, now_token->value);
+  // -P 时词法分析在单独的线程中进行，语法分析同时开始；需要先输出词法单元时没有可以重叠的工作
+  bool pipelined = pipeline_lexing && !lexer_only && !debug_lexicon;
+  struct timespec lex_start;
+  clock_gettime(CLOCK_MONOTONIC, &lex_start);
+  if (stream_output) {
+    pipeline_start_on_demand(source_fp, max_token_cnt);
+  } else if (pipelined) {
+    pipeline_start(source_fp, max_token_cnt);
+  } else {
+    token_cnt = lex_tokens(source_fp, max_token_cnt, &line_number, false);
   }
   
-  if (lexer_only || debug_lexicon) {
+  if (lexer_only && binary_output) {
+    meowbin_write_tokens(stdout, token_list, token_cnt);
+  } else if (lexer_only || debug_lexicon) {
     for (int i = 0; i < token_cnt; i++) {
       token_t *now_tok = token_list[i];
       printf("Token {name: %s, line: %d, value: %s}\n", now_tok->name, now_tok->lineno, now_tok->value);
@@ -77,26 +291,120 @@ int main(int argc, char *argv[]){
   }
 
   if (!lexer_only) {
-    token_list[token_cnt] = (token_t *) malloc(sizeof(token_t));
-    *token_list[token_cnt] = (token_t) {
-      .lineno = line_number,
-      .name = "EOT",
-      .value = "EOT"
-    };
+    if (!pipelined && !stream_output) {
+      token_list[token_cnt] = (token_t *) malloc(sizeof(token_t));
+      *token_list[token_cnt] = (token_t) {
+        .lineno = line_number,
+        .name = "EOT",
+        .value = "EOT"
+      };
+    }
+    struct timespec parse_start;
+    clock_gettime(CLOCK_MONOTONIC, &parse_start);
     if (exp_only) {
       syntax_t *expr = expression(true);
+      if (pipelined) pipeline_finish();
       if (token_cnt != current_token_cnt) {
         fprintf(stderr, "SYNTATIC PANIC: EXTRA TOKENS\n");
         exit(-1);
       }
-      print_syntax_tree(expr, indent);
+      report_parse(&lex_start, &parse_start);
+      if (binary_output) {
+        meowbin_write_tree(stdout, expr);
+      } else if (abstract_syntax) {
+        print_ast(expr, indent);
+      } else {
+        print_syntax_tree(expr, indent);
+      }
     } else {
-      syntax_t *prog = program(true);
+      // 并行分析先要切分完整的词法单元序列
+      if (pipelined && parse_threads != 1) pipeline_finish();
+      if (stream_output) declaration_sink = print_streamed;
+      syntax_t *prog = parse_threads == 1 ? program(true) : parallel_program(parse_threads);
+      if (pipelined || stream_output) pipeline_finish();
       if (token_cnt != current_token_cnt) {
         fprintf(stderr, "SYNTATIC PANIC: EXTRA TOKENS\n");
         exit(-1);
       }
-      print_syntax_tree(prog, indent);
+      report_parse(&lex_start, &parse_start);
+      if (ir_only || run_program || emit_asm || jit_program || emit_c_source) {
+        ir_prog_t *ir;
+        struct timespec lower_start, lower_end;
+        clock_gettime(CLOCK_MONOTONIC, &lower_start);
+        lower_threads = parse_threads;
+        if (nmodules == 0) {
+          ir = lower_program(prog);
+        } else if (linking) {
+          syntax_t **units = (syntax_t **) malloc((unsigned) (nmodules + 1) * sizeof(syntax_t *));
+          units[0] = prog;
+          for (int i = 0; i < nmodules; i++) units[i + 1] = modules[i]->prog;
+          ir = lower_units(units, nmodules + 1, NULL, 0);
+        } else {
+          ir_prog_t **imports = (ir_prog_t **) malloc((unsigned) nmodules * sizeof(ir_prog_t *));
+          for (int i = 0; i < nmodules; i++) imports[i] = modules[i]->iface;
+          ir = lower_units(&prog, 1, imports, nmodules);
+        }
+        if (show_stats) {
+          clock_gettime(CLOCK_MONOTONIC, &lower_end);
+          fprintf(stderr, "lower: %d functions, %.1f ms\n", ir->nfuncs, ms_since(&lower_start, &lower_end));
+        }
+        // 语义错误已经在翻译三地址码时报告，C 代码直接由语法分析树生成，由 C 编译器优化
+        if (emit_c_source) {
+          emit_c(ir, prog, argv[optind]);
+        }
+        optimize(ir, opt_level, show_stats);
+        if (ir_only) {
+          print_ir(ir);
+        }
+        if (emit_asm) {
+          // -O0 时所有值都放在栈上，-O1 起做线性扫描寄存器分配
+          x86_func_t **funcs = (x86_func_t **) calloc((unsigned) ir->nfuncs, sizeof(x86_func_t *));
+          int nregs = 0, nspilled = 0;
+          for (int f = 0; f < ir->nfuncs; f++) {
+            if (ir->funcs[f]->builtin || ir->funcs[f]->external) continue;
+            funcs[f] = x86_select(ir, f, opt_level >= 1);
+            nregs += funcs[f]->ra->nregs;
+            nspilled += funcs[f]->ra->nspilled;
+          }
+          x86_print(ir, funcs);
+          if (show_stats) {
+            fprintf(stderr, "native: %d virtual registers, %d spilled, %d x86 instructions, %d tail calls\n", nregs, nspilled, x86_prog_size(ir, funcs),
+                    x86_tail_calls);
+          }
+        }
+        // 剖析只在解释执行时进行
+        if (jit_program && profile_report_path == NULL && profile_stacks_path == NULL) {
+          int ret;
+          if (jit_run(ir, opt_level >= 1, show_stats, &ret)) {
+            return ret;
+          }
+          if (show_stats) {
+            fprintf(stderr, "jit: cannot compile, falling back to the interpreter\n");
+          }
+        }
+        if (run_program || jit_program) {
+          int ret = interp_run(ir);
+          if (show_stats) {
+            fprintf(stderr, "executed %lld instructions\n", interp_steps);
+            fprintf(stderr, "dispatch: %lld dispatches", interp_dispatches);
+            if (interp_iterations) {
+              fprintf(stderr, ", %lld loop iterations (%.1f dispatches each)", interp_iterations,
+                      (double) interp_dispatches / (double) interp_iterations);
+            }
+            fprintf(stderr, ", %d superinstructions, %d quickened\n", interp_fused, interp_quickened);
+            fprintf(stderr, "calls: %lld calls, %lld tail calls, max depth %d\n", interp_calls, interp_tail_calls, interp_max_depth);
+          }
+          return ret;
+        }
+      } else if (stream_output) {
+        // 各个声明已经在分析时打印
+      } else if (binary_output) {
+        meowbin_write_tree(stdout, prog);
+      } else if (abstract_syntax) {
+        print_ast(prog, indent);
+      } else {
+        print_syntax_tree(prog, indent);
+      }
     }
   }
   return 0;
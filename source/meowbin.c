@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+#include <meowbin.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 读者只依赖这个头文件，可以单独编译进其他工具
+
+static int fail(const char **error, const char *reason) {
+  if (error != NULL) *error = reason;
+  return -1;
+}
+
+static int in_bounds(const meowbin_t *bin, uint32_t off, uint64_t size) {
+  return off % 4 == 0 && (uint64_t) off + size <= bin->size;
+}
+
+int meowbin_load(meowbin_t *bin, const void *data, size_t size, const char **error) {
+  const uint16_t one = 1;
+  if (*(const unsigned char *) &one != 1)
+    return fail(error, "big-endian hosts are not supported");
+  bin->base = (const unsigned char *) data;
+  bin->size = size;
+  bin->mapped = 0;
+  if (size < sizeof(meowbin_header_t) || (size_t) data % 4 != 0)
+    return fail(error, "truncated header");
+  const meowbin_header_t *h = bin->header = (const meowbin_header_t *) data;
+  if (memcmp(h->magic, MEOWBIN_MAGIC, 4) != 0)
+    return fail(error, "bad magic");
+  if (h->version != MEOWBIN_VERSION)
+    return fail(error, "unsupported version");
+  if (h->kind != MEOWBIN_TOKENS && h->kind != MEOWBIN_TREE)
+    return fail(error, "unknown kind");
+
+  uint64_t record_size = h->kind == MEOWBIN_TOKENS ? sizeof(meowbin_token_t) : sizeof(meowbin_node_t);
+  uint64_t ncheckpoints = (h->nrecords + (uint64_t) MEOWBIN_CHECKPOINT - 1) / MEOWBIN_CHECKPOINT;
+  if (!in_bounds(bin, h->records_off, record_size * h->nrecords)
+      || !in_bounds(bin, h->strings_off, 4 * (uint64_t) h->nstrings)
+      || !in_bounds(bin, h->blob_off, h->blob_size)
+      || !in_bounds(bin, h->lines_off, h->lines_size)
+      || !in_bounds(bin, h->checkpoints_off, sizeof(meowbin_checkpoint_t) * ncheckpoints))
+    return fail(error, "section out of bounds");
+  if (h->nstrings && (h->blob_size == 0 || bin->base[h->blob_off + h->blob_size - 1] != '\0'))
+    return fail(error, "unterminated string table");
+  if (h->kind == MEOWBIN_TREE && h->nrecords && h->root >= h->nrecords)
+    return fail(error, "bad root");
+
+  bin->strings = (const uint32_t *) (bin->base + h->strings_off);
+  bin->blob = (const char *) (bin->base + h->blob_off);
+  bin->records = bin->base + h->records_off;
+  bin->lines = bin->base + h->lines_off;
+  bin->checkpoints = (const meowbin_checkpoint_t *) (bin->base + h->checkpoints_off);
+  return 0;
+}
+
+int meowbin_open(meowbin_t *bin, const char *path, const char **error) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return fail(error, "cannot open file");
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return fail(error, "truncated header");
+  }
+  void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return fail(error, "cannot map file");
+  if (meowbin_load(bin, data, (size_t) st.st_size, error) != 0) {
+    munmap(data, (size_t) st.st_size);
+    return -1;
+  }
+  bin->mapped = 1;
+  return 0;
+}
+
+void meowbin_close(meowbin_t *bin) {
+  if (bin->mapped) munmap((void *) bin->base, bin->size);
+  memset(bin, 0, sizeof(meowbin_t));
+}
+
+uint32_t meowbin_count(const meowbin_t *bin) {
+  return bin->header->nrecords;
+}
+
+const char *meowbin_string(const meowbin_t *bin, uint32_t index) {
+  if (index >= bin->header->nstrings || bin->strings[index] >= bin->header->blob_size) return NULL;
+  return bin->blob + bin->strings[index];
+}
+
+const meowbin_token_t *meowbin_token(const meowbin_t *bin, uint32_t index) {
+  if (bin->header->kind != MEOWBIN_TOKENS || index >= bin->header->nrecords) return NULL;
+  return (const meowbin_token_t *) bin->records + index;
+}
+
+const meowbin_node_t *meowbin_node(const meowbin_t *bin, uint32_t index) {
+  if (bin->header->kind != MEOWBIN_TREE || index >= bin->header->nrecords) return NULL;
+  const meowbin_node_t *node = (const meowbin_node_t *) bin->records + index;
+  if (node->count && ((uint64_t) node->first + node->count > bin->header->nrecords)) return NULL;
+  return node;
+}
+
+// 解码一个 zigzag varint，越过行号段末尾时返回 0
+static long next_delta(const unsigned char **p, const unsigned char *end) {
+  unsigned long z = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7) {
+    unsigned char c = *(*p)++;
+    z |= (unsigned long) (c & 0x7f) << shift;
+    if (!(c & 0x80)) break;
+  }
+  return z & 1 ? -(long) (z >> 1) - 1 : (long) (z >> 1);
+}
+
+long meowbin_line(const meowbin_t *bin, uint32_t index) {
+  if (index >= bin->header->nrecords) return -1;
+  const meowbin_checkpoint_t *cp = &bin->checkpoints[index / MEOWBIN_CHECKPOINT];
+  if (cp->offset >= bin->header->lines_size) return -1;
+  const unsigned char *p = bin->lines + cp->offset, *end = bin->lines + bin->header->lines_size;
+  long line = cp->line;
+  next_delta(&p, end);
+  for (uint32_t i = index / MEOWBIN_CHECKPOINT * MEOWBIN_CHECKPOINT; i < index; i++)
+    line += next_delta(&p, end);
+  return line;
+}
+
+void meowbin_lines_begin(const meowbin_t *bin, meowbin_lines_t *it) {
+  it->p = bin->lines;
+  it->end = bin->lines + bin->header->lines_size;
+  it->line = 0;
+}
+
+long meowbin_lines_next(meowbin_lines_t *it) {
+  return it->line += next_delta(&it->p, it->end);
+}
+
+static const char *str_or_empty(const meowbin_t *bin, uint32_t index) {
+  const char *s = meowbin_string(bin, index);
+  return s ? s : "";
+}
+
+void meowbin_print_tokens(const meowbin_t *bin, FILE *out) {
+  meowbin_lines_t it;
+  meowbin_lines_begin(bin, &it);
+  for (uint32_t i = 0; i < meowbin_count(bin); i++) {
+    const meowbin_token_t *tok = meowbin_token(bin, i);
+    long line = meowbin_lines_next(&it);
+    if (tok == NULL) return;
+    fprintf(out, "Token {name: %s, line: %ld, value: %s}\n", str_or_empty(bin, tok->name), line, str_or_empty(bin, tok->value));
+  }
+}
+
+static void print_node(const meowbin_t *bin, uint32_t index, int indent, FILE *out) {
+  const meowbin_node_t *node = meowbin_node(bin, index);
+  if (node == NULL) return;
+  for (int i = 0; i < indent; i++) fprintf(out, "  ");
+  if (node->value != MEOWBIN_NONE) {
+    fprintf(out, "%s: %s\n", str_or_empty(bin, node->name), str_or_empty(bin, node->value));
+    return;
+  }
+  fprintf(out, "%s (%ld)\n", str_or_empty(bin, node->name), meowbin_line(bin, index));
+  // 子节点总在父节点之后，损坏的文件也不会无限递归
+  for (uint32_t k = 0; k < node->count; k++)
+    if (node->first + k > index)
+      print_node(bin, node->first + k, indent + 1, out);
+}
+
+void meowbin_print_tree(const meowbin_t *bin, int indent, FILE *out) {
+  if (meowbin_count(bin) > 0)
+    print_node(bin, bin->header->root, indent, out);
+}
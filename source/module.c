@@ -0,0 +1,170 @@
+#include <module.h>
+#include <lexer.h>
+#include <error.h>
+
+// 接口摘要的格式，每行一项：
+//   meowcmi 版本 源文件内容的哈希
+//   g 名字 数组长度 行号
+//   f 名字 i|v 行号 参数（s 为标量，a 为数组，没有参数时为 -）
+#define SUMMARY_MAGIC "meowcmi"
+#define SUMMARY_VERSION 1
+
+// FNV-1a
+static unsigned long long content_hash(const char *buf, size_t size) {
+  unsigned long long h = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    h ^= (unsigned char) buf[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+static char *summary_path(const char *path) {
+  size_t len = strlen(path);
+  char *ret = (char *) malloc(len + 6);
+  strcpy(ret, path);
+  if (len > 3 && strcmp(path + len - 3, ".cm") == 0) strcat(ret, "i");
+  else strcat(ret, ".cmi");
+  return ret;
+}
+
+// 摘要不存在、格式不对或者哈希不一致时返回 NULL
+static ir_prog_t *read_summary(const char *path, unsigned long long hash) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) return NULL;
+  char magic[16];
+  int version;
+  unsigned long long stored;
+  if (fscanf(fp, "%15s %d %llx", magic, &version, &stored) != 3 || strcmp(magic, SUMMARY_MAGIC) != 0
+      || version != SUMMARY_VERSION || stored != hash) {
+    fclose(fp);
+    return NULL;
+  }
+  ir_prog_t *iface = ir_new_prog();
+  char kind[2], name[64], ret[2], params[256];
+  int size, lineno;
+  bool ok = true;
+  while (ok && fscanf(fp, "%1s %63s", kind, name) == 2) {
+    if (kind[0] == 'g') {
+      ok = fscanf(fp, "%d %d", &size, &lineno) == 2;
+      if (!ok) break;
+      int g = ir_new_global(iface, name, size);
+      iface->globals[g].lineno = lineno;
+    } else if (kind[0] == 'f') {
+      ok = fscanf(fp, "%1s %d %255s", ret, &lineno, params) == 3;
+      if (!ok) break;
+      ir_func_t *f = ir_new_func(iface, name, lineno);
+      f->returns_value = ret[0] == 'i';
+      f->nparams = f->nregs = strcmp(params, "-") == 0 ? 0 : (int) strlen(params);
+      f->param_array = (bool *) calloc((unsigned) f->nparams + 1, sizeof(bool));
+      for (int i = 0; i < f->nparams; i++)
+        f->param_array[i] = params[i] == 'a';
+    } else {
+      ok = false;
+    }
+  }
+  ok = ok && feof(fp);
+  fclose(fp);
+  // 损坏的摘要当作不存在，重新分析模块
+  return ok ? iface : NULL;
+}
+
+// 写不出摘要时不报错，下次重新分析模块
+static void write_summary(const char *path, unsigned long long hash, ir_prog_t *iface) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) return;
+  fprintf(fp, "%s %d %016llx\n", SUMMARY_MAGIC, SUMMARY_VERSION, hash);
+  for (int g = 0; g < iface->nglobals; g++)
+    fprintf(fp, "g %s %d %d\n", iface->globals[g].name, iface->globals[g].size, iface->globals[g].lineno);
+  for (int f = 0; f < iface->nfuncs; f++) {
+    ir_func_t *func = iface->funcs[f];
+    if (func->builtin) continue;
+    fprintf(fp, "f %s %c %d ", func->name, func->returns_value ? 'i' : 'v', func->lineno);
+    for (int i = 0; i < func->nparams; i++)
+      fputc(func->param_array[i] ? 'a' : 's', fp);
+    fprintf(fp, "%s\n", func->nparams ? "" : "-");
+  }
+  fclose(fp);
+}
+
+// 和 SOURCE 一样做词法分析和语法分析，skeleton 时不分析函数体；
+// 分析器的状态在返回前复位，不影响之后对 SOURCE 的分析
+static syntax_t *parse_module(FILE *fp, bool skeleton) {
+  token_t **saved_list = token_list;
+  int saved_cnt = token_cnt;
+  bool saved_skeleton = skeleton_bodies;
+  int line_number = 1, cap = 256;
+  token_list = (token_t **) malloc((unsigned) cap * sizeof(token_t *));
+  token_cnt = 0;
+  token_t *tok;
+  while ((tok = getToken(fp, &line_number)) != NULL) {
+    if (strcmp(tok->name, "EXCEPTION") == 0) {
+      meow_report(tok->lineno, "lexical error at line %d, type %s\n", tok->lineno, tok->value);
+      meow_fail();
+    }
+    if (token_cnt + 1 >= cap)
+      token_list = (token_t **) realloc(token_list, (unsigned) (cap *= 2) * sizeof(token_t *));
+    token_list[token_cnt++] = tok;
+  }
+  token_list[token_cnt] = new_token("EOT", line_number, "EOT");
+
+  // 取走之前分配的节点而不释放，已有的语法分析树仍然有效
+  free(parser_detach());
+  skeleton_bodies = skeleton;
+  syntax_t *prog = program(true);
+  if (token_cnt != current_token_cnt) {
+    meow_report(token_list[current_token_cnt]->lineno, "SYNTATIC PANIC: EXTRA TOKENS\n");
+    meow_fail();
+  }
+  // 语法分析树中的词法单元是复制的，骨架中跳过的函数体之后也不会再用到
+  for (int i = 0; i <= token_cnt; i++)
+    free(token_list[i]);
+  free(token_list);
+  free(parser_detach());
+  token_list = saved_list;
+  token_cnt = saved_cnt;
+  skeleton_bodies = saved_skeleton;
+  return prog;
+}
+
+module_t *module_load(const char *path, bool full) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "open module file failed: %s\n", path);
+    exit(-1);
+  }
+  size_t size = 0, cap = 4096, n;
+  char *buf = (char *) malloc(cap);
+  while ((n = fread(buf + size, 1, cap - size, fp)) > 0) {
+    size += n;
+    if (size == cap) buf = (char *) realloc(buf, cap *= 2);
+  }
+  unsigned long long hash = content_hash(buf, size);
+  free(buf);
+
+  module_t *mod = (module_t *) calloc(1, sizeof(module_t));
+  mod->path = path;
+  char *spath = summary_path(path);
+  mod->iface = read_summary(spath, hash);
+  mod->cached = mod->iface != NULL;
+  if (full || !mod->cached) {
+    // 模块中的词法和语法错误在报告之后指明所在的模块
+    jmp_buf env, *saved_handler = error_handler;
+    error_handler = &env;
+    if (setjmp(env) != 0) {
+      fprintf(stderr, "in module %s\n", path);
+      exit(-1);
+    }
+    rewind(fp);
+    syntax_t *prog = parse_module(fp, !full);
+    error_handler = saved_handler;
+    if (!mod->cached) {
+      mod->iface = lower_interface(prog);
+      write_summary(spath, hash, mod->iface);
+    }
+    if (full) mod->prog = prog;
+  }
+  free(spath);
+  fclose(fp);
+  return mod;
+}
@@ -0,0 +1,384 @@
+#include <optim.h>
+#include <callgraph.h>
+#include <error.h>
+
+// 统计每个虚拟寄存器在整个函数中被读取的次数
+static int *count_uses(ir_func_t *func) {
+  int *cnt = (int *) calloc((unsigned) func->nregs + 1, sizeof(int));
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->a.kind == IRV_REG) cnt[inst->a.val]++;
+      if (inst->b.kind == IRV_REG) cnt[inst->b.val]++;
+      if (inst->c.kind == IRV_REG) cnt[inst->c.val]++;
+      for (int k = 0; k < inst->nargs; k++)
+        if (inst->args[k].kind == IRV_REG) cnt[inst->args[k].val]++;
+    }
+  }
+  return cnt;
+}
+
+// 删除 marked 中记录的、结果不再被读取的 mov
+static int remove_unused_movs(ir_func_t *func, unsigned *marked) {
+  int removed = 0;
+  int *uses = count_uses(func);
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = bb->size - 1; i >= 0; i--) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->op == IR_MOV && bit_test(marked, inst->dst) && uses[inst->dst] == 0) {
+        ir_remove_inst(bb, i);
+        removed++;
+      }
+    }
+  }
+  free(uses);
+  return removed;
+}
+
+static void substitute(ir_val_t *v, bool *known, int *value) {
+  if (v->kind == IRV_REG && known[v->val])
+    *v = ir_imm(value[v->val]);
+}
+
+// 代数化简，把 x + 0、x * 1 等改写为 mov
+static bool simplify(ir_inst_t *inst) {
+  ir_val_t a = inst->a, b = inst->b;
+  bool a_is = a.kind == IRV_IMM, b_is = b.kind == IRV_IMM;
+  if ((inst->op == IR_ADD || inst->op == IR_SUB) && b_is && b.val == 0) {
+    inst->b = ir_none();
+  } else if (inst->op == IR_ADD && a_is && a.val == 0) {
+    inst->a = b;
+    inst->b = ir_none();
+  } else if ((inst->op == IR_MUL || inst->op == IR_DIV) && b_is && b.val == 1) {
+    inst->b = ir_none();
+  } else if (inst->op == IR_MUL && a_is && a.val == 1) {
+    inst->a = b;
+    inst->b = ir_none();
+  } else if (inst->op == IR_MUL && ((a_is && a.val == 0) || (b_is && b.val == 0))) {
+    inst->a = ir_imm(0);
+    inst->b = ir_none();
+  } else {
+    return false;
+  }
+  inst->op = IR_MOV;
+  return true;
+}
+
+// 基本块内的常量传播与常量折叠
+int fold_constants(ir_func_t *func) {
+  bool *known = (bool *) malloc((unsigned) func->nregs + 1);
+  int *value = (int *) malloc((unsigned) (func->nregs + 1) * sizeof(int));
+  unsigned *folded = (unsigned *) calloc((unsigned) (func->nregs / IR_BITS + 1), sizeof(unsigned));
+
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    memset(known, 0, (unsigned) func->nregs + 1);
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      substitute(&inst->a, known, value);
+      substitute(&inst->b, known, value);
+      substitute(&inst->c, known, value);
+      for (int k = 0; k < inst->nargs; k++)
+        substitute(&inst->args[k], known, value);
+
+      if (ir_is_binop(inst->op)) {
+        if (inst->a.kind == IRV_IMM && inst->b.kind == IRV_IMM) {
+          // 除以零留到运行时报错
+          if (inst->op != IR_DIV || inst->b.val != 0) {
+            inst->a = ir_imm(ir_eval(inst->op, inst->a.val, inst->b.val));
+            inst->b = ir_none();
+            inst->op = IR_MOV;
+            bit_set(folded, inst->dst);
+          }
+        } else if (simplify(inst)) {
+          bit_set(folded, inst->dst);
+        }
+      }
+
+      if (inst->dst >= 0) {
+        known[inst->dst] = inst->op == IR_MOV && inst->a.kind == IRV_IMM;
+        value[inst->dst] = inst->a.val;
+      }
+    }
+  }
+
+  int removed = remove_unused_movs(func, folded);
+  free(known);
+  free(value);
+  free(folded);
+  return removed;
+}
+
+// 基本块内的复写传播
+int propagate_copies(ir_func_t *func) {
+  int *copy_of = (int *) malloc((unsigned) (func->nregs + 1) * sizeof(int));
+  unsigned *copies = (unsigned *) calloc((unsigned) (func->nregs / IR_BITS + 1), sizeof(unsigned));
+
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int r = 0; r < func->nregs; r++)
+      copy_of[r] = -1;
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      ir_val_t *ops[3] = {&inst->a, &inst->b, &inst->c};
+      for (int k = 0; k < 3; k++)
+        if (ops[k]->kind == IRV_REG && copy_of[ops[k]->val] >= 0)
+          ops[k]->val = copy_of[ops[k]->val];
+      for (int k = 0; k < inst->nargs; k++)
+        if (inst->args[k].kind == IRV_REG && copy_of[inst->args[k].val] >= 0)
+          inst->args[k].val = copy_of[inst->args[k].val];
+
+      if (inst->dst < 0) continue;
+      // dst 被重新定义，以它为源或目标的复写都失效
+      copy_of[inst->dst] = -1;
+      for (int r = 0; r < func->nregs; r++)
+        if (copy_of[r] == inst->dst)
+          copy_of[r] = -1;
+      if (inst->op == IR_MOV && inst->a.kind == IRV_REG && inst->a.val != inst->dst) {
+        copy_of[inst->dst] = inst->a.val;
+        bit_set(copies, inst->dst);
+      }
+    }
+  }
+
+  int removed = remove_unused_movs(func, copies);
+  free(copy_of);
+  free(copies);
+  return removed;
+}
+
+// 从入口出发标记可达基本块，删除其余基本块并重新编号
+static int compact_blocks(ir_func_t *func) {
+  int n = func->nblocks, removed = 0;
+  int *id = (int *) malloc((unsigned) n * sizeof(int));
+  int *stack = (int *) malloc((unsigned) n * sizeof(int));
+  for (int b = 0; b < n; b++)
+    id[b] = -1;
+  int top = 0;
+  stack[top++] = 0;
+  id[0] = 0;
+  while (top) {
+    int b = stack[--top], succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    for (int s = 0; s < nsucc; s++)
+      if (id[succ[s]] < 0) {
+        id[succ[s]] = 0;
+        stack[top++] = succ[s];
+      }
+  }
+
+  int cnt = 0;
+  for (int b = 0; b < n; b++) {
+    if (id[b] < 0) {
+      removed += func->blocks[b].size;
+      for (int i = 0; i < func->blocks[b].size; i++)
+        free(func->blocks[b].insts[i].args);
+      free(func->blocks[b].insts);
+    } else {
+      id[b] = cnt;
+      func->blocks[cnt++] = func->blocks[b];
+    }
+  }
+  func->nblocks = cnt;
+  for (int b = 0; b < cnt; b++) {
+    ir_inst_t *last = &func->blocks[b].insts[func->blocks[b].size - 1];
+    for (int t = 0; t < 2; t++)
+      if (last->target[t] >= 0)
+        last->target[t] = id[last->target[t]];
+  }
+  free(id);
+  free(stack);
+  return removed;
+}
+
+// 化简常量条件分支，删除不可达基本块，并合并只有唯一前驱的基本块
+int remove_unreachable(ir_func_t *func) {
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    if (last->op == IR_BR && (last->a.kind == IRV_IMM || last->target[0] == last->target[1])) {
+      int target = last->a.kind == IRV_IMM && last->a.val == 0 ? last->target[1] : last->target[0];
+      last->op = IR_JMP;
+      last->a = ir_none();
+      last->target[0] = target;
+      last->target[1] = -1;
+    }
+  }
+  // 跳转到只含一条 jmp 的基本块时，直接跳到它的目标
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    for (int t = 0; t < 2 && last->target[t] >= 0; t++) {
+      for (int hops = 0; hops < func->nblocks; hops++) {
+        ir_block_t *next = &func->blocks[last->target[t]];
+        if (next->size != 1 || next->insts[0].op != IR_JMP || next->insts[0].target[0] == last->target[t])
+          break;
+        last->target[t] = next->insts[0].target[0];
+      }
+    }
+  }
+  int removed = compact_blocks(func);
+
+  int *preds = (int *) calloc((unsigned) func->nblocks, sizeof(int));
+  for (int b = 0; b < func->nblocks; b++) {
+    int succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    for (int s = 0; s < nsucc; s++)
+      preds[succ[s]]++;
+  }
+  bool merged = false;
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    if (bb->size == 0) continue;
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    while (last->op == IR_JMP && last->target[0] != b && last->target[0] != 0 && preds[last->target[0]] == 1) {
+      // 把后继接到本块末尾，后继变为空的不可达基本块
+      ir_block_t *next = &func->blocks[last->target[0]];
+      preds[last->target[0]] = 0;
+      bb->size--;
+      removed++;
+      for (int i = 0; i < next->size; i++)
+        *ir_emit(func, b, IR_NOP, 0) = next->insts[i];
+      next->size = 0;
+      last = &bb->insts[bb->size - 1];
+      merged = true;
+    }
+  }
+  free(preds);
+  if (merged)
+    compact_blocks(func);
+  return removed;
+}
+
+// 基于活跃变量分析删除结果不再被使用的无副作用指令
+int eliminate_dead_stores(ir_func_t *func) {
+  int removed = 0;
+  int *uses = (int *) malloc(16 * sizeof(int));
+  int cap_uses = 16;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    ir_live_t *live = ir_liveness(func);
+    unsigned *now = (unsigned *) malloc((unsigned) live->words * sizeof(unsigned));
+    for (int b = 0; b < func->nblocks; b++) {
+      ir_block_t *bb = &func->blocks[b];
+      memcpy(now, live->out[b], (unsigned) live->words * sizeof(unsigned));
+      for (int i = bb->size - 1; i >= 0; i--) {
+        ir_inst_t *inst = &bb->insts[i];
+        if (inst->dst >= 0 && !bit_test(now, inst->dst)) {
+          if (!ir_has_side_effect(inst)) {
+            ir_remove_inst(bb, i);
+            removed++;
+            changed = true;
+            continue;
+          }
+          // 调用本身要保留，只丢弃返回值；除法保留结果，生成的代码都假定除法有结果
+          if (inst->op == IR_CALL) inst->dst = -1;
+        }
+        if (inst->dst >= 0)
+          bit_clear(now, inst->dst);
+        if (inst->nargs + 3 > cap_uses) {
+          cap_uses = inst->nargs + 3;
+          uses = (int *) realloc(uses, (unsigned) cap_uses * sizeof(int));
+        }
+        int nuse = ir_inst_uses(inst, uses);
+        for (int k = 0; k < nuse; k++)
+          bit_set(now, uses[k]);
+      }
+    }
+    free(now);
+    ir_free_liveness(func, live);
+  }
+  free(uses);
+  return removed;
+}
+
+#define PASS_CNT 4
+
+static const char *pass_name[PASS_CNT] = {
+  "constant folding",
+  "copy propagation",
+  "unreachable block removal",
+  "dead store elimination",
+};
+
+static int (*const pass_func[PASS_CNT])(ir_func_t *) = {
+  fold_constants,
+  propagate_copies,
+  remove_unreachable,
+  eliminate_dead_stores,
+};
+
+// 各 pass 相互创造机会，迭代到不动点
+static void cleanup(ir_func_t *func, int *removed) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int p = 0; p < PASS_CNT; p++) {
+      int n = pass_func[p](func);
+      removed[p] += n;
+      if (n) changed = true;
+    }
+  }
+}
+
+// 在 SSA 形式上做值编号，再退出 SSA 形式并清理留下的复写
+static void number_func(ir_func_t *func, int *removed, int *phis, int *numbered) {
+  *phis += build_ssa(func);
+  if (ssa_verify && !verify_ssa(func)) meow_fail();
+  *numbered += number_values(func);
+  if (ssa_verify && !verify_ssa(func)) meow_fail();
+  destroy_ssa(func);
+  cleanup(func, removed);
+}
+
+static int count_checks(ir_prog_t *prog) {
+  int n = 0;
+  for (int f = 0; f < prog->nfuncs; f++)
+    for (int b = 0; b < prog->funcs[f]->nblocks; b++)
+      for (int i = 0; i < prog->funcs[f]->blocks[b].size; i++)
+        if (prog->funcs[f]->blocks[b].insts[i].op == IR_CHECK) n++;
+  return n;
+}
+
+void optimize(ir_prog_t *prog, int level, bool report) {
+  int before = ir_prog_size(prog);
+  int removed[PASS_CNT] = {0}, inlined = 0, dropped = 0, hoisted = 0, reduced = 0, proven = 0, phis = 0, numbered = 0;
+  if (level >= 1) {
+    // 先内联，再删除不再被调用的函数，内联进来的代码和调用者一起优化
+    if (!inline_off) inlined = inline_calls(prog);
+    dropped = remove_unreachable_funcs(prog);
+    for (int f = 0; f < prog->nfuncs; f++) {
+      ir_func_t *func = prog->funcs[f];
+      if (func->builtin || func->external) continue;
+      cleanup(func, removed);
+      // 在强度削弱改写下标之前分析，循环中剩下的数组长度随后作为不变量外提
+      if (check_bounds && !bounds_off) proven += eliminate_bounds_checks(prog, func);
+      if (!gvn_off) number_func(func, removed, &phis, &numbered);
+      // 循环优化之后留下的 mov 和空的前置基本块再清理一遍
+      if (!loop_off) {
+        hoisted += hoist_invariants(func);
+        reduced += reduce_strength(func);
+        cleanup(func, removed);
+      }
+      // 外提到前置基本块的数组地址和长度与循环之前的重复
+      if (!gvn_off) number_func(func, removed, &phis, &numbered);
+    }
+  }
+  if (report) {
+    if (level >= 1)
+      fprintf(stderr, "O%d inlining: inlined %d calls, removed %d unreachable functions\n", level, inlined, dropped);
+    if (level >= 1) {
+      fprintf(stderr, "O%d global value numbering: removed %d instructions (%d phis placed)\n", level, numbered, phis);
+      fprintf(stderr, "O%d loop-invariant code motion: hoisted %d instructions\n", level, hoisted);
+      fprintf(stderr, "O%d strength reduction: reduced %d multiplications\n", level, reduced);
+    }
+    if (check_bounds)
+      fprintf(stderr, "O%d bounds checks: %d eliminated, %d kept\n", level, proven, count_checks(prog));
+    for (int p = 0; p < PASS_CNT && level >= 1; p++)
+      fprintf(stderr, "O%d %s: removed %d instructions\n", level, pass_name[p], removed[p]);
+    fprintf(stderr, "O%d total: %d -> %d instructions\n", level, before, ir_prog_size(prog));
+  }
+}
@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L
+#include <parallel.h>
+#include <error.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// 词法单元序列确定之后各个顶层声明互不依赖：
+// 按花括号深度切分出每个声明的范围，工作线程各自领取声明并用自己的分析器状态分析，
+// 最后在主线程中按原来的顺序组装成 declaration_list
+
+// 分析深度嵌套的输入需要和主线程相当的栈空间
+#define WORKER_STACK_SIZE (8 << 20)
+
+typedef struct worker_t {
+  pthread_t thread;
+  void **blocks;        // 工作线程分配的节点，交给主线程释放
+  long long steps;
+  share_stats_t stats;
+} worker_t;
+
+static int *starts;     // 第 i 个声明是 [starts[i], starts[i + 1])
+static int ndecls;
+static syntax_t **decls;
+static int next_decl;
+static bool failed;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 深度为 0 的 ; 或者使深度回到 0 的 } 结束一个声明，括号不匹配时返回 false
+static bool split(void) {
+  int depth = 0, cap = 64;
+  starts = (int *) malloc((unsigned) cap * sizeof(int));
+  ndecls = 0;
+  starts[0] = 0;
+  for (int i = 0; i < token_cnt; i++) {
+    const char *name = token_list[i]->name;
+    if (strcmp(name, "LC") == 0) {
+      depth++;
+    } else if (strcmp(name, "RC") == 0) {
+      if (--depth < 0) return false;
+    } else if (strcmp(name, "SEMI") != 0 || depth > 0) {
+      continue;
+    }
+    if (depth == 0) {
+      if (ndecls + 2 > cap) {
+        cap *= 2;
+        starts = (int *) realloc(starts, (unsigned) cap * sizeof(int));
+      }
+      starts[++ndecls] = i + 1;
+    }
+  }
+  // 最后一个声明没有结束时也交给工作线程，由分析失败退回顺序分析
+  if (starts[ndecls] != token_cnt) starts[++ndecls] = token_cnt;
+  return ndecls > 0;
+}
+
+// 领取下一个声明，已经有线程失败时返回 -1
+static int take(void) {
+  pthread_mutex_lock(&lock);
+  int i = failed || next_decl == ndecls ? -1 : next_decl++;
+  pthread_mutex_unlock(&lock);
+  return i;
+}
+
+static void fail(void) {
+  pthread_mutex_lock(&lock);
+  failed = true;
+  pthread_mutex_unlock(&lock);
+}
+
+// 工作线程不报告错误，由顺序分析重新报告
+static void discard(int lineno, const char *message) {
+  (void) lineno;
+  (void) message;
+}
+
+static void *work(void *arg) {
+  worker_t *w = (worker_t *) arg;
+  jmp_buf env;
+  error_handler = &env;
+  diag_handler = discard;
+  if (setjmp(env) == 0) {
+    int i;
+    while ((i = take()) >= 0) {
+      current_token_cnt = starts[i];
+      decls[i] = declaration(true);
+      if (current_token_cnt != starts[i + 1]) {
+        fail();
+      }
+    }
+  } else {
+    fail();
+  }
+  w->steps = parse_steps;
+  w->stats = share_stats;
+  w->blocks = parser_detach();
+  return NULL;
+}
+
+syntax_t *parallel_program(int nthreads) {
+  if (nthreads <= 0) {
+    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (!split()) {
+    free(starts);
+    return program(true);
+  }
+  if (nthreads > ndecls) nthreads = ndecls;
+  if (nthreads < 1) nthreads = 1;
+  decls = (syntax_t **) malloc((unsigned) ndecls * sizeof(syntax_t *));
+  next_decl = 0;
+  failed = false;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+  worker_t *workers = (worker_t *) calloc((unsigned) nthreads, sizeof(worker_t));
+  int started = 0;
+  while (started < nthreads && pthread_create(&workers[started].thread, &attr, work, &workers[started]) == 0)
+    started++;
+  pthread_attr_destroy(&attr);
+  for (int t = 0; t < started; t++)
+    pthread_join(workers[t].thread, NULL);
+  // 一个线程也没能启动时由主线程自己分析
+  if (started == 0) {
+    work(&workers[started++]);
+  }
+  long long steps = 0;
+  share_stats_t stats = {0};
+  for (int t = 0; t < started; t++) {
+    parser_adopt(workers[t].blocks);
+    steps += workers[t].steps;
+    stats.bytes += workers[t].stats.bytes;
+    stats.shared_nodes += workers[t].stats.shared_nodes;
+    stats.shared_bytes += workers[t].stats.shared_bytes;
+    stats.table_bytes += workers[t].stats.table_bytes;
+  }
+  free(workers);
+
+  syntax_t *prog;
+  if (failed) {
+    // 丢弃已经分析的声明，顺序分析报告和原来相同的错误
+    parser_reset();
+    prog = program(true);
+  } else {
+    if (abstract_syntax) {
+      prog = new_list("program", decls, ndecls);
+    } else {
+      syntax_t *dl = new_list("declaration_list", decls, ndecls);
+      prog = new_symbol("program", dl->symbol.lineno, 1, dl);
+    }
+    current_token_cnt = token_cnt;
+    parse_steps += steps;
+    share_stats.bytes += stats.bytes;
+    share_stats.shared_nodes += stats.shared_nodes;
+    share_stats.shared_bytes += stats.shared_bytes;
+    share_stats.table_bytes += stats.table_bytes;
+  }
+  free(decls);
+  free(starts);
+  return prog;
+}
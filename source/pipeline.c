@@ -0,0 +1,106 @@
+#include <pipeline.h>
+#include <pthread.h>
+#include <limits.h>
+
+// 词法分析线程是唯一的生产者，语法分析线程是唯一的消费者：
+// 生产者先写入 token_list[i]，再用 release 语义发布 tokens_ready，消费者用 acquire 语义读取，不需要加锁。
+// 语法分析会回溯，骨架分析之后还会回到函数体的范围，所以已经读过的词法单元不能被覆盖，
+// 队列就是 token_list 本身，不做环形复用
+
+// 每次发布的词法单元数，减少两个线程之间缓存行的来回
+#define PUBLISH_BATCH 256
+
+static pthread_t lexer_thread;
+static bool threaded;
+static FILE *lexer_fp;
+static int lexer_max;
+// 按需分析时已经放入 token_list 的词法单元数和当前的行号
+static int lexed, lexer_line;
+
+// 第 n 个词法单元，文件结束时返回 NULL
+static token_t *next_token(FILE *fp, int n, int max_tokens, int *line_number) {
+  token_t *now_token = getToken(fp, line_number);
+  if (now_token == NULL) return NULL;
+  if (strcmp(now_token->name, "EXCEPTION") == 0) {
+    fprintf(stderr, "lexical error at line %d, type %s\n", now_token->lineno, now_token->value);
+    exit(-1);
+  }
+  if (n >= max_tokens) {
+    fprintf(stderr, "LEXER_PANIC: too many tokens");
+    exit(-1);
+  }
+  return now_token;
+}
+
+int lex_tokens(FILE *fp, int max_tokens, int *line_number, bool publish) {
+  int n = 0;
+  token_t *now_token;
+  while ((now_token = next_token(fp, n, max_tokens, line_number)) != NULL) {
+    token_list[n++] = now_token;
+    if (publish && n % PUBLISH_BATCH == 0) {
+      __atomic_store_n(&tokens_ready, n, __ATOMIC_RELEASE);
+    }
+    // printf("Token {name: %s, line: %d, value: %s}\n", now_token->name, now_token->lineno, now_token->value);
+  }
+  return n;
+}
+
+static void *produce(void *arg) {
+  (void) arg;
+  int line_number = 1;
+  int n = lex_tokens(lexer_fp, lexer_max, &line_number, true);
+  token_list[n] = new_token("EOT", line_number, "EOT");
+  // token_cnt 只由语法分析线程写，总数通过 -(n + 2) 交给它
+  __atomic_store_n(&tokens_ready, -(n + 2), __ATOMIC_RELEASE);
+  return NULL;
+}
+
+void pipeline_start(FILE *fp, int max_tokens) {
+  lexer_fp = fp;
+  lexer_max = max_tokens;
+  // 词法分析结束之前 token_cnt 不限制向前看，越过末尾的读取由 wait_token() 处理
+  token_cnt = INT_MAX;
+  tokens_ready = 0;
+  threaded = pthread_create(&lexer_thread, NULL, produce, NULL) == 0;
+  if (!threaded) {
+    // 不能创建线程时在当前线程中做完词法分析
+    produce(NULL);
+  }
+}
+
+// 由语法分析器在读到还没有发布的位置时调用，发布的方式和词法分析线程相同
+static void pull(void) {
+  for (int k = 0; k < PUBLISH_BATCH; k++) {
+    token_t *now_token = next_token(lexer_fp, lexed, lexer_max, &lexer_line);
+    if (now_token == NULL) {
+      token_list[lexed] = new_token("EOT", lexer_line, "EOT");
+      tokens_ready = -(lexed + 2);
+      token_pull = NULL;
+      return;
+    }
+    token_list[lexed++] = now_token;
+  }
+  tokens_ready = lexed;
+}
+
+void pipeline_start_on_demand(FILE *fp, int max_tokens) {
+  lexer_fp = fp;
+  lexer_max = max_tokens;
+  lexed = 0;
+  lexer_line = 1;
+  token_cnt = INT_MAX;
+  tokens_ready = 0;
+  token_pull = pull;
+}
+
+void pipeline_finish(void) {
+  if (threaded) {
+    pthread_join(lexer_thread, NULL);
+    threaded = false;
+  }
+  int ready = __atomic_load_n(&tokens_ready, __ATOMIC_ACQUIRE);
+  if (ready < -1) {
+    token_cnt = -ready - 2;
+    tokens_ready = -1;
+  }
+}
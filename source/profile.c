@@ -0,0 +1,170 @@
+#include <profile.h>
+#include <interp.h>
+
+const char *profile_report_path = NULL, *profile_stacks_path = NULL;
+long long *profile_lines = NULL, *profile_loops = NULL;
+
+// 调用树的节点：从 main 出发的一条调用路径，self 是停在这条路径上执行的指令数
+typedef struct node_t {
+  int func, parent, child, sibling;
+  long long self;
+} node_t;
+
+// 正在执行的一次调用
+typedef struct frame_t {
+  int func, node;
+  long long entry;      // 进入时的 interp_steps
+} frame_t;
+
+static ir_prog_t *profiled;
+static int max_line;
+static long long *calls, *inclusive, *exclusive;
+static int *active;     // 每个函数正在执行的调用数，递归时只在最外层累计包含的指令数
+static node_t *nodes;
+static int nnodes, cap_nodes;
+static frame_t *frames;
+static int depth, cap_frames;
+static long long last;
+
+// 把上一次进出函数以来执行的指令记到当前函数和调用路径上
+static void credit(void) {
+  if (depth) {
+    frame_t *top = &frames[depth - 1];
+    exclusive[top->func] += interp_steps - last;
+    nodes[top->node].self += interp_steps - last;
+  }
+  last = interp_steps;
+}
+
+static int child_of(int parent, int f) {
+  for (int n = nodes[parent].child; n >= 0; n = nodes[n].sibling)
+    if (nodes[n].func == f) return n;
+  if (nnodes == cap_nodes) {
+    cap_nodes *= 2;
+    nodes = (node_t *) realloc(nodes, (unsigned) cap_nodes * sizeof(node_t));
+  }
+  nodes[nnodes] = (node_t) { .func = f, .parent = parent, .child = -1, .sibling = nodes[parent].child, .self = 0 };
+  nodes[parent].child = nnodes;
+  return nnodes++;
+}
+
+void profile_enter(int f) {
+  credit();
+  int node = child_of(depth ? frames[depth - 1].node : 0, f);
+  if (depth == cap_frames) {
+    cap_frames *= 2;
+    frames = (frame_t *) realloc(frames, (unsigned) cap_frames * sizeof(frame_t));
+  }
+  frames[depth++] = (frame_t) { .func = f, .node = node, .entry = interp_steps };
+  calls[f]++;
+  active[f]++;
+}
+
+void profile_leave(void) {
+  credit();
+  frame_t *top = &frames[--depth];
+  if (--active[top->func] == 0)
+    inclusive[top->func] += interp_steps - top->entry;
+}
+
+static int by_exclusive(const void *x, const void *y) {
+  int f = *(const int *) x, g = *(const int *) y;
+  if (exclusive[f] != exclusive[g]) return exclusive[f] > exclusive[g] ? -1 : 1;
+  return f - g;
+}
+
+static int by_count(const void *x, const void *y) {
+  int a = *(const int *) x, b = *(const int *) y;
+  if (profile_lines[a] != profile_lines[b]) return profile_lines[a] > profile_lines[b] ? -1 : 1;
+  return a - b;
+}
+
+static void write_report(FILE *fp) {
+  long long total = interp_steps ? interp_steps : 1;
+  int n = profiled->nfuncs;
+  int *order = (int *) malloc((unsigned) (n > max_line + 1 ? n : max_line + 1) * sizeof(int));
+  fprintf(fp, "# %lld instructions executed\n", interp_steps);
+  fprintf(fp, "# functions, by exclusive instructions\n%10s %14s %14s %7s  %s\n", "calls", "inclusive", "exclusive", "self%", "function");
+  int cnt = 0;
+  for (int f = 0; f < n; f++)
+    if (calls[f]) order[cnt++] = f;
+  qsort(order, (unsigned) cnt, sizeof(int), by_exclusive);
+  for (int i = 0; i < cnt; i++) {
+    int f = order[i];
+    fprintf(fp, "%10lld %14lld %14lld %6.1f%%  %s (line %d)\n", calls[f], inclusive[f], exclusive[f],
+            100.0 * (double) exclusive[f] / (double) total, profiled->funcs[f]->name, profiled->funcs[f]->lineno);
+  }
+
+  fprintf(fp, "# loops, by line of the iteration statement\n%6s %14s\n", "line", "iterations");
+  for (int l = 0; l <= max_line; l++)
+    if (profile_loops[l]) fprintf(fp, "%6d %14lld\n", l, profile_loops[l]);
+
+  fprintf(fp, "# lines, by instructions\n%6s %14s %7s\n", "line", "instructions", "%");
+  cnt = 0;
+  for (int l = 0; l <= max_line; l++)
+    if (profile_lines[l]) order[cnt++] = l;
+  qsort(order, (unsigned) cnt, sizeof(int), by_count);
+  for (int i = 0; i < cnt; i++)
+    fprintf(fp, "%6d %14lld %6.1f%%\n", order[i], profile_lines[order[i]], 100.0 * (double) profile_lines[order[i]] / (double) total);
+  free(order);
+}
+
+// 每条调用路径一行 "main;f;g 指令数"，可以直接交给 flamegraph.pl 等工具
+static void write_stacks(FILE *fp) {
+  int *path = (int *) malloc((unsigned) nnodes * sizeof(int));
+  for (int v = 1; v < nnodes; v++) {
+    if (nodes[v].self == 0) continue;
+    int len = 0;
+    for (int u = v; u > 0; u = nodes[u].parent)
+      path[len++] = nodes[u].func;
+    for (int i = len - 1; i >= 0; i--)
+      fprintf(fp, "%s%s", profiled->funcs[path[i]]->name, i ? ";" : "");
+    fprintf(fp, " %lld\n", nodes[v].self);
+  }
+  free(path);
+}
+
+static void write_file(const char *path, void (*write)(FILE *)) {
+  if (path == NULL) return;
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "open profile output %s failed\n", path);
+    return;
+  }
+  write(fp);
+  fclose(fp);
+}
+
+// 运行时错误直接结束进程，还在执行的调用在这里结束
+static void profile_finish(void) {
+  fflush(stdout);
+  while (depth)
+    profile_leave();
+  write_file(profile_report_path, write_report);
+  write_file(profile_stacks_path, write_stacks);
+}
+
+void profile_start(ir_prog_t *prog) {
+  profiled = prog;
+  max_line = 0;
+  for (int f = 0; f < prog->nfuncs; f++) {
+    ir_func_t *func = prog->funcs[f];
+    for (int b = 0; b < func->nblocks; b++)
+      for (int i = 0; i < func->blocks[b].size; i++)
+        if (func->blocks[b].insts[i].lineno > max_line) max_line = func->blocks[b].insts[i].lineno;
+  }
+  profile_lines = (long long *) calloc((unsigned) max_line + 1, sizeof(long long));
+  profile_loops = (long long *) calloc((unsigned) max_line + 1, sizeof(long long));
+  calls = (long long *) calloc((unsigned) prog->nfuncs + 1, sizeof(long long));
+  inclusive = (long long *) calloc((unsigned) prog->nfuncs + 1, sizeof(long long));
+  exclusive = (long long *) calloc((unsigned) prog->nfuncs + 1, sizeof(long long));
+  active = (int *) calloc((unsigned) prog->nfuncs + 1, sizeof(int));
+  cap_nodes = cap_frames = 64;
+  nodes = (node_t *) malloc((unsigned) cap_nodes * sizeof(node_t));
+  nodes[0] = (node_t) { .func = -1, .parent = -1, .child = -1, .sibling = -1, .self = 0 };
+  nnodes = 1;
+  frames = (frame_t *) malloc((unsigned) cap_frames * sizeof(frame_t));
+  depth = 0;
+  last = interp_steps;
+  atexit(profile_finish);
+}
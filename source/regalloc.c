@@ -0,0 +1,171 @@
+#include <x86.h>
+
+const int arg_regs[6] = {RDI, RSI, RDX, RCX, R8, R9};
+
+// 可分配的寄存器，RAX/RDX 留给除法和返回值，R10/R11 留作临时寄存器
+// 调用者保存的寄存器按参数顺序排列，参数通常可以留在传入时的寄存器里
+#define POOL_SIZE 5
+static const int caller_pool[POOL_SIZE] = {RDI, RSI, RCX, R8, R9};
+static const int callee_pool[POOL_SIZE] = {RBX, R12, R13, R14, R15};
+
+typedef struct interval_t {
+  int vreg;
+  int start, end;
+  bool crosses_call;    // 跨越调用的值只能放在被调用者保存的寄存器里
+} interval_t;
+
+bool is_callee_saved(int reg) {
+  return reg == RBX || reg == RBP || (reg >= R12 && reg <= R15);
+}
+
+static void extend(interval_t *it, int pos) {
+  if (it->start < 0 || pos < it->start) it->start = pos;
+  if (pos > it->end) it->end = pos;
+}
+
+static int by_start(const void *x, const void *y) {
+  const interval_t *a = (const interval_t *) x, *b = (const interval_t *) y;
+  if (a->start != b->start) return a->start - b->start;
+  return a->vreg - b->vreg;
+}
+
+// 按基本块的排列顺序给指令编号，由活跃变量分析得到每个虚拟寄存器的活跃区间
+static interval_t *build_intervals(ir_func_t *func, ir_live_t *live) {
+  int n = func->nregs;
+  interval_t *its = (interval_t *) malloc((unsigned) (n + 1) * sizeof(interval_t));
+  for (int r = 0; r < n; r++)
+    its[r] = (interval_t) { .vreg = r, .start = -1, .end = -1, .crosses_call = false };
+
+  int ncalls = 0, cap_calls = 16, cap_uses = 16;
+  int *calls = (int *) malloc((unsigned) cap_calls * sizeof(int));
+  int *call_dst = (int *) malloc((unsigned) cap_calls * sizeof(int));
+  int *uses = (int *) malloc((unsigned) cap_uses * sizeof(int));
+  // 位置 0 是入口，参数在此定义
+  int pos = 1;
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    int first = pos;
+    for (int i = 0; i < bb->size; i++, pos++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->nargs + 3 > cap_uses) {
+        cap_uses = inst->nargs + 3;
+        uses = (int *) realloc(uses, (unsigned) cap_uses * sizeof(int));
+      }
+      int nuse = ir_inst_uses(inst, uses);
+      for (int k = 0; k < nuse; k++)
+        extend(&its[uses[k]], pos);
+      if (inst->dst >= 0)
+        extend(&its[inst->dst], pos);
+      if (inst->op == IR_CALL) {
+        if (ncalls == cap_calls) {
+          cap_calls *= 2;
+          calls = (int *) realloc(calls, (unsigned) cap_calls * sizeof(int));
+          call_dst = (int *) realloc(call_dst, (unsigned) cap_calls * sizeof(int));
+        }
+        call_dst[ncalls] = inst->dst;
+        calls[ncalls++] = pos;
+      }
+    }
+    for (int r = 0; r < n; r++) {
+      if (bit_test(live->in[b], r)) extend(&its[r], first);
+      if (bit_test(live->out[b], r)) extend(&its[r], pos - 1);
+    }
+  }
+  // 用到的参数从入口开始活跃，没用到的参数不需要位置
+  for (int r = 0; r < func->nparams; r++)
+    if (its[r].start >= 0)
+      its[r].start = 0;
+
+  // 调用之后仍然活跃的值（调用的结果除外）跨越调用；基本块的第一条指令是调用时，
+  // 入口活跃的值的起点就是调用的位置，所以起点等于调用的位置也算
+  for (int r = 0; r < n; r++)
+    for (int c = 0; c < ncalls; c++)
+      if (its[r].start <= calls[c] && calls[c] < its[r].end && r != call_dst[c])
+        its[r].crosses_call = true;
+  free(calls);
+  free(call_dst);
+  free(uses);
+  return its;
+}
+
+static int take_free(bool *busy, const int *pool) {
+  for (int i = 0; i < POOL_SIZE; i++)
+    if (!busy[pool[i]])
+      return pool[i];
+  return -1;
+}
+
+static void spill(regalloc_t *ra, int vreg) {
+  ra->reg[vreg] = -1;
+  ra->slot[vreg] = ra->nslots++;
+  ra->nspilled++;
+}
+
+// Poletto & Sarkar 的线性扫描：区间按起点排序，寄存器不够时溢出终点最远的区间
+// allocate 为假时所有虚拟寄存器都放在栈上
+regalloc_t *linear_scan(ir_func_t *func, bool allocate) {
+  regalloc_t *ra = (regalloc_t *) calloc(1, sizeof(regalloc_t));
+  int n = ra->nregs = func->nregs;
+  ra->reg = (int *) malloc((unsigned) (n + 1) * sizeof(int));
+  ra->slot = (int *) malloc((unsigned) (n + 1) * sizeof(int));
+  for (int r = 0; r < n; r++)
+    ra->reg[r] = ra->slot[r] = -1;
+  ra->live = ir_liveness(func);
+
+  interval_t *its = build_intervals(func, ra->live);
+  interval_t *sorted = (interval_t *) malloc((unsigned) (n + 1) * sizeof(interval_t));
+  int cnt = 0;
+  for (int r = 0; r < n; r++)
+    if (its[r].start >= 0)
+      sorted[cnt++] = its[r];
+  qsort(sorted, (unsigned) cnt, sizeof(interval_t), by_start);
+
+  interval_t **active = (interval_t **) malloc((unsigned) (cnt + 1) * sizeof(interval_t *));
+  int nactive = 0;
+  bool busy[REG_CNT] = {false};
+  for (int i = 0; i < cnt; i++) {
+    interval_t *cur = &sorted[i];
+    if (!allocate) {
+      spill(ra, cur->vreg);
+      continue;
+    }
+    // 释放已经结束的区间，指令总是先读源操作数再写目标，终点等于起点时可以复用
+    int kept = 0;
+    for (int k = 0; k < nactive; k++) {
+      if (active[k]->end <= cur->start) busy[ra->reg[active[k]->vreg]] = false;
+      else active[kept++] = active[k];
+    }
+    nactive = kept;
+
+    int reg = cur->crosses_call ? -1 : take_free(busy, caller_pool);
+    if (reg < 0) reg = take_free(busy, callee_pool);
+    if (reg < 0) {
+      interval_t *victim = NULL;
+      int vk = -1;
+      for (int k = 0; k < nactive; k++) {
+        int r = ra->reg[active[k]->vreg];
+        if (cur->crosses_call && !is_callee_saved(r)) continue;
+        if (victim == NULL || active[k]->end > victim->end) {
+          victim = active[k];
+          vk = k;
+        }
+      }
+      if (victim == NULL || victim->end <= cur->end) {
+        spill(ra, cur->vreg);
+        continue;
+      }
+      reg = ra->reg[victim->vreg];
+      spill(ra, victim->vreg);
+      active[vk] = active[--nactive];
+    }
+    ra->reg[cur->vreg] = reg;
+    busy[reg] = true;
+    if (is_callee_saved(reg)) ra->callee_used[reg] = true;
+    active[nactive++] = cur;
+  }
+
+  free(active);
+  free(sorted);
+  free(its);
+  return ra;
+}
@@ -0,0 +1,663 @@
+#include <optim.h>
+#include <error.h>
+
+bool ssa_verify = false;
+
+static void append(int **list, int *size, int x) {
+  *list = (int *) realloc(*list, (unsigned) (*size + 1) * sizeof(int));
+  (*list)[(*size)++] = x;
+}
+
+static int intersect(int *idom, int *po, int x, int y) {
+  while (x != y) {
+    while (po[x] < po[y])
+      x = idom[x];
+    while (po[y] < po[x])
+      y = idom[y];
+  }
+  return x;
+}
+
+// Cooper、Harvey 和 Kennedy 的迭代算法：按逆后序反复求前驱的直接支配者的公共祖先
+dom_tree_t *dom_tree_build(ir_func_t *func) {
+  int n = func->nblocks;
+  dom_tree_t *dt = (dom_tree_t *) calloc(1, sizeof(dom_tree_t));
+  dt->nblocks = n;
+  dt->npreds = (int *) calloc((unsigned) n, sizeof(int));
+  dt->preds = ir_preds(func, dt->npreds);
+  dt->idom = (int *) malloc((unsigned) n * sizeof(int));
+  dt->nkids = (int *) calloc((unsigned) n, sizeof(int));
+  dt->kids = (int **) calloc((unsigned) n, sizeof(int *));
+  dt->ndf = (int *) calloc((unsigned) n, sizeof(int));
+  dt->df = (int **) calloc((unsigned) n, sizeof(int *));
+  dt->pre = (int *) malloc((unsigned) n * sizeof(int));
+  dt->post = (int *) malloc((unsigned) n * sizeof(int));
+
+  // 深度优先搜索求后序编号，rpo 是逆后序
+  int *po = (int *) malloc((unsigned) n * sizeof(int));
+  int *rpo = (int *) malloc((unsigned) n * sizeof(int));
+  int *stack = (int *) malloc((unsigned) n * sizeof(int));
+  int *next = (int *) calloc((unsigned) n, sizeof(int));
+  int top = 0, cnt = 0;
+  for (int b = 0; b < n; b++) {
+    po[b] = -1;
+    dt->idom[b] = -1;
+  }
+  bool *seen = (bool *) calloc((unsigned) n, sizeof(bool));
+  stack[top++] = 0;
+  seen[0] = true;
+  while (top) {
+    int b = stack[top - 1], succ[2];
+    int nsucc = ir_succs(&func->blocks[b], succ);
+    if (next[b] == nsucc) {
+      po[b] = cnt;
+      rpo[n - 1 - cnt++] = b;
+      top--;
+      continue;
+    }
+    int s = succ[next[b]++];
+    if (!seen[s]) {
+      seen[s] = true;
+      stack[top++] = s;
+    }
+  }
+  int first = n - cnt;
+  dt->idom[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = first + 1; i < n; i++) {
+      int b = rpo[i], idom = -1;
+      for (int k = 0; k < dt->npreds[b]; k++) {
+        int p = dt->preds[b][k];
+        if (dt->idom[p] < 0) continue;
+        idom = idom < 0 ? p : intersect(dt->idom, po, p, idom);
+      }
+      if (idom != dt->idom[b]) {
+        dt->idom[b] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  // 汇合点的每个前驱沿着支配树向上，直到汇合点的直接支配者，途经的基本块的支配边界包含汇合点
+  for (int b = 0; b < n; b++) {
+    if (dt->npreds[b] < 2 || dt->idom[b] < 0) continue;
+    for (int k = 0; k < dt->npreds[b]; k++) {
+      int runner = dt->preds[b][k];
+      if (dt->idom[runner] < 0) continue;
+      while (runner != dt->idom[b]) {
+        if (dt->ndf[runner] == 0 || dt->df[runner][dt->ndf[runner] - 1] != b) append(&dt->df[runner], &dt->ndf[runner], b);
+        runner = dt->idom[runner];
+      }
+    }
+  }
+  dt->idom[0] = -1;
+  for (int i = first + 1; i < n; i++)
+    append(&dt->kids[dt->idom[rpo[i]]], &dt->nkids[dt->idom[rpo[i]]], rpo[i]);
+
+  // 支配树上的先序和后序编号，a 支配 b 当且仅当 b 的区间在 a 的区间之内
+  for (int b = 0; b < n; b++) {
+    dt->pre[b] = dt->post[b] = -1;
+    next[b] = 0;
+  }
+  int clock = 0;
+  top = 0;
+  stack[top++] = 0;
+  dt->pre[0] = clock++;
+  while (top) {
+    int b = stack[top - 1];
+    if (next[b] == dt->nkids[b]) {
+      dt->post[b] = clock++;
+      top--;
+      continue;
+    }
+    int kid = dt->kids[b][next[b]++];
+    dt->pre[kid] = clock++;
+    stack[top++] = kid;
+  }
+  free(po);
+  free(rpo);
+  free(stack);
+  free(next);
+  free(seen);
+  return dt;
+}
+
+void dom_tree_free(dom_tree_t *dt) {
+  for (int b = 0; b < dt->nblocks; b++) {
+    free(dt->kids[b]);
+    free(dt->df[b]);
+    free(dt->preds[b]);
+  }
+  free(dt->preds);
+  free(dt->npreds);
+  free(dt->idom);
+  free(dt->nkids);
+  free(dt->kids);
+  free(dt->ndf);
+  free(dt->df);
+  free(dt->pre);
+  free(dt->post);
+  free(dt);
+}
+
+bool dominates(dom_tree_t *dt, int a, int b) {
+  if (dt->pre[a] < 0 || dt->pre[b] < 0) return false;
+  return dt->pre[a] <= dt->pre[b] && dt->post[b] <= dt->post[a];
+}
+
+void iterated_frontier(ir_func_t *func, dom_tree_t *dt, const bool *blocks, bool *frontier) {
+  int n = func->nblocks, top = 0;
+  int *work = (int *) malloc((unsigned) n * sizeof(int));
+  bool *queued = (bool *) calloc((unsigned) n, sizeof(bool));
+  memset(frontier, 0, (unsigned) n * sizeof(bool));
+  for (int b = 0; b < n; b++)
+    if (blocks[b]) {
+      work[top++] = b;
+      queued[b] = true;
+    }
+  while (top) {
+    int x = work[--top];
+    for (int k = 0; k < dt->ndf[x]; k++) {
+      int y = dt->df[x][k];
+      if (frontier[y]) continue;
+      frontier[y] = true;
+      if (!queued[y]) {
+        queued[y] = true;
+        work[top++] = y;
+      }
+    }
+  }
+  free(work);
+  free(queued);
+}
+
+// 入口是循环头时新建一个只跳到原来入口的基本块作为入口，参数的初值从这里流入 phi
+static void split_entry(ir_func_t *func) {
+  bool has_pred = false;
+  for (int b = 0; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    if (last->target[0] == 0 || last->target[1] == 0) has_pred = true;
+  }
+  if (!has_pred) return;
+  int body = ir_new_block(func);
+  ir_block_t tmp = func->blocks[0];
+  func->blocks[0] = func->blocks[body];
+  func->blocks[body] = tmp;
+  for (int b = 1; b < func->nblocks; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    ir_inst_t *last = &bb->insts[bb->size - 1];
+    for (int t = 0; t < 2; t++)
+      if (last->target[t] == 0) last->target[t] = body;
+  }
+  ir_emit(func, 0, IR_JMP, func->lineno)->target[0] = body;
+}
+
+// 重命名时寄存器 reg 当前的名字被改写之前的值，离开基本块时按相反的顺序恢复
+typedef struct rename_t {
+  int reg, name;
+} rename_t;
+
+typedef struct renamer_t {
+  ir_func_t *func;
+  dom_tree_t *dt;
+  int *name;
+  rename_t *log;
+  int nlog, cap_log;
+} renamer_t;
+
+static void define(renamer_t *r, int *dst, int reg) {
+  if (r->nlog == r->cap_log) {
+    r->cap_log = r->cap_log ? 2 * r->cap_log : 64;
+    r->log = (rename_t *) realloc(r->log, (unsigned) r->cap_log * sizeof(rename_t));
+  }
+  r->log[r->nlog++] = (rename_t) { reg, r->name[reg] };
+  r->name[reg] = *dst = ir_new_reg(r->func);
+}
+
+static void rename_use(renamer_t *r, ir_val_t *v) {
+  if (v->kind == IRV_REG) v->val = r->name[v->val];
+}
+
+// 沿支配树先序重命名：定值得到新的名字，使用读取当前的名字，后继中 phi 的对应实参是离开时的名字
+static void rename_block(renamer_t *r, int b) {
+  ir_func_t *func = r->func;
+  int mark = r->nlog;
+  ir_block_t *bb = &func->blocks[b];
+  for (int i = 0; i < bb->size; i++) {
+    ir_inst_t *inst = &bb->insts[i];
+    if (inst->op != IR_PHI) {
+      rename_use(r, &inst->a);
+      rename_use(r, &inst->b);
+      rename_use(r, &inst->c);
+      for (int k = 0; k < inst->nargs; k++)
+        rename_use(r, &inst->args[k]);
+    }
+    if (inst->dst >= 0) define(r, &inst->dst, inst->op == IR_PHI ? inst->sym : inst->dst);
+  }
+  int succ[2];
+  int nsucc = ir_succs(bb, succ);
+  for (int t = 0; t < nsucc; t++) {
+    int s = succ[t], k = 0;
+    while (r->dt->preds[s][k] != b)
+      k++;
+    ir_block_t *sb = &func->blocks[s];
+    for (int i = 0; i < sb->size && sb->insts[i].op == IR_PHI; i++)
+      sb->insts[i].args[k] = ir_reg(r->name[sb->insts[i].sym]);
+  }
+  for (int k = 0; k < r->dt->nkids[b]; k++)
+    rename_block(r, r->dt->kids[b][k]);
+  while (r->nlog > mark) {
+    r->nlog--;
+    r->name[r->log[r->nlog].reg] = r->log[r->nlog].name;
+  }
+}
+
+int build_ssa(ir_func_t *func) {
+  remove_unreachable(func);
+  split_entry(func);
+  int n = func->nblocks, nregs = func->nregs, placed = 0;
+  dom_tree_t *dt = dom_tree_build(func);
+  ir_live_t *live = ir_liveness(func);
+
+  // 只在一个基本块内活跃的寄存器不需要 phi
+  int *ndefs = (int *) calloc((unsigned) nregs + 1, sizeof(int));
+  int **defs = (int **) calloc((unsigned) nregs + 1, sizeof(int *));
+  for (int b = 0; b < n; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      int d = func->blocks[b].insts[i].dst;
+      if (d >= 0 && (ndefs[d] == 0 || defs[d][ndefs[d] - 1] != b)) append(&defs[d], &ndefs[d], b);
+    }
+  bool *global = (bool *) calloc((unsigned) nregs + 1, sizeof(bool));
+  for (int b = 0; b < n; b++)
+    for (int v = 0; v < nregs; v++)
+      if (bit_test(live->in[b], v)) global[v] = true;
+
+  bool *blocks = (bool *) calloc((unsigned) n, sizeof(bool));
+  bool *frontier = (bool *) malloc((unsigned) n * sizeof(bool));
+  for (int v = 0; v < nregs; v++) {
+    if (!global[v] || ndefs[v] == 0) continue;
+    for (int k = 0; k < ndefs[v]; k++)
+      blocks[defs[v][k]] = true;
+    iterated_frontier(func, dt, blocks, frontier);
+    for (int k = 0; k < ndefs[v]; k++)
+      blocks[defs[v][k]] = false;
+    for (int b = 0; b < n; b++) {
+      if (!frontier[b] || !bit_test(live->in[b], v)) continue;
+      ir_inst_t *phi = ir_insert(func, b, 0, IR_PHI, func->blocks[b].insts[0].lineno);
+      phi->dst = phi->sym = v;
+      phi->nargs = dt->npreds[b];
+      phi->args = (ir_val_t *) malloc((unsigned) phi->nargs * sizeof(ir_val_t));
+      for (int k = 0; k < phi->nargs; k++)
+        phi->args[k] = ir_reg(v);
+      placed++;
+    }
+  }
+
+  // 入口处每个寄存器的名字就是它自己
+  renamer_t r = { func, dt, (int *) malloc((unsigned) nregs * sizeof(int) + 1), NULL, 0, 0 };
+  for (int v = 0; v < nregs; v++)
+    r.name[v] = v;
+  rename_block(&r, 0);
+
+  free(r.name);
+  free(r.log);
+  for (int v = 0; v < nregs; v++)
+    free(defs[v]);
+  free(defs);
+  free(ndefs);
+  free(global);
+  free(blocks);
+  free(frontier);
+  ir_free_liveness(func, live);
+  dom_tree_free(dt);
+  return placed;
+}
+
+static bool ssa_error(ir_func_t *func, int b, int reg, const char *cause) {
+  meow_report(0, "SSA verification failed in %s at L%d (t%d: %s)\n", func->name, b, reg, cause);
+  return false;
+}
+
+// 使用 reg 的位置（基本块 b 的第 i 条指令，phi 的实参算在前驱的末尾）被它的定值支配
+static bool available(dom_tree_t *dt, int *def_block, int *def_index, int reg, int b, int i) {
+  if (def_block[reg] < 0) return true;
+  if (def_block[reg] == b) return def_index[reg] < i;
+  return dominates(dt, def_block[reg], b);
+}
+
+bool verify_ssa(ir_func_t *func) {
+  int n = func->nblocks;
+  dom_tree_t *dt = dom_tree_build(func);
+  int *def_block = (int *) malloc((unsigned) func->nregs * sizeof(int) + 1);
+  int *def_index = (int *) malloc((unsigned) func->nregs * sizeof(int) + 1);
+  for (int r = 0; r < func->nregs; r++)
+    def_block[r] = def_index[r] = -1;
+  bool ok = dt->npreds[0] == 0 || ssa_error(func, 0, -1, "the entry has predecessors");
+  for (int b = 0; b < n && ok; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    if (dt->pre[b] < 0) ok = ssa_error(func, b, -1, "unreachable block");
+    for (int i = 0; i < bb->size && ok; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (ir_is_terminator(inst->op) != (i == bb->size - 1)) ok = ssa_error(func, b, inst->dst, "misplaced terminator");
+      else if (inst->op == IR_PHI && i > 0 && bb->insts[i - 1].op != IR_PHI) ok = ssa_error(func, b, inst->dst, "phi after other instructions");
+      else if (inst->op == IR_PHI && inst->nargs != dt->npreds[b]) ok = ssa_error(func, b, inst->dst, "phi arguments do not match the predecessors");
+      else if (inst->dst >= 0 && def_block[inst->dst] >= 0) ok = ssa_error(func, b, inst->dst, "defined more than once");
+      if (inst->dst >= 0) {
+        def_block[inst->dst] = b;
+        def_index[inst->dst] = i;
+      }
+    }
+  }
+  int *uses = NULL, cap_uses = 0;
+  for (int b = 0; b < n && ok; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size && ok; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->op == IR_PHI) {
+        for (int k = 0; k < inst->nargs && ok; k++) {
+          ir_val_t v = inst->args[k];
+          int p = dt->preds[b][k];
+          if (v.kind == IRV_REG && !available(dt, def_block, def_index, v.val, p, func->blocks[p].size))
+            ok = ssa_error(func, b, v.val, "phi argument not available in the predecessor");
+        }
+        continue;
+      }
+      if (inst->nargs + 3 > cap_uses) {
+        cap_uses = inst->nargs + 3;
+        uses = (int *) realloc(uses, (unsigned) cap_uses * sizeof(int));
+      }
+      int nuse = ir_inst_uses(inst, uses);
+      for (int k = 0; k < nuse && ok; k++)
+        if (!available(dt, def_block, def_index, uses[k], b, i)) ok = ssa_error(func, b, uses[k], "use not dominated by the definition");
+    }
+  }
+  free(uses);
+  free(def_block);
+  free(def_index);
+  dom_tree_free(dt);
+  return ok;
+}
+
+// 退出 SSA 形式时的状态：phi 感知的活跃变量，和 phi 连接的寄存器组成的等价类
+typedef struct coalescer_t {
+  ir_func_t *func;
+  dom_tree_t *dt;
+  int words;
+  unsigned **in, **out;   // phi 的实参在对应前驱的出口活跃，phi 的结果在基本块入口不活跃
+  int *def_block, *def_index;
+  int *parent, *next;     // 并查集，next 把同一类的寄存器串成环
+  bool *param;            // 类中有参数，两个参数不能合并
+} coalescer_t;
+
+static bool uses_reg(ir_inst_t *inst, int reg) {
+  if ((inst->a.kind == IRV_REG && inst->a.val == reg) || (inst->b.kind == IRV_REG && inst->b.val == reg)
+      || (inst->c.kind == IRV_REG && inst->c.val == reg))
+    return true;
+  for (int k = 0; k < inst->nargs; k++)
+    if (inst->args[k].kind == IRV_REG && inst->args[k].val == reg) return true;
+  return false;
+}
+
+static void ssa_liveness(coalescer_t *c) {
+  ir_func_t *func = c->func;
+  int n = func->nblocks, words = c->words = func->nregs / IR_BITS + 1;
+  c->in = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  c->out = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  unsigned **use = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  unsigned **def = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  unsigned **phi_use = (unsigned **) malloc((unsigned) n * sizeof(unsigned *));
+  for (int b = 0; b < n; b++) {
+    c->in[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    c->out[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    use[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    def[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+    phi_use[b] = (unsigned *) calloc((unsigned) words, sizeof(unsigned));
+  }
+  for (int b = 0; b < n; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size; i++) {
+      ir_inst_t *inst = &bb->insts[i];
+      if (inst->op == IR_PHI) {
+        for (int k = 0; k < inst->nargs; k++)
+          if (inst->args[k].kind == IRV_REG) bit_set(phi_use[c->dt->preds[b][k]], inst->args[k].val);
+      } else {
+        ir_val_t *ops[3] = { &inst->a, &inst->b, &inst->c };
+        for (int k = 0; k < 3 + inst->nargs; k++) {
+          ir_val_t *v = k < 3 ? ops[k] : &inst->args[k - 3];
+          if (v->kind == IRV_REG && !bit_test(def[b], v->val)) bit_set(use[b], v->val);
+        }
+      }
+      if (inst->dst >= 0) bit_set(def[b], inst->dst);
+    }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = n - 1; b >= 0; b--) {
+      int succ[2];
+      int nsucc = ir_succs(&func->blocks[b], succ);
+      for (int w = 0; w < words; w++) {
+        unsigned out = phi_use[b][w];
+        for (int s = 0; s < nsucc; s++)
+          out |= c->in[succ[s]][w];
+        unsigned in = use[b][w] | (out & ~def[b][w]);
+        if (out != c->out[b][w] || in != c->in[b][w]) {
+          c->out[b][w] = out;
+          c->in[b][w] = in;
+          changed = true;
+        }
+      }
+    }
+  }
+  for (int b = 0; b < n; b++) {
+    free(use[b]);
+    free(def[b]);
+    free(phi_use[b]);
+  }
+  free(use);
+  free(def);
+  free(phi_use);
+}
+
+// x 在 y 的定值之后是否活跃；SSA 形式中两个寄存器的活跃范围相交，当且仅当其中一个在另一个的定值处活跃
+static bool live_at_def(coalescer_t *c, int x, int y) {
+  int b = c->def_block[y];
+  if (b < 0) return bit_test(c->in[0], x);
+  ir_block_t *bb = &c->func->blocks[b];
+  int i = c->def_index[y] + 1;
+  // 同一个基本块的 phi 同时定值
+  while (i < bb->size && bb->insts[i].op == IR_PHI)
+    i++;
+  for (; i < bb->size; i++) {
+    if (uses_reg(&bb->insts[i], x)) return true;
+    if (bb->insts[i].dst == x) return false;
+  }
+  return bit_test(c->out[b], x);
+}
+
+static int find(coalescer_t *c, int r) {
+  while (c->parent[r] != r)
+    r = c->parent[r] = c->parent[c->parent[r]];
+  return r;
+}
+
+static bool interfere(coalescer_t *c, int x, int y) {
+  int i = x;
+  do {
+    int j = y;
+    do {
+      if (live_at_def(c, i, j) || live_at_def(c, j, i)) return true;
+      j = c->next[j];
+    } while (j != y);
+    i = c->next[i];
+  } while (i != x);
+  return false;
+}
+
+// 合并两个类，类中有参数时参数是代表
+static void unite(coalescer_t *c, int x, int y) {
+  if (c->param[y]) {
+    int t = x;
+    x = y;
+    y = t;
+  }
+  c->parent[y] = x;
+  c->param[x] = c->param[x] || c->param[y];
+  int t = c->next[x];
+  c->next[x] = c->next[y];
+  c->next[y] = t;
+}
+
+// 在基本块 b 的第 i 条指令之前插入 dst = src
+static void insert_copy(ir_func_t *func, int b, int i, int dst, ir_val_t src, int lineno) {
+  ir_inst_t *mov = ir_insert(func, b, i, IR_MOV, lineno);
+  mov->dst = dst;
+  mov->a = src;
+}
+
+// 把并行复写 dst[k] = src[k] 排成顺序执行的复写插入到基本块 b 的末尾：
+// 目标不再被其他复写读取的先执行，剩下的成环时先把一个目标存入新的寄存器
+static void sequentialize(ir_func_t *func, int b, int *dst, ir_val_t *src, int cnt, int lineno) {
+  while (cnt) {
+    int pick = -1;
+    for (int k = 0; k < cnt && pick < 0; k++) {
+      bool read = false;
+      for (int j = 0; j < cnt && !read; j++)
+        read = j != k && src[j].kind == IRV_REG && src[j].val == dst[k];
+      if (!read) pick = k;
+    }
+    if (pick < 0) {
+      int t = ir_new_reg(func);
+      insert_copy(func, b, func->blocks[b].size - 1, t, ir_reg(dst[0]), lineno);
+      for (int j = 0; j < cnt; j++)
+        if (src[j].kind == IRV_REG && src[j].val == dst[0]) src[j] = ir_reg(t);
+      continue;
+    }
+    insert_copy(func, b, func->blocks[b].size - 1, dst[pick], src[pick], lineno);
+    dst[pick] = dst[cnt - 1];
+    src[pick] = src[cnt - 1];
+    cnt--;
+  }
+}
+
+static void rename_reg(coalescer_t *c, ir_val_t *v) {
+  if (v->kind == IRV_REG) v->val = find(c, v->val);
+}
+
+void destroy_ssa(ir_func_t *func) {
+  int n = func->nblocks, nregs = func->nregs;
+  coalescer_t c = { .func = func, .dt = dom_tree_build(func) };
+  ssa_liveness(&c);
+  c.def_block = (int *) malloc((unsigned) nregs * sizeof(int) + 1);
+  c.def_index = (int *) malloc((unsigned) nregs * sizeof(int) + 1);
+  c.parent = (int *) malloc((unsigned) nregs * sizeof(int) + 1);
+  c.next = (int *) malloc((unsigned) nregs * sizeof(int) + 1);
+  c.param = (bool *) calloc((unsigned) nregs + 1, sizeof(bool));
+  for (int r = 0; r < nregs; r++) {
+    c.def_block[r] = c.def_index[r] = -1;
+    c.parent[r] = c.next[r] = r;
+    c.param[r] = r < func->nparams;
+  }
+  for (int b = 0; b < n; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      int d = func->blocks[b].insts[i].dst;
+      if (d < 0) continue;
+      c.def_block[d] = b;
+      c.def_index[d] = i;
+    }
+
+  // phi 的结果和实参不干扰时合并为一个寄存器，这条边上就不需要复写
+  for (int b = 0; b < n; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    for (int i = 0; i < bb->size && bb->insts[i].op == IR_PHI; i++)
+      for (int k = 0; k < bb->insts[i].nargs; k++) {
+        ir_val_t v = bb->insts[i].args[k];
+        if (v.kind != IRV_REG) continue;
+        int x = find(&c, bb->insts[i].dst), y = find(&c, v.val);
+        if (x == y || (c.param[x] && c.param[y]) || interfere(&c, x, y)) continue;
+        unite(&c, x, y);
+      }
+  }
+  for (int b = 0; b < n; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      ir_inst_t *inst = &func->blocks[b].insts[i];
+      if (inst->dst >= 0) inst->dst = find(&c, inst->dst);
+      rename_reg(&c, &inst->a);
+      rename_reg(&c, &inst->b);
+      rename_reg(&c, &inst->c);
+      for (int k = 0; k < inst->nargs; k++)
+        rename_reg(&c, &inst->args[k]);
+    }
+
+  // 其余的实参在前驱的末尾复写；前驱有两个后继时先拆分这条边
+  int *dst = (int *) malloc((unsigned) nregs * sizeof(int) + 1);
+  ir_val_t *src = (ir_val_t *) malloc((unsigned) nregs * sizeof(ir_val_t) + 1);
+  for (int b = 0; b < n; b++) {
+    if (func->blocks[b].size == 0 || func->blocks[b].insts[0].op != IR_PHI) continue;
+    for (int k = 0; k < c.dt->npreds[b]; k++) {
+      int cnt = 0, p = c.dt->preds[b][k];
+      ir_block_t *bb = &func->blocks[b];
+      for (int i = 0; i < bb->size && bb->insts[i].op == IR_PHI; i++) {
+        ir_val_t v = bb->insts[i].args[k];
+        if (v.kind == IRV_REG && v.val == bb->insts[i].dst) continue;
+        dst[cnt] = bb->insts[i].dst;
+        src[cnt++] = v;
+      }
+      if (cnt == 0) continue;
+      int lineno = bb->insts[0].lineno;
+      ir_block_t *pb = &func->blocks[p];
+      if (pb->insts[pb->size - 1].op != IR_JMP) {
+        int e = ir_new_block(func);
+        pb = &func->blocks[p];
+        for (int t = 0; t < 2; t++)
+          if (pb->insts[pb->size - 1].target[t] == b) pb->insts[pb->size - 1].target[t] = e;
+        ir_emit(func, e, IR_JMP, lineno)->target[0] = b;
+        p = e;
+      }
+      sequentialize(func, p, dst, src, cnt, lineno);
+    }
+  }
+  for (int b = 0; b < n; b++) {
+    ir_block_t *bb = &func->blocks[b];
+    while (bb->size && bb->insts[0].op == IR_PHI)
+      ir_remove_inst(bb, 0);
+  }
+
+  // 按出现的顺序重新编号，参数保持原来的编号
+  int *id = (int *) malloc((unsigned) func->nregs * sizeof(int) + 1);
+  for (int r = 0; r < func->nregs; r++)
+    id[r] = r < func->nparams ? r : -1;
+  int cnt = func->nparams;
+  for (int b = 0; b < func->nblocks; b++)
+    for (int i = 0; i < func->blocks[b].size; i++) {
+      ir_inst_t *inst = &func->blocks[b].insts[i];
+      ir_val_t *ops[3] = { &inst->a, &inst->b, &inst->c };
+      for (int k = 0; k < 4 + inst->nargs; k++) {
+        int *r = k == 0 ? &inst->dst : k < 4 ? (ops[k - 1]->kind == IRV_REG ? &ops[k - 1]->val : NULL)
+                 : (inst->args[k - 4].kind == IRV_REG ? &inst->args[k - 4].val : NULL);
+        if (r == NULL || *r < 0) continue;
+        if (id[*r] < 0) id[*r] = cnt++;
+        *r = id[*r];
+      }
+    }
+  func->nregs = cnt;
+
+  free(id);
+  free(dst);
+  free(src);
+  for (int b = 0; b < n; b++) {
+    free(c.in[b]);
+    free(c.out[b]);
+  }
+  free(c.in);
+  free(c.out);
+  free(c.def_block);
+  free(c.def_index);
+  free(c.parent);
+  free(c.next);
+  free(c.param);
+  dom_tree_free(c.dt);
+}
@@ -1,18 +1,72 @@
+#define _POSIX_C_SOURCE 200809L
 #include <lexer.h>
 #include <syntax.h>
+#include <error.h>
+#include <limits.h>
+#include <sched.h>
 
-extern token_t **token_list;
-extern int token_cnt;
-int current_token_cnt = 0;
+token_t **token_list;
+int token_cnt;
+int tokens_ready = -1;
+THREAD_LOCAL int current_token_cnt = 0;
+THREAD_LOCAL long long parse_steps = 0;
+long long parse_budget = 0;
+bool compact_expr = false;
+bool skeleton_bodies = false;
+bool share_subtrees = false;
+bool flat_lists = false;
+bool print_nested = false;
+bool abstract_syntax = false;
+void (*declaration_sink)(syntax_t *dec, int k) = NULL;
+void (*token_pull)(void) = NULL;
+THREAD_LOCAL share_stats_t share_stats;
 // static token_t* current_token;
 
-#define current_token (token_list[current_token_cnt])
-#define next_token (token_list[current_token_cnt + 1])
+// 本线程已经确认可以读取的词法单元数，之前的位置不需要再检查
+static THREAD_LOCAL int tokens_seen;
+
+static token_t *wait_token(int i);
+
+static inline token_t *token_at(int i) {
+  return i < tokens_seen ? token_list[i] : wait_token(i);
+}
+
+// 向前看不越过末尾的 EOT
+#define peek_token(K) token_at(current_token_cnt + (K))
+#define current_token token_at(current_token_cnt)
+#define next_token peek_token(1)
 #define line_number (current_token->lineno)
 #define istyp(TYPE) (strcmp(current_token->name, #TYPE) == 0)
-#define istoktyp(TOKEN, TYPE) (strcmp(token_list[current_token_cnt + TOKEN]->name, #TYPE) == 0)
+#define istoktyp(TOKEN, TYPE) (strcmp(peek_token(TOKEN)->name, #TYPE) == 0)
 #define isnxttyp(TYPE) (strcmp(next_token->name, #TYPE) == 0)
 
+// 表达式和语句的最大嵌套深度，避免过深的嵌套耗尽栈空间
+#define MAX_DEPTH 1000
+static THREAD_LOCAL int depth = 0;
+
+// 语法分析中分配的内存，从大块中顺序切分，由 parser_reset() 统一释放
+#define CHUNK_SIZE 65536
+static THREAD_LOCAL void **allocs;
+static THREAD_LOCAL int alloc_cnt, alloc_cap;
+static THREAD_LOCAL char *chunk_ptr, *chunk_end;
+
+// 正在分析的列表（declaration_list 等）的元素，嵌套的列表共用这个栈
+// 列表先依次分析出所有元素再构造右递归的节点，避免长列表的递归耗尽栈空间
+static THREAD_LOCAL syntax_t **items;
+static THREAD_LOCAL int item_cnt, item_cap;
+
+// -H 时已有节点的散列表，开放定址，容量是 2 的幂
+static THREAD_LOCAL syntax_t **shared;
+static THREAD_LOCAL unsigned *shared_hash;
+static THREAD_LOCAL int shared_cnt, shared_cap;
+
+// var 的分析结果按起始位置记忆，expression 回溯后重新分析 var 时直接复用
+// 流水线分析时不知道词法单元的总数，按需要扩大
+static THREAD_LOCAL syntax_t **var_memo;
+static THREAD_LOCAL int *var_memo_end;
+static THREAD_LOCAL int var_memo_cap;
+static THREAD_LOCAL int var_memo_base;    // var_memo[i] 是位置 var_memo_base + i 的结果
+
 #define SAVE_CONT int cont = current_token_cnt
 #define RESTORE_CONT current_token_cnt = cont
 #define NONLAST_FAIL do {\
@@ -33,36 +87,211 @@ int current_token_cnt = 0;
   return NULL;\
 }while(0)
 
+// 词法单元序列完整时越过末尾的位置读到 EOT；流水线分析时等待词法分析线程发布第 i 个词法单元，
+// 词法分析线程发布 -(n + 2) 表示共有 n 个词法单元，之后 token_cnt 才有效
+static token_t *wait_token(int i) {
+  for (;;) {
+    int ready = __atomic_load_n(&tokens_ready, __ATOMIC_ACQUIRE);
+    if (ready < 0) {
+      if (ready < -1) token_cnt = -ready - 2;
+      tokens_seen = token_cnt + 1;
+      return token_list[i < token_cnt ? i : token_cnt];
+    }
+    if (i < ready) {
+      tokens_seen = ready;
+      return token_list[i];
+    }
+    if (token_pull != NULL) {
+      token_pull();
+    } else {
+      sched_yield();
+    }
+  }
+}
+
 void syn_error(int lineno, const char *cause, const char *sym) {
-  fprintf(stderr, "Syntax error at line %d (%s in %s)\n", lineno, cause, sym);
-  exit(-1);
+  // 流水线分析时先等词法分析结束，和顺序分析一样优先报告词法错误
+  token_at(INT_MAX);
+  meow_report(lineno, "Syntax error at line %d (%s in %s)\n", lineno, cause, sym);
+  meow_fail();
+}
+
+static void *syn_alloc(size_t size) {
+  if (++parse_steps > parse_budget && parse_budget) {
+    syn_error(line_number, "parse budget exceeded", __func__);
+  }
+  size = (size + 7) / 8 * 8;
+  share_stats.bytes += (long long) size;
+  if (size > (size_t) (chunk_end - chunk_ptr)) {
+    if (alloc_cnt == alloc_cap) {
+      alloc_cap = alloc_cap ? 2 * alloc_cap : 1024;
+      allocs = (void **) realloc(allocs, (unsigned) alloc_cap * sizeof(void *));
+    }
+    size_t chunk = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    chunk_ptr = (char *) (allocs[alloc_cnt++] = malloc(chunk));
+    chunk_end = chunk_ptr + chunk;
+  }
+  void *p = chunk_ptr;
+  chunk_ptr += size;
+  return p;
+}
+
+void parser_reset(void) {
+  for (int i = 0; i < alloc_cnt; i++)
+    free(allocs[i]);
+  alloc_cnt = 0;
+  chunk_ptr = chunk_end = NULL;
+  free(var_memo);
+  free(var_memo_end);
+  var_memo = NULL;
+  var_memo_end = NULL;
+  var_memo_cap = 0;
+  var_memo_base = 0;
+  tokens_seen = 0;
+  free(items);
+  items = NULL;
+  item_cnt = item_cap = 0;
+  free(shared);
+  free(shared_hash);
+  shared = NULL;
+  shared_hash = NULL;
+  shared_cnt = shared_cap = 0;
+  share_stats = (share_stats_t) {0};
+  current_token_cnt = 0;
+  depth = 0;
+  parse_steps = 0;
+}
+
+void **parser_detach(void) {
+  void **blocks = (void **) realloc(allocs, (unsigned) (alloc_cnt + 1) * sizeof(void *));
+  blocks[alloc_cnt] = NULL;
+  allocs = NULL;
+  alloc_cnt = alloc_cap = 0;
+  parser_reset();
+  return blocks;
+}
+
+void parser_adopt(void **blocks) {
+  for (int i = 0; blocks[i] != NULL; i++) {
+    if (alloc_cnt == alloc_cap) {
+      alloc_cap = alloc_cap ? 2 * alloc_cap : 1024;
+      allocs = (void **) realloc(allocs, (unsigned) alloc_cap * sizeof(void *));
+    }
+    allocs[alloc_cnt++] = blocks[i];
+  }
+  free(blocks);
+}
+
+// FNV-1a；子节点已经共用，用指针代表整棵子树
+static unsigned hash_bytes(unsigned h, const void *p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    h ^= ((const unsigned char *) p)[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static unsigned node_hash(syntax_t *node) {
+  unsigned h = 2166136261u;
+  if (node->type == TOKEN) {
+    h = hash_bytes(h, node->token.name, strlen(node->token.name));
+    return hash_bytes(h, node->token.value, strlen(node->token.value));
+  }
+  h = hash_bytes(h, node->symbol.name, strlen(node->symbol.name));
+  return hash_bytes(h, node->symbol.child, (unsigned) node->symbol.size * sizeof(syntax_t *));
+}
+
+// 行号不参与比较，共用的节点保留第一次出现时的行号
+static bool same_node(syntax_t *a, syntax_t *b) {
+  if (a->type != b->type) return false;
+  if (a->type == TOKEN)
+    return strcmp(a->token.name, b->token.name) == 0 && strcmp(a->token.value, b->token.value) == 0;
+  return strcmp(a->symbol.name, b->symbol.name) == 0 && a->symbol.size == b->symbol.size
+    && (a->symbol.size == 0 || memcmp(a->symbol.child, b->symbol.child, (unsigned) a->symbol.size * sizeof(syntax_t *)) == 0);
+}
+
+static void grow_shared(void) {
+  int cap = shared_cap ? 2 * shared_cap : 256;
+  syntax_t **nodes = (syntax_t **) calloc((unsigned) cap, sizeof(syntax_t *));
+  unsigned *hashes = (unsigned *) malloc((unsigned) cap * sizeof(unsigned));
+  for (int i = 0; i < shared_cap; i++) {
+    if (shared[i] == NULL) continue;
+    unsigned j = shared_hash[i] & (unsigned) (cap - 1);
+    while (nodes[j] != NULL) j = (j + 1) & (unsigned) (cap - 1);
+    nodes[j] = shared[i];
+    hashes[j] = shared_hash[i];
+  }
+  free(shared);
+  free(shared_hash);
+  shared = nodes;
+  shared_hash = hashes;
+  shared_cap = cap;
+  share_stats.table_bytes = (long long) cap * (long long) (sizeof(syntax_t *) + sizeof(unsigned));
+}
+
+// 返回和 node 结构相同的已有节点；node 总是刚刚分配的，重复时把它的内存还给当前的大块
+static syntax_t *intern(syntax_t *node, size_t size) {
+  if (2 * (shared_cnt + 1) > shared_cap) grow_shared();
+  unsigned h = node_hash(node);
+  unsigned i = h & (unsigned) (shared_cap - 1);
+  for (; shared[i] != NULL; i = (i + 1) & (unsigned) (shared_cap - 1)) {
+    if (shared_hash[i] == h && same_node(shared[i], node)) {
+      size = (size + 7) / 8 * 8;
+      share_stats.shared_nodes++;
+      if ((char *) node + size == chunk_ptr) {
+        chunk_ptr = (char *) node;
+        share_stats.shared_bytes += (long long) size;
+      }
+      return shared[i];
+    }
+  }
+  shared[i] = node;
+  shared_hash[i] = h;
+  shared_cnt++;
+  return node;
 }
 
 syntax_t* advance() {
   // if (current_token_cnt == token_cnt - 1)
   //   return false;
-  syntax_t *res = (syntax_t *) malloc(sizeof(syntax_t));
+  syntax_t *res = (syntax_t *) syn_alloc(sizeof(syntax_t));
   res->type = TOKEN;
   res->token = *current_token;
   ++current_token_cnt;
   assert(current_token_cnt <= token_cnt);
   // current_token = token_list[++current_token_cnt];
-  return res;
+  return share_subtrees ? intern(res, sizeof(syntax_t)) : res;
 }
 
-syntax_t *new_symbol(const char *name, int lineno, int size, ...) {
-  syntax_t *ret = (syntax_t *) malloc(sizeof(syntax_t));
+// 越过标点和关键字：抽象语法树（-ast）中不保存，不分配节点，返回 NULL
+static syntax_t *take(void) {
+  if (abstract_syntax) {
+    ++current_token_cnt;
+    return NULL;
+  }
+  return advance();
+}
+
+// 符号节点和词法单元节点的行号，抽象语法树中的操作数可以是词法单元
+static int line_of(syntax_t *node) {
+  return node->type == TOKEN ? node->token.lineno : node->symbol.lineno;
+}
+
+static syntax_t *alloc_symbol(const char *name, int lineno, int size) {
+  // 子节点数组紧跟在节点之后，和节点一起分配
+  syntax_t *ret = (syntax_t *) syn_alloc(sizeof(syntax_t) + (unsigned) size * sizeof(syntax_t*));
   ret->type = SYMBOL;  // 设置为符号类型
 
   strcpy(ret->symbol.name, name);  // 设置符号名称
   ret->symbol.lineno = lineno;  // 设置符号所在行
 
   ret->symbol.size = size;  // 子节点数量
-  if (!size) {
-    return ret;
-  }
-  ret->symbol.child = (syntax_t **) malloc((unsigned) size * sizeof(syntax_t*));  // 分配内存存储子节点
+  ret->symbol.child = size ? (syntax_t **) (ret + 1) : NULL;  // 存储子节点的数组
+  return ret;
+}
 
+syntax_t *new_symbol(const char *name, int lineno, int size, ...) {
+  syntax_t *ret = alloc_symbol(name, lineno, size);
   va_list args;
   va_start(args, size);
   for (int i = 0; i < size; i++) {
@@ -71,12 +300,85 @@ syntax_t *new_symbol(const char *name, int lineno, int size, ...) {
   }
   va_end(args);
 
+  if (share_subtrees) {
+    return intern(ret, sizeof(syntax_t) + (unsigned) size * sizeof(syntax_t*));
+  }
   return ret;
 }
 
+static bool is_list(const char *name) {
+  return strcmp(name, "declaration_list") == 0 || strcmp(name, "local_declarations") == 0 || strcmp(name, "statement_list") == 0
+    || strcmp(name, "arg_list") == 0 || strcmp(name, "param_list") == 0;
+}
+
+bool is_flat_list(syntax_t *node) {
+  if (node->type != SYMBOL || node->symbol.size == 0 || !is_list(node->symbol.name)) return false;
+  syntax_t *last = node->symbol.child[node->symbol.size - 1];
+  // 右递归的列表最后一个子节点是下一层，左递归的列表中间是逗号
+  if (last->type == SYMBOL && strcmp(last->symbol.name, node->symbol.name) == 0) return false;
+  return !(node->symbol.size == 3 && node->symbol.child[1]->type == TOKEN);
+}
+
+syntax_t *list_first(list_iter_t *it, syntax_t *list) {
+  it->list = list;
+  it->i = 0;
+  return list_next(it);
+}
+
+syntax_t *list_next(list_iter_t *it) {
+  while (it->list != NULL && it->i < it->list->symbol.size) {
+    syntax_t *item = it->list->symbol.child[it->i];
+    if (it->i == it->list->symbol.size - 1 && item->type == SYMBOL && strcmp(item->symbol.name, it->list->symbol.name) == 0) {
+      // 右递归的下一层
+      it->list = item;
+      it->i = 0;
+      continue;
+    }
+    it->i++;
+    return item;
+  }
+  return NULL;
+}
+
+static void print_indent(int indent) {
+  for (int i = 0; i < indent; i++) printf("  ");  // 打印缩进
+}
+
+// 平坦的列表按文法原来的嵌套形状打印：右递归的列表每一层是一个元素和下一层，
+// 左递归的 arg_list/param_list 每一层是上一层、逗号和一个元素，各层的行号都是第一个元素的行号
+static void print_flat_list(syntax_t *node, int indent) {
+  int n = node->symbol.size;
+  const char *name = node->symbol.name;
+  int lineno = node->symbol.lineno;
+  if (strcmp(name, "arg_list") == 0 || strcmp(name, "param_list") == 0) {
+    // 最内层是 list -> item 或者 list -> item , item
+    int levels = n > 1 ? n - 1 : 1;
+    for (int k = 0; k < levels; k++) {
+      print_indent(indent + k);
+      printf("%s (%d)\n", name, lineno);
+    }
+    print_syntax_tree(node->symbol.child[0], indent + levels);
+    for (int i = 1; i < n; i++) {
+      print_indent(indent + levels - i + 1);
+      printf("COMMA: ,\n");
+      print_syntax_tree(node->symbol.child[i], indent + levels - i + 1);
+    }
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    print_indent(indent + i);
+    printf("%s (%d)\n", name, node->symbol.child[i]->symbol.lineno);
+    print_syntax_tree(node->symbol.child[i], indent + i + 1);
+  }
+}
+
 void print_syntax_tree(syntax_t* node, int indent) {
   if (node == NULL) return;
-  for (int i = 0; i < indent; i++) printf("  ");  // 打印缩进
+  if (print_nested && node->type == SYMBOL && node->symbol.size > 1 && is_flat_list(node)) {
+    print_flat_list(node, indent);
+    return;
+  }
+  print_indent(indent);
 
   if (node->type == TOKEN) {
     printf("%s: %s\n", node->token.name, node->token.value);  // 打印词法单元信息
@@ -90,39 +392,44 @@ void print_syntax_tree(syntax_t* node, int indent) {
   print_syntax_tree(node->symbol.child[i], indent + 1);  // 递归打印子节点
 }
 
-syntax_t *relop(bool last) {
-  if (strcmp(current_token->name, "NEQ") == 0
-    || strcmp(current_token->name, "EQUAL") == 0
-    || strcmp(current_token->name, "LESS") == 0
-    || strcmp(current_token->name, "GREAT") == 0
-    || strcmp(current_token->name, "GEQ") == 0
-    || strcmp(current_token->name, "LEQ") == 0) {
-    syntax_t *token = advance();
-    return new_symbol("relop", token->token.lineno, 1, token);
-  }
-  else {
-    MALFORM;
-  }
-}
-
-syntax_t *addop(bool last) {
-  if (istyp(PLUS) || istyp(MINUS)) {
-    syntax_t *token = advance();
-    return new_symbol("addop", token->token.lineno, 1, token);
-  }
-  else {
-    MALFORM;
+void print_declaration(syntax_t *dec, int k, int indent) {
+  int lineno = line_of(dec);
+  if (k == 0) {
+    print_indent(indent);
+    printf("program (%d)\n", lineno);
+  }
+  if (abstract_syntax) {
+    // 抽象语法树中声明直接是 program 的子节点
+    print_ast(dec, indent + 1);
+  } else if (flat_lists && !print_nested) {
+    if (k == 0) {
+      print_indent(indent + 1);
+      printf("declaration_list (%d)\n", lineno);
+    }
+    print_syntax_tree(dec, indent + 2);
+  } else {
+    // 右递归的第 k 层
+    print_indent(indent + 1 + k);
+    printf("declaration_list (%d)\n", lineno);
+    print_syntax_tree(dec, indent + 2 + k);
   }
 }
 
-syntax_t *mulop(bool last) {
-  if (istyp(DIV) || istyp(STAR)) {
-    syntax_t *token = advance();
-    return new_symbol("mulop", token->token.lineno, 1, token);
-  }
-  else {
-    MALFORM;
+// 抽象语法树每个节点一行：符号名和开头的词法单元子节点的词素写在同一行，其余子节点缩进一层
+void print_ast(syntax_t *node, int indent) {
+  if (node == NULL) return;
+  print_indent(indent);
+  if (node->type == TOKEN) {
+    printf("%s\n", node->token.value);
+    return;
   }
+  printf("%s", node->symbol.name);
+  int i = 0;
+  for (; i < node->symbol.size && node->symbol.child[i]->type == TOKEN; i++)
+    printf(" %s", node->symbol.child[i]->token.value);
+  printf(" (%d)\n", node->symbol.lineno);
+  for (; i < node->symbol.size; i++)
+    print_ast(node->symbol.child[i], indent + 1);
 }
 
 syntax_t* factor(bool last) {
@@ -130,22 +437,24 @@ syntax_t* factor(bool last) {
   if (istyp(INT)) {
     // factor -> NUM
     syntax_t *token = advance();
-    return new_symbol("factor", token->token.lineno, 1, token);
+    return abstract_syntax ? token : new_symbol("factor", token->token.lineno, 1, token);
   } else if (istyp(LP)) {
     // factor -> ( expression )
     syntax_t *lp, *expr, *rp;
-    lp = advance();
+    int lineno = line_number;
+    lp = take();
     expr = expression(last);
     // expression fail
     if (expr == NULL) {
       NONLAST_FAIL;
     }
     if (istyp(RP)) {
-      rp = advance();
+      rp = take();
     } else {
       TOKEN_UNMATCH(RP);
     }
-    return new_symbol("factor", lp->token.lineno, 3, lp, expr, rp);
+    // 抽象语法树中括号只决定结构，不保留节点
+    return abstract_syntax ? expr : new_symbol("factor", lineno, 3, lp, expr, rp);
   } else if (istyp(ID) && isnxttyp(LP)) {
     // factor -> call
     syntax_t *call_0 = call(last);
@@ -153,7 +462,7 @@ syntax_t* factor(bool last) {
       assert(cont == current_token_cnt);
       NONLAST_FAIL;
     }
-    return new_symbol("factor", call_0->symbol.lineno, 1, call_0);
+    return abstract_syntax ? call_0 : new_symbol("factor", call_0->symbol.lineno, 1, call_0);
   } else if (istyp(ID)) {
     // factor -> var
     syntax_t *var_0 = var(last);
@@ -161,15 +470,35 @@ syntax_t* factor(bool last) {
       assert(cont == current_token_cnt);
       NONLAST_FAIL;
     }
-    return new_symbol("factor", var_0->symbol.lineno, 1, var_0);
+    return abstract_syntax ? var_0 : new_symbol("factor", line_of(var_0), 1, var_0);
   } else {
     // no rule available
     MALFORM;
   }
 }
 
+static syntax_t *memo_var(int start, syntax_t *node) {
+  var_memo[start - var_memo_base] = node;
+  var_memo_end[start - var_memo_base] = current_token_cnt;
+  return node;
+}
+
 syntax_t *var(bool last) {
   SAVE_CONT;
+  int slot = cont - var_memo_base;
+  if (slot >= var_memo_cap) {
+    int cap = var_memo_cap ? 2 * var_memo_cap : 1024;
+    while (cap <= slot) cap *= 2;
+    var_memo = (syntax_t **) realloc(var_memo, (unsigned) cap * sizeof(syntax_t *));
+    var_memo_end = (int *) realloc(var_memo_end, (unsigned) cap * sizeof(int));
+    memset(var_memo + var_memo_cap, 0, (unsigned) (cap - var_memo_cap) * sizeof(syntax_t *));
+    memset(var_memo_end + var_memo_cap, 0, (unsigned) (cap - var_memo_cap) * sizeof(int));
+    var_memo_cap = cap;
+  }
+  if (var_memo[slot] != NULL) {
+    current_token_cnt = var_memo_end[slot];
+    return var_memo[slot];
+  }
   if (!istyp(ID)) {
     TOKEN_UNMATCH(ID);
   }
@@ -177,53 +506,57 @@ syntax_t *var(bool last) {
   if (istyp(LB)) {
     // var -> ID [ expression ]
     syntax_t *lb, *expr, *rb;
-    lb = advance();
+    lb = take();
     expr = expression(last);
     if (expr == NULL) {
       NONLAST_FAIL;
     }
     if (istyp(RB)) {
-      rb = advance();
+      rb = take();
     } else {
       TOKEN_UNMATCH(RB);
     }
-    return new_symbol("var", id->token.lineno, 4, id, lb, expr, rb);
+    if (abstract_syntax) {
+      return memo_var(cont, new_symbol("var", id->token.lineno, 2, id, expr));
+    }
+    return memo_var(cont, new_symbol("var", id->token.lineno, 4, id, lb, expr, rb));
   } else {
-    // var -> ID
-    return new_symbol("var", id->token.lineno, 1, id);
+    // var -> ID，抽象语法树中就是标识符本身
+    return memo_var(cont, abstract_syntax ? id : new_symbol("var", id->token.lineno, 1, id));
   }
 }
 
-// term -> factor termlist
-// termlist -> mulop factor termlist | empty
-syntax_t *term(bool last) {
+static void push_item(syntax_t *item);
+static syntax_t *pop_list(const char *name, int base);
+static syntax_t *pop_symbol(const char *name, int lineno, int base);
+
+// 抽象语法树中的调用：子节点依次是函数名和各个实参
+static syntax_t *ast_call(bool last) {
   SAVE_CONT;
-  syntax_t *left = factor(last);
-  if (left == NULL) {
-    NONLAST_FAIL;
+  int base = item_cnt;
+  push_item(advance());
+  if (!istyp(LP)) {
+    item_cnt = base;
+    TOKEN_UNMATCH(LP);
   }
-  // not necessary
-  syntax_t *mul = mulop(false);
-  syntax_t *fac;
-  if (mul == NULL) fac = NULL;
-  else fac = factor(last);
-  while (mul != NULL && fac != NULL) {
-    left = new_symbol("term", left->symbol.lineno, 3, left, mul, fac);
-    mul = mulop(false);
-    if (mul == NULL) fac = NULL;
-    else fac = factor(last);
-  } 
-  // we may get a redundant mulop finally
-  if (mul != NULL) {
-    NONLAST_FAIL;
+  take();
+  bool more = !istyp(RP);
+  while (more) {
+    syntax_t *exp = expression(last);
+    if (exp == NULL) {
+      item_cnt = base;
+      NONLAST_FAIL;
+    }
+    push_item(exp);
+    more = istyp(COMMA);
+    if (more) take();
   }
-  if (strcmp(left->symbol.name, "factor") == 0) {
-    // term -> factor
-    return new_symbol("term", left->symbol.lineno, 1, left);
-  } else {
-    // term -> factor termlist
-    return left;
+  if (!istyp(RP)) {
+    item_cnt = base;
+    TOKEN_UNMATCH(RP);
   }
+  take();
+  return pop_symbol("call", line_of(items[base]), base);
 }
 
 syntax_t *call(bool last) {
@@ -233,6 +566,9 @@ syntax_t *call(bool last) {
   if (!istyp(ID)) {
     TOKEN_UNMATCH(ID);
   }
+  if (abstract_syntax) {
+    return ast_call(last);
+  }
   id = advance();
   if (!istyp(LP)) {
     TOKEN_UNMATCH(LP);
@@ -270,6 +606,9 @@ syntax_t *arg_list(bool last) {
   if (left == NULL) {
     NONLAST_FAIL;
   }
+  // -F 时各项依次压栈，最后构造平坦的列表节点
+  int base = item_cnt;
+  if (flat_lists) push_item(left);
   syntax_t *com, *exp;
   if (istyp(COMMA)) {
     com = advance();
@@ -278,7 +617,11 @@ syntax_t *arg_list(bool last) {
     com = exp = NULL;
   }
   while (com && exp) {
-    left = new_symbol("arg_list", left->symbol.lineno, 3, left, com, exp);
+    if (flat_lists) {
+      push_item(exp);
+    } else {
+      left = new_symbol("arg_list", left->symbol.lineno, 3, left, com, exp);
+    }
     if (istyp(COMMA)) {
       com = advance();
       exp = expression(last);
@@ -288,8 +631,12 @@ syntax_t *arg_list(bool last) {
   }
   // redundant comma
   if (com) {
+    item_cnt = base;
     NONLAST_FAIL;
   }
+  if (flat_lists) {
+    return pop_list("arg_list", base);
+  }
   if (strcmp(left->symbol.name, "expression") == 0) {
     // arg_list -> expression
     return new_symbol("arg_list", left->symbol.lineno, 1, left);
@@ -305,6 +652,9 @@ syntax_t* param_list(bool last) {
   if (left == NULL) {
     NONLAST_FAIL;
   }
+  // -F 时各项依次压栈，最后构造平坦的列表节点
+  int base = item_cnt;
+  if (flat_lists) push_item(left);
   syntax_t *com, *par;
   if (istyp(COMMA)) {
     com = advance();
@@ -314,7 +664,11 @@ syntax_t* param_list(bool last) {
     com = par = NULL;
   }
   while (com && par) {
-    left = new_symbol("param_list", left->symbol.lineno, 3, left, com, par);
+    if (flat_lists) {
+      push_item(par);
+    } else {
+      left = new_symbol("param_list", left->symbol.lineno, 3, left, com, par);
+    }
     if (istyp(COMMA)) {
       com = advance();
       par = param(last);
@@ -324,8 +678,12 @@ syntax_t* param_list(bool last) {
   }
   // redundant comma
   if (com) {
+    item_cnt = base;
     NONLAST_FAIL;
   }
+  if (flat_lists) {
+    return pop_list("param_list", base);
+  }
   if (strcmp(left->symbol.name, "param") == 0) {
     // param_list -> param
     return new_symbol("param_list", left->symbol.lineno, 1, left);
@@ -335,7 +693,19 @@ syntax_t* param_list(bool last) {
   }
 }
 
+static syntax_t* expression_body(bool last);
+
 syntax_t* expression(bool last) {
+  if (depth == MAX_DEPTH) {
+    syn_error(line_number, "nested too deeply", __func__);
+  }
+  depth++;
+  syntax_t *expr = expression_body(last);
+  depth--;
+  return expr;
+}
+
+static syntax_t* expression_body(bool last) {
   SAVE_CONT;
   if (istyp(ID) && !isnxttyp(LP)) {
     // expression -> var = expression
@@ -353,14 +723,17 @@ syntax_t* expression(bool last) {
       if (sexpr == NULL) {
         NONLAST_FAIL;
       }
-      return new_symbol("expression", sexpr->symbol.lineno, 1, sexpr);
+      return abstract_syntax ? sexpr : new_symbol("expression", sexpr->symbol.lineno, 1, sexpr);
     }
-    assign = advance();
+    assign = take();
     // recursive...
     expr = expression(last);
     if (expr == NULL) {
       NONLAST_FAIL;
     }
+    if (abstract_syntax) {
+      return new_symbol("=", line_of(var_0), 2, var_0, expr);
+    }
     return new_symbol("expression", var_0->symbol.lineno, 3, var_0, assign, expr);
   } else {
     // expression -> simple expression
@@ -368,66 +741,109 @@ syntax_t* expression(bool last) {
     if (sexpr == NULL) {
       NONLAST_FAIL;
     }
-    return new_symbol("expression", sexpr->symbol.lineno, 1, sexpr);
+    return abstract_syntax ? sexpr : new_symbol("expression", sexpr->symbol.lineno, 1, sexpr);
   }
 }
 
-syntax_t* simple_expression(bool last) {
-  SAVE_CONT;
-  syntax_t *ae = additive_expression(last);
-  if (ae == NULL) {
-    NONLAST_FAIL;
+// 表达式的优先级层次，层次越大结合越紧，每一层对应一个符号
+// simple_expression -> additive_expression relop additive_expression | additive_expression
+// additive_expression -> additive_expression addop term | term
+// term -> term mulop factor | factor
+#define REL_LEVEL 0
+#define ADD_LEVEL 1
+#define MUL_LEVEL 2
+#define FACTOR_LEVEL 3
+
+static const char *level_name[] = {"simple_expression", "additive_expression", "term", "factor"};
+static const char *op_name[] = {"relop", "addop", "mulop"};
+
+static const struct {
+  const char *token;
+  int level;
+} binops[] = {
+  {"PLUS", ADD_LEVEL}, {"MINUS", ADD_LEVEL}, {"STAR", MUL_LEVEL}, {"DIV", MUL_LEVEL},
+  {"LESS", REL_LEVEL}, {"LEQ", REL_LEVEL}, {"GREAT", REL_LEVEL}, {"GEQ", REL_LEVEL},
+  {"EQUAL", REL_LEVEL}, {"NEQ", REL_LEVEL},
+};
+
+// 当前词法单元作为二元运算符所在的层次，不是二元运算符时返回 -1
+static int binop_level(void) {
+  for (size_t i = 0; i < sizeof(binops) / sizeof(binops[0]); i++)
+    if (strcmp(current_token->name, binops[i].token) == 0)
+      return binops[i].level;
+  return -1;
+}
+
+// 用单产生式把 level 层的节点包装成 target 层的符号，compact_expr 和抽象语法树中不包装
+static syntax_t *lift(syntax_t *node, int level, int target) {
+  if (compact_expr || abstract_syntax) return node;
+  while (level > target) {
+    level--;
+    node = new_symbol(level_name[level], node->symbol.lineno, 1, node);
+  }
+  return node;
+}
+
+// 优先级爬升：分析只含 min_level 及更紧层次运算符的表达式，结果所在的层次存入 *level
+// 同一层次的运算符左结合，关系运算符不结合；每个操作数只调用一次 factor，
+// 不再逐层下降和试探运算符，单产生式的中间节点在确定层次之后才补上
+static syntax_t *climb(bool last, int min_level, int *level) {
+  syntax_t *left = factor(last);
+  if (left == NULL) {
+    return NULL;
   }
-  syntax_t *rel = relop(false);
-  if (rel == NULL) {
-    // simple_expression -> additive_expression
-    return new_symbol("simple_expression", ae->symbol.lineno, 1, ae);
-  } else {
-    syntax_t *ae2 = additive_expression(last);
-    if (ae2 == NULL) {
-      // simple_expression -> additive_expression
-      // give back the relop
-      // actually this will result in a failure afterwards...
-      // --current_token_cnt;
-      // return new_symbol("simple_expression", ae->symbol.lineno, 1, ae);
-      NONLAST_FAIL;
-    } else {
-      // simple_expression -> additive_expression relop additive_expression
-      return new_symbol("simple_expression", ae->symbol.lineno, 3, ae, rel, ae2);
-    } 
+  int left_level = FACTOR_LEVEL, op;
+  while ((op = binop_level()) >= min_level) {
+    const char *lexeme = current_token->value;
+    syntax_t *token = take();
+    int right_level;
+    syntax_t *right = climb(last, op + 1, &right_level);
+    if (right == NULL) {
+      return NULL;
+    }
+    if (abstract_syntax) {
+      // 抽象语法树中运算符就是以词素命名的二元节点
+      left = new_symbol(lexeme, line_of(left), 2, left, right);
+      left_level = op;
+      if (op == REL_LEVEL) {
+        break;
+      }
+      continue;
+    }
+    // 左操作数已经是同一层的符号时保持左递归的形状
+    left = new_symbol(level_name[op], left->symbol.lineno, 3,
+      lift(left, left_level, op + 1),
+      new_symbol(op_name[op], token->token.lineno, 1, token),
+      lift(right, right_level, op + 1));
+    left_level = op;
+    if (op == REL_LEVEL) {
+      break;
+    }
   }
+  *level = left_level;
+  return left;
 }
 
-syntax_t* additive_expression(bool last) {
+static syntax_t *binary_expression(bool last, int level) {
   SAVE_CONT;
-  // leftmost term (necessary)
-  syntax_t *left = term(last);
-  if (left == NULL) {
+  int got;
+  syntax_t *node = climb(last, level, &got);
+  if (node == NULL) {
     NONLAST_FAIL;
   }
+  return lift(node, got, level);
+}
 
-  // not necessary
-  syntax_t *add = addop(false);
-  syntax_t *ter;
-  if (add == NULL) ter = NULL;
-  else ter = term(last);
-  while (ter != NULL && add != NULL) {
-    left = new_symbol("additive_expression", left->symbol.lineno, 3, left, add, ter);
-    add = addop(false);
-    if (add == NULL) ter = NULL;
-    else ter = term(last);
-  } 
-  // we may get a redundant addop finally
-  if (add != NULL) {
-    NONLAST_FAIL;
-  }
-  if (strcmp(left->symbol.name, "term") == 0) {
-    // additive_expression -> term
-    return new_symbol("additive_expression", left->symbol.lineno, 1, left);
-  } else {
-    // additive_expression -> term additive_expression_list
-    return left;
-  }
+syntax_t* simple_expression(bool last) {
+  return binary_expression(last, REL_LEVEL);
+}
+
+syntax_t* additive_expression(bool last) {
+  return binary_expression(last, ADD_LEVEL);
+}
+
+syntax_t *term(bool last) {
+  return binary_expression(last, MUL_LEVEL);
 }
 
 // caution: it returns a token node!!!
@@ -453,8 +869,11 @@ syntax_t *param(bool last) {
   id = advance();
   if (istyp(LB) && isnxttyp(RB)) {
     // param -> type ID []
-    lb = advance();
-    rb = advance();
+    lb = take();
+    rb = take();
+    if (abstract_syntax) {
+      return new_symbol("array_param", type->token.lineno, 2, type, id);
+    }
     return new_symbol("param", type->token.lineno, 4, type, id, lb, rb);
   } else {
     // param -> type ID
@@ -469,11 +888,15 @@ syntax_t *return_stmt(bool last) {
     TOKEN_UNMATCH(RETURN);
   }
   syntax_t *ret, *exp, *semi;
-  ret = advance();
+  int lineno = line_number;
+  ret = take();
   if (istyp(SEMI)) {
     // return_stmt -> return ;
-    semi = advance();
-    return new_symbol("return_stmt", ret->token.lineno, 2, ret, semi);
+    semi = take();
+    if (abstract_syntax) {
+      return new_symbol("return_stmt", lineno, 0);
+    }
+    return new_symbol("return_stmt", lineno, 2, ret, semi);
   } else {
     // return_stmt -> return expression ;
     exp = expression(last);
@@ -483,8 +906,11 @@ syntax_t *return_stmt(bool last) {
     if (!istyp(SEMI)) {
       TOKEN_UNMATCH(SEMI);
     }
-    semi = advance();
-    return new_symbol("return_stmt", ret->token.lineno, 3, ret, exp, semi);
+    semi = take();
+    if (abstract_syntax) {
+      return new_symbol("return_stmt", lineno, 1, exp);
+    }
+    return new_symbol("return_stmt", lineno, 3, ret, exp, semi);
   }
 }
 
@@ -492,8 +918,12 @@ syntax_t* expression_stmt(bool last) {
   SAVE_CONT;
   if (istyp(SEMI)) {
     // expression_stmt -> ;
-    syntax_t *semi = advance();
-    return new_symbol("expression_stmt", semi->token.lineno, 1, semi);
+    int lineno = line_number;
+    syntax_t *semi = take();
+    if (abstract_syntax) {
+      return new_symbol("expression_stmt", lineno, 0);
+    }
+    return new_symbol("expression_stmt", lineno, 1, semi);
   } else {
     // expression_stmt -> expression ;
     syntax_t *exp, *semi;
@@ -504,8 +934,9 @@ syntax_t* expression_stmt(bool last) {
     if (!istyp(SEMI)) {
       TOKEN_UNMATCH(SEMI);
     }
-    semi = advance();
-    return new_symbol("expression_stmt", exp->symbol.lineno, 2, exp, semi);
+    semi = take();
+    // 抽象语法树中表达式语句就是表达式本身
+    return abstract_syntax ? exp : new_symbol("expression_stmt", exp->symbol.lineno, 2, exp, semi);
   }
 }
 
@@ -517,12 +948,13 @@ syntax_t* iteration_stmt(bool last) {
   if (!istyp(WHILE)) {
     TOKEN_UNMATCH(WHILE);
   }
-  w = advance();
+  int lineno = line_number;
+  w = take();
 
   if (!istyp(LP)) {
     TOKEN_UNMATCH(LP);
   }
-  lp = advance();
+  lp = take();
 
   exp = expression(last);
   if (exp == NULL) {
@@ -532,17 +964,47 @@ syntax_t* iteration_stmt(bool last) {
   if (!istyp(RP)) {
     TOKEN_UNMATCH(RP);
   }
-  rp = advance();
+  rp = take();
 
   stmt = statement(last);
   if (stmt == NULL) {
     NONLAST_FAIL;
   }
 
-  return new_symbol("iteration_stmt", w->token.lineno, 5, w, lp, exp, rp, stmt);
+  if (abstract_syntax) {
+    return new_symbol("iteration_stmt", lineno, 2, exp, stmt);
+  }
+  return new_symbol("iteration_stmt", lineno, 5, w, lp, exp, rp, stmt);
+}
+
+// 抽象语法树中的形参表：子节点依次是各个形参，void 时没有子节点
+static syntax_t *ast_params(bool last) {
+  SAVE_CONT;
+  int lineno = line_number;
+  if (istyp(TYPE) && strcmp(current_token->value, "void") == 0 && isnxttyp(RP)) {
+    take();
+    return new_symbol("params", lineno, 0);
+  }
+  int base = item_cnt;
+  for (;;) {
+    syntax_t *par = param(last);
+    if (par == NULL) {
+      item_cnt = base;
+      NONLAST_FAIL;
+    }
+    push_item(par);
+    if (!istyp(COMMA)) {
+      break;
+    }
+    take();
+  }
+  return pop_symbol("params", lineno, base);
 }
 
 syntax_t* params(bool last) {
+  if (abstract_syntax) {
+    return ast_params(last);
+  }
   SAVE_CONT;
   if (istyp(TYPE) && strcmp(current_token->value, "void") == 0 && isnxttyp(RP)) {
     // params -> void
@@ -566,11 +1028,12 @@ syntax_t* selection_stmt(bool last) {
   if (!istyp(IF)) {
     TOKEN_UNMATCH(IF);
   }
-  i = advance();
+  int lineno = line_number;
+  i = take();
   if (!istyp(LP)) {
     TOKEN_UNMATCH(LP);
   }
-  lp = advance();
+  lp = take();
   exp = expression(last);
   if (exp == NULL) {
     NONLAST_FAIL;
@@ -578,7 +1041,7 @@ syntax_t* selection_stmt(bool last) {
   if (!istyp(RP)) {
     TOKEN_UNMATCH(RP);
   }
-  rp = advance();
+  rp = take();
   
   stmt1 = statement(last);
   if (stmt1 == NULL) {
@@ -587,24 +1050,59 @@ syntax_t* selection_stmt(bool last) {
 
   if (!istyp(ELSE)) {
     // TOKEN_UNMATCH(ELSE);
-    return new_symbol("selection-statement", i->token.lineno, 5, i, lp, exp, rp, stmt1);
+    if (abstract_syntax) {
+      return new_symbol("selection_stmt", lineno, 2, exp, stmt1);
+    }
+    return new_symbol("selection-statement", lineno, 5, i, lp, exp, rp, stmt1);
   } else {
-    e = advance();
+    e = take();
     stmt2 = statement(last);
     if (stmt2 == NULL) {
       NONLAST_FAIL;
     }
-    return new_symbol("selection-statement", i->token.lineno, 7, i, lp, exp, rp, stmt1, e, stmt2);
+    if (abstract_syntax) {
+      return new_symbol("selection_stmt", lineno, 3, exp, stmt1, stmt2);
+    }
+    return new_symbol("selection-statement", lineno, 7, i, lp, exp, rp, stmt1, e, stmt2);
   }
 
 }
 
+// 抽象语法树中的复合语句：子节点依次是各个局部变量声明和各个语句
+static syntax_t *ast_compound(bool last) {
+  SAVE_CONT;
+  int lineno = line_number;
+  take();
+  int base = item_cnt;
+  while (istyp(TYPE)) {
+    syntax_t *vd = var_declaration(last);
+    if (vd == NULL) {
+      item_cnt = base;
+      NONLAST_FAIL;
+    }
+    push_item(vd);
+  }
+  while (!istyp(RC)) {
+    syntax_t *stmt = statement(last);
+    if (stmt == NULL) {
+      item_cnt = base;
+      NONLAST_FAIL;
+    }
+    push_item(stmt);
+  }
+  take();
+  return pop_symbol("compound_stmt", lineno, base);
+}
+
 syntax_t* compound_stmt(bool last) {
   SAVE_CONT;
   syntax_t *lc, *rc, *ld, *stmtl;
   if (!istyp(LC)) {
     TOKEN_UNMATCH(LC);
   }
+  if (abstract_syntax) {
+    return ast_compound(last);
+  }
   lc = advance();
   ld = local_declarations(last);
   if (ld == NULL) {
@@ -621,33 +1119,79 @@ syntax_t* compound_stmt(bool last) {
   return new_symbol("compound_stmt", lc->token.lineno, 4, lc, ld, stmtl, rc);
 }
 
+static void push_item(syntax_t *item) {
+  if (item_cnt == item_cap) {
+    item_cap = item_cap ? 2 * item_cap : 64;
+    items = (syntax_t **) realloc(items, (unsigned) item_cap * sizeof(syntax_t *));
+  }
+  items[item_cnt++] = item;
+}
+
+// 子节点数组就是 elems 的符号节点
+static syntax_t *new_node(const char *name, int lineno, syntax_t **elems, int n) {
+  syntax_t *node = alloc_symbol(name, lineno, n);
+  if (n)
+    memcpy(node->symbol.child, elems, (unsigned) n * sizeof(syntax_t *));
+  if (share_subtrees) {
+    return intern(node, sizeof(syntax_t) + (unsigned) n * sizeof(syntax_t*));
+  }
+  return node;
+}
+
+// 平坦的列表节点，子节点数组就是所有的元素
+static syntax_t *new_flat_list(const char *name, syntax_t **elems, int n) {
+  return new_node(name, line_of(elems[0]), elems, n);
+}
+
+syntax_t *new_list(const char *name, syntax_t **elems, int n) {
+  if (flat_lists || abstract_syntax) {
+    return new_flat_list(name, elems, n);
+  }
+  syntax_t *list = new_symbol(name, elems[n - 1]->symbol.lineno, 1, elems[n - 1]);
+  for (int i = n - 2; i >= 0; i--)
+    list = new_symbol(name, elems[i]->symbol.lineno, 2, elems[i], list);
+  return list;
+}
+
+// 把 items[base..] 构造为右递归（-F 时平坦）的列表节点，并弹出这些元素
+static syntax_t *pop_list(const char *name, int base) {
+  syntax_t *list = new_list(name, items + base, item_cnt - base);
+  item_cnt = base;
+  return list;
+}
+
+// 把 items[base..] 作为子节点构造 name 节点，并弹出这些元素
+static syntax_t *pop_symbol(const char *name, int lineno, int base) {
+  syntax_t *node = new_node(name, lineno, items + base, item_cnt - base);
+  item_cnt = base;
+  return node;
+}
+
 syntax_t* local_declarations(bool last) {
   SAVE_CONT;
-  if (istyp(TYPE)) {
-    // not empty
+  int base = item_cnt;
+  while (istyp(TYPE)) {
     syntax_t *vd = var_declaration(last);
     if (vd == NULL) {
+      item_cnt = base;
       NONLAST_FAIL;
     }
-    syntax_t *ld = local_declarations(last);
-    if (ld == NULL) {
-      NONLAST_FAIL;
-    }
-    // ld is empty
-    if (ld->symbol.size == 0) {
-      free(ld);
-      return new_symbol("local_declarations", vd->symbol.lineno, 1, vd);
-    }
-    return new_symbol("local_declarations", vd->symbol.lineno, 2, vd, ld);
-  } else {
+    push_item(vd);
+  }
+  if (item_cnt == base) {
     // empty
     return new_symbol("local_declarations", line_number, 0);
   }
+  return pop_list("local_declarations", base);
 }
 
 
 syntax_t* statement(bool last) {
   syntax_t *stmt;
+  if (depth == MAX_DEPTH) {
+    syn_error(line_number, "nested too deeply", __func__);
+  }
+  depth++;
   if (istyp(RETURN)) {
     // return_stmt
     stmt = return_stmt(last);
@@ -664,11 +1208,12 @@ syntax_t* statement(bool last) {
     // expression_stmt
     stmt = expression_stmt(last);
   }
+  depth--;
   if (stmt == NULL) {
     assert(!last);
     return NULL;
   }
-  return new_symbol("statement", stmt->symbol.lineno, 1, stmt);
+  return abstract_syntax ? stmt : new_symbol("statement", stmt->symbol.lineno, 1, stmt);
 }
 
 syntax_t* program(bool last) {
@@ -678,54 +1223,96 @@ syntax_t* program(bool last) {
   if (dl == NULL) {
     NONLAST_FAIL;
   }
-  return new_symbol("program", dl->symbol.lineno, 1, dl);
+  // 抽象语法树中 declaration_list 已经是 program 节点
+  return abstract_syntax ? dl : new_symbol("program", dl->symbol.lineno, 1, dl);
+}
+
+// 流式输出时交出的声明不再被访问：释放分析它时分配的大块，退回到分析它之前的位置；
+// 它的词法单元已经复制到节点中，也一起释放；var 的记忆表从下一个声明的位置重新开始
+static void release_declaration(int chunks, char *ptr, char *end, int begin) {
+  free(var_memo);
+  free(var_memo_end);
+  var_memo = NULL;
+  var_memo_end = NULL;
+  var_memo_cap = 0;
+  var_memo_base = current_token_cnt;
+  for (int i = chunks; i < alloc_cnt; i++)
+    free(allocs[i]);
+  alloc_cnt = chunks;
+  chunk_ptr = ptr;
+  chunk_end = end;
+  for (int i = begin; i < current_token_cnt; i++) {
+    free(token_list[i]);
+    token_list[i] = NULL;
+  }
 }
 
 // declaration_list -> declaration declaration_list | declaration
 syntax_t* declaration_list(bool last) {
   SAVE_CONT;
+  int base = item_cnt, k = 0, lineno = line_number;
   // the first declartion will be necessary
-  syntax_t *dec = declaration(last);
-  if (dec != NULL) {
-    // end
-    if (istyp(EOT)) {
-      // declaration
-      return new_symbol("declaration_list", dec->symbol.lineno, 1, dec);
-    }
-    // not end
-    // declaration_list -> declaration declaration_list
-    syntax_t *dl = declaration_list(last);
-    if (dl == NULL) {
+  do {
+    int chunks = alloc_cnt, begin = current_token_cnt;
+    char *ptr = chunk_ptr, *end = chunk_end;
+    syntax_t *dec = declaration(last);
+    if (dec == NULL) {
+      item_cnt = base;
       NONLAST_FAIL;
     }
-    // declaration_list -> declaration declaration_list
-    return new_symbol("declaration_list", dec->symbol.lineno, 2, dec, dl);
-  } else {
-    // error
-    NONLAST_FAIL;
-  }
+    if (declaration_sink == NULL) {
+      push_item(dec);
+      continue;
+    }
+    if (k == 0) lineno = line_of(dec);
+    declaration_sink(dec, k++);
+    release_declaration(chunks, ptr, end, begin);
+  } while (!istyp(EOT));
+  const char *name = abstract_syntax ? "program" : "declaration_list";
+  return declaration_sink == NULL ? pop_list(name, base) : new_symbol(name, lineno, 0);
 }
 
 syntax_t* statement_list(bool last) {
   SAVE_CONT;
-  if (istyp(RC)) {
+  int base = item_cnt;
+  while (!istyp(RC)) {
+    syntax_t *stmt = statement(last);
+    if (stmt == NULL) {
+      item_cnt = base;
+      NONLAST_FAIL;
+    }
+    push_item(stmt);
+  }
+  if (item_cnt == base) {
     // empty
     return new_symbol("statement_list", line_number, 0);
   }
-  syntax_t *stmt = statement(last);
-  if (stmt != NULL) {
-    // necessary
-    // statement_list -> statement statement_list
-    syntax_t *stmtl = statement_list(last);
-    if (stmtl == NULL || stmtl->symbol.size == 0) {
-      if (stmtl) free(stmtl);
-      return new_symbol("statement_list", stmt->symbol.lineno, 1, stmt);
-    } else {
-      return new_symbol("statement_list", stmt->symbol.lineno, 2, stmt, stmtl);
+  return pop_list("statement_list", base);
+}
+
+// 用花括号匹配跳过函数体，只记录它的范围；没有匹配的 } 时返回 NULL，由 compound_stmt 报错
+static syntax_t *skip_body(void) {
+  if (!istyp(LC)) {
+    return NULL;
+  }
+  int end = current_token_cnt, braces = 0;
+  do {
+    const char *name = token_at(end++)->name;
+    if (strcmp(name, "LC") == 0) {
+      braces++;
+    } else if (strcmp(name, "RC") == 0) {
+      braces--;
     }
-  } else {
-    NONLAST_FAIL;
+  } while (braces > 0 && end < token_cnt);
+  if (braces > 0) {
+    return NULL;
   }
+  // 占位节点各自记录不同的范围，不和其他节点共用
+  syntax_t *body = alloc_symbol("lazy_compound_stmt", line_number, 0);
+  body->symbol.begin = current_token_cnt;
+  body->symbol.end = end;
+  current_token_cnt = end;
+  return body;
 }
 
 syntax_t* fun_declaration(bool last) {
@@ -742,7 +1329,7 @@ syntax_t* fun_declaration(bool last) {
   if (!istyp(LP)) {
     TOKEN_UNMATCH(LP);
   }
-  lp = advance();
+  lp = take();
   par = params(last);
   if (par == NULL) {
     NONLAST_FAIL;
@@ -750,14 +1337,35 @@ syntax_t* fun_declaration(bool last) {
   if (!istyp(RP)) {
     TOKEN_UNMATCH(RP);
   }
-  rp = advance();
-  cstmt = compound_stmt(last);
+  rp = take();
+  cstmt = skeleton_bodies ? skip_body() : NULL;
+  if (cstmt == NULL) {
+    cstmt = compound_stmt(last);
+  }
   if (cstmt == NULL) {
     NONLAST_FAIL;
   }
+  if (abstract_syntax) {
+    return new_symbol("fun_declaration", type->token.lineno, 4, type, id, par, cstmt);
+  }
   return new_symbol("fun_declaration", type->token.lineno, 6, type, id, lp, par, rp, cstmt);
 }
 
+syntax_t *function_body(syntax_t *fun) {
+  // 函数体总是最后一个子节点，抽象语法树中也一样
+  syntax_t *body = fun->symbol.child[fun->symbol.size - 1];
+  if (strcmp(body->symbol.name, "lazy_compound_stmt") != 0) {
+    return body;
+  }
+  int saved = current_token_cnt;
+  current_token_cnt = body->symbol.begin;
+  syntax_t *parsed = compound_stmt(true);
+  // 花括号匹配的范围就是 compound_stmt 分析成功时的范围
+  assert(current_token_cnt == body->symbol.end);
+  current_token_cnt = saved;
+  return fun->symbol.child[fun->symbol.size - 1] = parsed;
+}
+
 syntax_t* var_declaration(bool last) {
   // var_declaration -> type ID ; | type ID [ NUM ] ;
   SAVE_CONT;
@@ -772,14 +1380,20 @@ syntax_t* var_declaration(bool last) {
   id = advance();
   if ((istyp(LB) && isnxttyp(INT)) && istoktyp(2, RB) && istoktyp(3, SEMI)) {
     // var_declaration -> type ID [ NUM ] ;
-    lb = advance();
+    lb = take();
     num = advance();
-    rb = advance();
-    semi = advance();
+    rb = take();
+    semi = take();
+    if (abstract_syntax) {
+      return new_symbol("var_declaration", type->token.lineno, 3, type, id, num);
+    }
     return new_symbol("var_declaration", type->token.lineno, 6, type, id, lb, num, rb, semi);
   } else if (istyp(SEMI)){
     // var_declaration -> type ID ;
-    semi = advance();
+    semi = take();
+    if (abstract_syntax) {
+      return new_symbol("var_declaration", type->token.lineno, 2, type, id);
+    }
     return new_symbol("var_declaration", type->token.lineno, 3, type, id, semi);
   } else {
     MALFORM;
@@ -802,14 +1416,14 @@ syntax_t* declaration(bool last) {
     if (fd == NULL) {
       NONLAST_FAIL;
     }
-    return new_symbol("declaration", fd->symbol.lineno, 1, fd);
+    return abstract_syntax ? fd : new_symbol("declaration", fd->symbol.lineno, 1, fd);
   } else if (istoktyp(2, LB) || istoktyp(2, SEMI)) {
     // declaration -> var_declaration
     syntax_t *vd = var_declaration(last);
     if (vd == NULL) {
       NONLAST_FAIL;
     }
-    return new_symbol("declaration", vd->symbol.lineno, 1, vd);
+    return abstract_syntax ? vd : new_symbol("declaration", vd->symbol.lineno, 1, vd);
   } else {
     MALFORM;
   }
@@ -0,0 +1,37 @@
+#include <meowbin.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+// 把 meowCC -b 输出的二进制文件转换回 -l 或默认模式的文本格式
+int main(int argc, char *argv[]) {
+  int opt, indent = 0;
+  while ((opt = getopt(argc, argv, "i:")) != -1) {
+    switch (opt) {
+      case 'i': {
+        indent = atoi(optarg);
+        break;
+      }
+      default: {
+        fprintf(stderr, "Usage: %s [-i NUM] FILE\n", argv[0]);
+        exit(-1);
+      }
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "missing input file\n");
+    exit(-1);
+  }
+  meowbin_t bin;
+  const char *error;
+  if (meowbin_open(&bin, argv[optind], &error) != 0) {
+    fprintf(stderr, "%s: %s\n", argv[optind], error);
+    exit(-1);
+  }
+  if (bin.header->kind == MEOWBIN_TOKENS) {
+    meowbin_print_tokens(&bin, stdout);
+  } else {
+    meowbin_print_tree(&bin, indent, stdout);
+  }
+  meowbin_close(&bin);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <libmeow.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+// libmeow 的示例：把文件读进内存后在进程内分析，输出和 meowCC 的 -l、-e、-c、-k、-H、-F 及默认模式相同，-a 构造抽象语法树（同 -ast）
+// -f 在打印时用 meow_function_body() 分析 -k 跳过的函数体，输出应当和不加 -k 时相同
+static meow_compilation_t *c;
+static int force_bodies = 0;
+
+static void print_node(const meow_node_t *node, int indent) {
+  for (int i = 0; i < indent; i++) printf("  ");
+  if (meow_node_value(node) != NULL) {
+    printf("%s: %s\n", meow_node_name(node), meow_node_value(node));
+    return;
+  }
+  printf("%s (%d)\n", meow_node_name(node), meow_node_line(node));
+  for (int i = 0; i < meow_node_child_count(node); i++)
+    print_node(meow_node_child(node, i), indent + 1);
+}
+
+// 按顺序分析所有函数体，遇到第一个语法错误时返回 0
+static int force(const meow_node_t *node) {
+  if (meow_node_value(node) != NULL) return 1;
+  if (strcmp(meow_node_name(node), "fun_declaration") == 0)
+    return meow_function_body(c, node) != NULL;
+  for (int i = 0; i < meow_node_child_count(node); i++)
+    if (!force(meow_node_child(node, i))) return 0;
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  int opt, indent = 0, flags = 0;
+  while ((opt = getopt(argc, argv, "leckfHFai:")) != -1) {
+    switch (opt) {
+      case 'l': {
+        flags |= MEOW_LEX_ONLY;
+        break;
+      }
+      case 'e': {
+        flags |= MEOW_EXPRESSION;
+        break;
+      }
+      case 'c': {
+        flags |= MEOW_COMPACT;
+        break;
+      }
+      case 'k': {
+        flags |= MEOW_SKELETON;
+        break;
+      }
+      case 'H': {
+        flags |= MEOW_SHARED;
+        break;
+      }
+      case 'F': {
+        flags |= MEOW_FLAT;
+        break;
+      }
+      case 'f': {
+        force_bodies = 1;
+        break;
+      }
+      case 'a': {
+        flags |= MEOW_AST;
+        break;
+      }
+      case 'i': {
+        indent = atoi(optarg);
+        break;
+      }
+      default: {
+        fprintf(stderr, "Usage: %s [-l] [-e] [-c] [-k [-f]] [-H] [-F] [-a] [-i NUM] FILE\n", argv[0]);
+        exit(-1);
+      }
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "missing source file\n");
+    exit(-1);
+  }
+  FILE *fp = fopen(argv[optind], "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "open source file failed\n");
+    exit(-1);
+  }
+  size_t size = 0, cap = 4096;
+  char *source = (char *) malloc(cap);
+  size_t n;
+  while ((n = fread(source + size, 1, cap - size, fp)) > 0) {
+    size += n;
+    if (size == cap) source = (char *) realloc(source, cap *= 2);
+  }
+  fclose(fp);
+
+  c = meow_compile(source, size, flags);
+  free(source);
+  if (c == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(-1);
+  }
+  if (force_bodies && meow_ok(c)) force(meow_root(c));
+  int ok = meow_ok(c);
+  for (int i = 0; i < meow_diag_count(c); i++)
+    fprintf(stderr, "%s\n", meow_diag_message(c, i));
+  if (ok && (flags & MEOW_LEX_ONLY)) {
+    for (int i = 0; i < meow_token_count(c); i++)
+      printf("Token {name: %s, line: %d, value: %s}\n", meow_token_name(c, i), meow_token_line(c, i), meow_token_value(c, i));
+  } else if (ok) {
+    print_node(meow_root(c), indent);
+  }
+  meow_free(c);
+  return ok ? 0 : -1;
+}